@@ -1,17 +1,18 @@
 //Create table
 CREATE TABLE IF NOT EXISTS SensorData (	ID INTEGER PRIMARY KEY AUTOINCREMENT, 
 										Device_ID INTEGER,
-										Timestamp DATETIME DEFAULT CURRENT_TIMESTAMP,
+										TimeMs INTEGER NOT NULL,
 										Power_Consumption INTEGER);
+CREATE INDEX IF NOT EXISTS SensorData_TimeMs ON SensorData (TimeMs);
 
-//Insert data
-INSERT INTO SensorData (Device_ID, Power_Consumption) VALUES (val1, val2);
+//Insert data, TimeMs is the UTC read time in ms since the epoch
+INSERT INTO SensorData (Device_ID, Power_Consumption, TimeMs) VALUES (val1, val2, val3);
 
-//Delete the data if beyond one day for Main process
-DELETE FROM SensorData WHERE Timestamp < datetime('now', '-1 day');
+//Delete the data if beyond the retention period for Main process, cutoff = now ms - retention ms
+DELETE FROM SensorData WHERE ID IN (SELECT ID FROM SensorData WHERE TimeMs < cutoff ORDER BY TimeMs LIMIT 1000);
 
-//Get the data to publish the data to cloud last one min data
-SELECT Device_ID, Power_Consumption, Timestamp FROM SensorData WHERE Timestamp >= datetime('now', '-60 seconds');
+//Get the data of a time range, e.g. the last one min data
+SELECT Device_ID, Power_Consumption, TimeMs FROM SensorData WHERE TimeMs >= fromMs AND TimeMs < toMs;
 
 //Get the data for Live data
 SELECT sensorID, power, timestamp FROM SensorData 
@@ -19,4 +20,13 @@ SELECT sensorID, power, timestamp FROM SensorData
 
 //Get the data for one hour average
 SELECT sensorID, AVG(power) as avg_power, strftime('%Y-%m-%d %H:00:00', timestamp) 
-											as hour FROM SensorData GROUP BY sensorID, hour
\ No newline at end of file
+											as hour FROM SensorData GROUP BY sensorID, hour
+
+//Server table of the windowed aggregates, window is its length in seconds
+CREATE TABLE IF NOT EXISTS SensorAggregate (id INTEGER PRIMARY KEY AUTOINCREMENT,
+										sensorID INTEGER, window INTEGER, timestamp TEXT,
+										count INTEGER, min INTEGER, max INTEGER, avg REAL);
+
+//Get the one hour average from the aggregates of one window length
+SELECT sensorID, SUM(avg * count) / SUM(count) as avg_power, strftime('%Y-%m-%d %H:00:00', timestamp)
+											as hour FROM SensorAggregate WHERE window = 900 GROUP BY sensorID, hour
\ No newline at end of file
@@ -0,0 +1,343 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		Decode check of the binary messages, clock steps
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include "general.h"
+
+/*** Globals ***/
+UINT64	flag1;
+BOOL	debug,modDebug;
+static SENSOR_TABLE		benchTbl;
+static SAMPLE_WINDOW	benchWin;
+static RING				benchRing = {.efd = RET_FAILURE};
+static const UINT64		benchEpochMs = 1791849600000ULL;	/* 2026-10-13 00:00:00 UTC */
+
+static void printUsage(void)
+{
+    fprintf(stdout,"Usage: bench_payload [OPTIONS]\n");
+    fprintf(stdout,"Options:\n");
+    fprintf(stdout,"  -n <sensors>          Number of sensors (default 3)\n");
+    fprintf(stdout,"  -r <ms>               Read interval of every sensor (default 1000)\n");
+    fprintf(stdout,"  -s <seconds>          Publish interval, sets the samples per publish (default 60)\n");
+    fprintf(stdout,"  -m <bytes>            Max payload per message (default %d)\n", MQTT_MAX_PAYLOAD_DEFAULT);
+    fprintf(stdout,"  -i <count>            Encode iterations (default 1000)\n");
+    fprintf(stdout,"  -w <file>             Write the binary messages of one publish to a file\n");
+    fprintf(stdout,"  -b <ms>               Step the clock back halfway through, like an NTP correction (default 0)\n");
+}
+
+/*************************************************************************
+* @brief        Moves the samples queued in the ring into the windows.
+*
+* @return       UINT32      Number of samples moved.
+*************************************************************************/
+static UINT32 drainRing(void)
+{
+    SAMPLE batch[STORE_BATCH_MAX];
+    UINT32 n = 0, total = 0;
+
+    while((n = ringPop(&benchRing, batch, STORE_BATCH_MAX)) > 0)
+        total += windowFeed(&benchWin, batch, n);
+    return total;
+}
+
+/*************************************************************************
+* @brief        Fills the windows with one publish interval of samples,
+*               a slow random walk of power like a real load.
+*
+* @param[in]    interval    Read interval in ms.
+* @param[in]    publishSec  Publish interval in seconds.
+* @param[in]    stepBackMs  Clock step back halfway through, 0 for none.
+*
+* @return       UINT32      Number of samples.
+*************************************************************************/
+static UINT32 fillWindows(UINT32 interval, UINT16 publishSec, UINT32 stepBackMs)
+{
+    SAMPLE sample;
+    UINT32 k = 0, perSensor = (UINT32)publishSec * MS_PER_SEC / interval, total = 0;
+    UINT16 idx = 0;
+    INT32 power = 0;
+
+    srand(1);
+    for(idx = 0; idx < benchTbl.count; idx++)
+    {
+        power = 50 + rand() % 100;
+        for(k = 0; k < perSensor; k++)
+        {
+            power += (rand() % 7) - 3;
+            if(power < 0)
+                power = 0;
+            sample.idx = idx;
+            sample.id = benchTbl.id[idx];
+            sample.power = (UINT16)power;
+            sample.suppressed = FALSE;
+            /* Read slots are jittered by up to a few ms like the poller */
+            sample.epochMs = benchEpochMs + (UINT64)k * interval + (UINT64)(rand() % 5);
+            if(k >= perSensor / 2)
+                sample.epochMs -= stepBackMs;
+            ringPush(&benchRing, &sample);
+            if(ringDepth(&benchRing) > benchRing.mask / 2)
+                total += drainRing();
+        }
+    }
+    return total + drainRing();
+}
+
+/*************************************************************************
+* @brief        Reads one LEB128 varint of a message.
+*
+* @param[in]    buf         Message.
+* @param[in]    len         Message length.
+* @param[in,out] pos        Offset, moved past the varint.
+* @param[out]   value       Value.
+*
+* @return       ERROR_CODE  RET_FAILURE if the message ends inside it.
+*************************************************************************/
+static ERROR_CODE getVarint(const UINT8 *buf, UINT32 len, UINT32 *pos, UINT64 *value)
+{
+    UINT32 shift = 0;
+
+    *value = 0;
+    while(*pos < len && shift < 64)
+    {
+        *value |= (UINT64)(buf[*pos] & 0x7F) << shift;
+        if(buf[(*pos)++] < 0x80)
+            return RET_OK;
+        shift += 7;
+    }
+    return RET_FAILURE;
+}
+
+static INT64 unzigzag(UINT64 value)
+{
+    return (INT64)(value >> 1) ^ -(INT64)(value & 1);
+}
+
+/*************************************************************************
+* @brief        Decodes every binary message of one publish and compares
+*               it with the windows, sample by sample.
+*
+* @param[in]    maxLen      Max payload per message.
+* @param[in]    samples     Samples in the windows.
+*
+* @return       ERROR_CODE  Returns RET_OK if every sample decodes back,
+*                           otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE checkBinary(UINT32 maxLen, UINT32 samples)
+{
+    PAYLOAD pl;
+    PAYLOAD_CURSOR cur = {0, benchWin.sent[0]};
+    const UINT8 *buf = NULL;
+    UINT64 baseMs = 0, timeMs = 0, id = 0, count = 0, delta = 0;
+    UINT32 pos = 0, k = 0, slot = 0, idx = 0, seq = benchWin.sent[0], decoded = 0;
+    INT64 power = 0;
+    ERROR_CODE rc = RET_OK;
+
+    payloadInit(&pl, maxLen, PAYLOAD_BINARY);
+    while(rc == RET_OK && payloadEncode(&pl, &benchWin, benchTbl.id, &cur) == RET_OK && pl.records)
+    {
+        buf = (const UINT8*)pl.buf;
+        pos = 2;
+        if(pl.len < 3 || buf[0] != PAYLOAD_BIN_MAGIC || buf[1] != PAYLOAD_BIN_VERSION ||
+           getVarint(buf, pl.len, &pos, &baseMs) != RET_OK)
+            rc = RET_FAILURE;
+        while(rc == RET_OK && pos < pl.len)
+        {
+            if(getVarint(buf, pl.len, &pos, &id) != RET_OK || getVarint(buf, pl.len, &pos, &count) != RET_OK)
+            {
+                rc = RET_FAILURE;
+                break;
+            }
+            power = 0;
+            for(k = 0; k < count; k++)
+            {
+                if(getVarint(buf, pl.len, &pos, &delta) != RET_OK)
+                {
+                    rc = RET_FAILURE;
+                    break;
+                }
+                timeMs = (k ? timeMs : baseMs) + (UINT64)unzigzag(delta);
+                if(getVarint(buf, pl.len, &pos, &delta) != RET_OK)
+                {
+                    rc = RET_FAILURE;
+                    break;
+                }
+                power += unzigzag(delta);
+
+                /* The next sample of the windows, sensor by sensor */
+                while(idx < benchWin.count && seq == benchWin.head[idx])
+                {
+                    if(++idx < benchWin.count)
+                        seq = benchWin.sent[idx];
+                }
+                slot = (idx < benchWin.count) ? benchWin.base[idx] + (seq++ & benchWin.mask[idx]) : 0;
+                if(idx == benchWin.count || id != benchTbl.id[idx] || power != benchWin.power[slot] ||
+                   timeMs != benchWin.epochMs[slot])
+                {
+                    fprintf(stderr, "binary sample %u decodes to sensor %llu, power %lld, time %llu\n",
+                                decoded, id, power, timeMs);
+                    rc = RET_FAILURE;
+                    break;
+                }
+                decoded++;
+            }
+        }
+    }
+    payloadFree(&pl);
+
+    if(rc == RET_OK && decoded != samples)
+    {
+        fprintf(stderr, "binary decoded %u of %u samples\n", decoded, samples);
+        rc = RET_FAILURE;
+    }
+    if(rc == RET_OK)
+        fprintf(stdout, "binary decodes back to all %u samples\n", decoded);
+    return rc;
+}
+
+/*************************************************************************
+* @brief        Encodes every sample of the windows, repeatedly.
+*
+* @param[in]    name        Encoding name.
+* @param[in]    encoding    PAYLOAD_JSON or PAYLOAD_BINARY.
+* @param[in]    maxLen      Max payload per message.
+* @param[in]    samples     Samples in the windows.
+* @param[in]    iterations  Number of times the whole window is encoded.
+* @param[in]    fp          Gets the messages of the first pass, may be NULL.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE runEncoding(const CHAR *name, UINT8 encoding, UINT32 maxLen, UINT32 samples, UINT32 iterations, FILE *fp)
+{
+    PAYLOAD pl;
+    PAYLOAD_CURSOR cur;
+    UINT64 bytes = 0, messages = 0, startUs = 0, elapsedUs = 0;
+    UINT32 i = 0, encoded = 0;
+
+    payloadInit(&pl, maxLen, encoding);
+    startUs = getMonotonicUs();
+    for(i = 0; i < iterations; i++)
+    {
+        cur.idx = 0;
+        cur.seq = benchWin.sent[0];
+        encoded = 0;
+        for(;;)
+        {
+            if(payloadEncode(&pl, &benchWin, benchTbl.id, &cur) != RET_OK)
+            {
+                payloadFree(&pl);
+                return RET_FAILURE;
+            }
+            if(pl.records == 0)
+                break;
+
+            encoded += pl.records;
+            bytes += pl.len;
+            messages++;
+            if(fp && i == 0)
+            {
+                /* Length prefixed so a decoder can split the messages */
+                fwrite(&pl.len, sizeof(pl.len), 1, fp);
+                fwrite(pl.buf, 1, pl.len, fp);
+            }
+        }
+        if(encoded != samples)
+        {
+            fprintf(stderr, "%s encoded %u of %u samples\n", name, encoded, samples);
+            payloadFree(&pl);
+            return RET_FAILURE;
+        }
+    }
+    elapsedUs = getMonotonicUs() - startUs;
+    payloadFree(&pl);
+
+    fprintf(stdout, "%-8s %.2f bytes/sample, %.1f messages/publish, %.1f ns/sample\n", name,
+                (DOUBLE)bytes / ((UINT64)samples * iterations), (DOUBLE)messages / iterations,
+                (DOUBLE)elapsedUs * 1000 / ((UINT64)samples * iterations));
+    return RET_OK;
+}
+
+/****************************************************************
+* Main
+****************************************************************/
+INT32 main(INT32 argc, CHAR **argv)
+{
+    INT32	rc = 0;
+    CHAR	*path = NULL;
+    FILE	*fp = NULL;
+    UINT16	sensors = 3, publishSec = 60, idx = 0;
+    UINT32	interval = MS_PER_SEC, maxLen = MQTT_MAX_PAYLOAD_DEFAULT, iterations = 1000, samples = 0, stepBackMs = 0;
+
+    while((rc = getopt(argc, argv, "n:r:s:m:i:w:b:h")) != RET_FAILURE)
+    {
+        switch (rc)
+        {
+            case 'n': sensors = (UINT16)atoi(optarg); break;
+            case 'r': interval = (UINT32)atoi(optarg); break;
+            case 's': publishSec = (UINT16)atoi(optarg); break;
+            case 'm': maxLen = (UINT32)atoi(optarg); break;
+            case 'i': iterations = (UINT32)atoi(optarg); break;
+            case 'w': path = optarg; break;
+            case 'b': stepBackMs = (UINT32)atoi(optarg); break;
+            default:
+                printUsage();
+                return RET_FAILURE;
+        }
+    }
+
+    if(!sensors || !interval || !publishSec || interval > (UINT32)publishSec * MS_PER_SEC ||
+       maxLen < MQTT_MAX_PAYLOAD_MIN || !iterations)
+    {
+        printUsage();
+        return RET_FAILURE;
+    }
+
+    for(idx = 0; idx < sensors; idx++)
+    {
+        if(sensorTableAdd(&benchTbl, (UINT16)(idx + 1)) == RET_FAILURE)
+            return RET_FAILURE;
+        benchTbl.intervalMs[idx] = interval;
+    }
+
+    if(windowInit(&benchWin, &benchTbl, publishSec) != RET_OK ||
+       ringInit(&benchRing, (UINT32)sensors * RING_SLOTS_PER_SENSOR) != RET_OK)
+        return RET_FAILURE;
+
+    samples = fillWindows(interval, publishSec, stepBackMs);
+    fprintf(stdout, "sensors %u, interval %u ms, publish %u s, %u samples per publish, max payload %u\n",
+                sensors, interval, publishSec, samples, maxLen);
+
+    if(path && (fp = fopen(path, "wb")) == NULL)
+    {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return RET_FAILURE;
+    }
+
+    rc = RET_OK;
+    if(runEncoding("json", PAYLOAD_JSON, maxLen, samples, iterations, NULL) != RET_OK ||
+       runEncoding("binary", PAYLOAD_BINARY, maxLen, samples, iterations, fp) != RET_OK ||
+       checkBinary(maxLen, samples) != RET_OK)
+        rc = RET_FAILURE;
+
+    if(fp)
+        fclose(fp);
+    windowFree(&benchWin);
+    ringFree(&benchRing);
+    sensorTableFree(&benchTbl);
+    return rc;
+}
+
+/* EOF */
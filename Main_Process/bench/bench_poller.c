@@ -0,0 +1,142 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		Option to poll one simulator over many connections
+*	17/10/2026		1.2			Ganesh		Devices addressed by unit ID
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include <sys/resource.h>
+#include "general.h"
+
+/*** Globals ***/
+UINT64	flag1;
+BOOL	debug,modDebug;
+static SENSOR_TABLE	benchTbl;
+static RING			benchRing = {.efd = RET_FAILURE};
+static SAMPLE		benchBatch[STORE_BATCH_MAX];
+
+static void printUsage(void)
+{
+    fprintf(stdout,"Usage: bench_poller [OPTIONS]\n");
+    fprintf(stdout,"Options:\n");
+    fprintf(stdout,"  -i <ip>               Sensor simulator IP (default 127.0.0.1)\n");
+    fprintf(stdout,"  -p <port>             First Modbus TCP port, sensors use port..port+n-1\n");
+    fprintf(stdout,"  -n <count>            Number of sensors to poll\n");
+    fprintf(stdout,"  -s                    Every sensor on the first port, one simulator serves them all\n");
+    fprintf(stdout,"  -u <devices>          Sensors per port, addressed by unit ID 1..n like a simulator fleet\n");
+    fprintf(stdout,"  -r <ms>               Read interval of every sensor (default 1000)\n");
+    fprintf(stdout,"  -c <registers>        Registers read per request (default 1)\n");
+    fprintf(stdout,"  -q <depth>            Pipelined requests per connection (default 1)\n");
+    fprintf(stdout,"  -t <seconds>          Benchmark duration (default 30)\n");
+}
+
+static DOUBLE cpuSeconds(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return (DOUBLE)ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+           (DOUBLE)ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+/****************************************************************
+* Main
+****************************************************************/
+INT32 main(INT32 argc, CHAR **argv)
+{
+    INT32	rc = 0;
+    CHAR	*ip = "127.0.0.1";
+    UINT16	port = 0, count = 0, duration = 30, idx = 0;
+    UINT32	interval = MS_PER_SEC;
+    UINT8	regCount = 1, depth = 1;
+    UINT16	units = 1;
+    BOOL	shared = FALSE;
+    UINT64	samples = 0, startMs = 0, endMs = 0;
+    DOUBLE	cpuStart = 0, wall = 0, cpu = 0;
+    RING	*out[1] = {&benchRing};
+    UINT32	n = 0;
+
+    while((rc = getopt(argc, argv, "i:p:n:su:r:c:q:t:h")) != RET_FAILURE)
+    {
+        switch (rc)
+        {
+            case 'i': ip = optarg; break;
+            case 'p': port = (UINT16)atoi(optarg); break;
+            case 'n': count = (UINT16)atoi(optarg); break;
+            case 's': shared = TRUE; break;
+            case 'u': units = (UINT16)atoi(optarg); break;
+            case 'r': interval = (UINT32)atoi(optarg); break;
+            case 'c': regCount = (UINT8)atoi(optarg); break;
+            case 'q': depth = (UINT8)atoi(optarg); break;
+            case 't': duration = (UINT16)atoi(optarg); break;
+            default:
+                printUsage();
+                return RET_FAILURE;
+        }
+    }
+
+    if(!port || !count || !units || !interval || !duration || !regCount || regCount > MODBUS_BLOCK_MAX_REGS ||
+       !depth || depth > MODBUS_MAX_INFLIGHT)
+    {
+        printUsage();
+        return RET_FAILURE;
+    }
+
+    for(idx = 0; idx < count; idx++)
+    {
+        if(sensorTableAdd(&benchTbl, (UINT16)(idx + 1)) == RET_FAILURE)
+            return RET_FAILURE;
+        benchTbl.ip[idx] = strdup(ip);
+        benchTbl.port[idx] = shared ? port : (UINT16)(port + idx / units);
+        if(units > 1)
+            benchTbl.unitId[idx] = (UINT8)(idx % units + 1);
+        benchTbl.intervalMs[idx] = interval;
+        benchTbl.regCount[idx] = regCount;
+        benchTbl.depth[idx] = depth;
+    }
+
+    if(ringInit(&benchRing, (UINT32)count * RING_SLOTS_PER_SENSOR) != RET_OK)
+        return RET_FAILURE;
+
+    cpuStart = cpuSeconds();
+    startMs = getMonotonicMs();
+    endMs = startMs + (UINT64)duration * MS_PER_SEC;
+    if(startPoller(&benchTbl, out, 1, 0) != RET_OK)
+        return RET_FAILURE;
+
+    while(getMonotonicMs() < endMs)
+    {
+        n = ringPop(&benchRing, benchBatch, STORE_BATCH_MAX);
+        if(n == 0)
+            ringWait(&benchRing, MS_PER_SEC);
+        samples += n;
+    }
+
+    wall = (DOUBLE)(getMonotonicMs() - startMs) / MS_PER_SEC;
+    cpu = cpuSeconds() - cpuStart;
+    stopPoller();
+    sensorTableFree(&benchTbl);
+    printRingStats(stdout, "bench", &benchRing);
+    ringFree(&benchRing);
+
+    fprintf(stdout, "sensors %u, interval %u ms, %u registers, depth %u, duration %.1f s\n",
+                count, interval, regCount, depth, wall);
+    fprintf(stdout, "samples %llu, %.1f samples/sec (target %.1f)\n", samples, samples / wall, (DOUBLE)count * MS_PER_SEC / interval);
+    fprintf(stdout, "cpu %.2f s, %.2f%% of one core\n", cpu, cpu * 100 / wall);
+
+    return RET_OK;
+}
+
+/* EOF */
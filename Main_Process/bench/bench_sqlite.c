@@ -0,0 +1,211 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include <sched.h>
+#include "general.h"
+
+#define BENCH_DB_DEFAULT		"/tmp/bench_sqlite.db"
+
+/*** Globals ***/
+UINT64	flag1;
+BOOL	debug,modDebug;
+
+static void printUsage(void)
+{
+    fprintf(stdout,"Usage: bench_sqlite [OPTIONS]\n");
+    fprintf(stdout,"Options:\n");
+    fprintf(stdout,"  -f <file>             Database file, recreated (default %s)\n", BENCH_DB_DEFAULT);
+    fprintf(stdout,"  -r <rows>             Rows inserted by each mode (default 2000)\n");
+    fprintf(stdout,"  -n <sensors>          Sensor IDs the rows cycle through (default 3)\n");
+    fprintf(stdout,"  -b <size>             Flush size of the batched mode (default %d)\n", DB_FLUSH_SIZE_DEFAULT);
+    fprintf(stdout,"  -l <ms>               Flush latency of the batched mode (default %d)\n", DB_FLUSH_MS_DEFAULT);
+    fprintf(stdout,"  -y <level>            synchronous of the batched mode, OFF/NORMAL/FULL/EXTRA (default NORMAL)\n");
+}
+
+static INT32 benchSync = DB_SYNC_DEFAULT;
+static SENSOR_TABLE benchTbl;
+
+/*************************************************************************
+* @brief        Inserts rows the way the main process did before group
+*               commit, one formatted INSERT and DELETE per sample in
+*               rollback journal mode.
+*
+* @param[in]    db          SQLite database connection.
+* @param[in]    rows        Number of rows.
+* @param[in]    sensors     Number of sensor IDs.
+*
+* @return       void
+*************************************************************************/
+static void insertLegacy(sqlite3 *db, UINT32 rows, UINT16 sensors)
+{
+    CHAR sql[SIZE_256] = {0};
+    UINT32 i = 0;
+
+    sqlite3_exec(db, "PRAGMA journal_mode=DELETE;", 0, 0, 0);
+    for(i = 0; i < rows; i++)
+    {
+        snprintf(sql, sizeof(sql), "INSERT INTO SensorData (Device_ID, Power_Consumption, TimeMs) VALUES (%d, %d, %llu);",
+                 (i % sensors) + 1, i & 0xFFFF, (unsigned long long)getRealtimeMs());
+        if(sqlite3_exec(db, sql, 0, 0, 0) != SQLITE_OK)
+            fprintf(stderr, "INSERT SQL error: %s\n", sqlite3_errmsg(db));
+        snprintf(sql, sizeof(sql), "DELETE FROM SensorData WHERE TimeMs < %llu;",
+                 (unsigned long long)(getRealtimeMs() - (UINT64)SEC_PER_HOUR * 24 * MS_PER_SEC));
+        if(sqlite3_exec(db, sql, 0, 0, 0) != SQLITE_OK)
+            fprintf(stderr, "DELETE SQL error: %s\n", sqlite3_errmsg(db));
+    }
+}
+
+/*************************************************************************
+* @brief        Inserts rows through the storage stage and waits for the
+*               last commit.
+*
+* @param[in]    path        Database file.
+* @param[in]    rows        Number of rows.
+* @param[in]    sensors     Number of sensor IDs.
+* @param[in]    flushSize   Samples per transaction.
+* @param[in]    flushMs     Flush latency bound.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE insertBatched(const CHAR *path, UINT32 rows, UINT16 sensors, UINT16 flushSize, UINT32 flushMs)
+{
+    SAMPLE sample;
+    RING *ring = NULL;
+    UINT32 i = 0;
+    DB_CONFIG cfg = {.flushSize = flushSize, .flushMs = flushMs, .retentionHours = DB_RETENTION_HOURS_DEFAULT,
+                     .synchronous = benchSync, .cacheKb = DB_CACHE_KB_DEFAULT,
+                     .checkpointPages = DB_CHECKPOINT_PAGES_DEFAULT, .checkpointSec = DB_CHECKPOINT_SEC_DEFAULT,
+                     .engine = DB_ENGINE_SQLITE};
+
+    if(startStore(path, &benchTbl, &cfg) != RET_OK)
+        return RET_FAILURE;
+
+    ring = storeRing();
+    for(i = 0; i < rows; i++)
+    {
+        sample.idx = (UINT16)(i % sensors);
+        sample.id = (UINT16)(sample.idx + 1);
+        sample.power = (UINT16)(i & 0xFFFF);
+        sample.timeMs = getMonotonicMs();
+        sample.epochMs = getRealtimeMs();
+
+        /* Unlike the poller, wait for room so every row is stored */
+        while(ringDepth(ring) > ring->mask)
+            sched_yield();
+        ringPush(ring, &sample);
+    }
+
+    /* Drains the ring and commits the partial last batch */
+    stopStore();
+    printStoreStats(stdout);
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Runs one mode on a fresh database and prints rows/sec.
+*
+* @param[in]    path        Database file.
+* @param[in]    name        Mode name.
+* @param[in]    rows        Number of rows.
+* @param[in]    sensors     Number of sensor IDs.
+* @param[in]    flushSize   Samples per transaction, 0 for the legacy mode.
+* @param[in]    flushMs     Flush latency bound.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE runMode(const CHAR *path, const CHAR *name, UINT32 rows, UINT16 sensors, UINT16 flushSize, UINT32 flushMs)
+{
+    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt = NULL;
+    UINT64 startUs = 0, elapsedUs = 0;
+    INT32 stored = 0;
+
+    unlink(path);
+    if(openStoreDb(path, &db) != RET_OK)
+        return RET_FAILURE;
+
+    startUs = getMonotonicUs();
+    if(flushSize)
+    {
+        if(insertBatched(path, rows, sensors, flushSize, flushMs) != RET_OK)
+        {
+            sqlite3_close(db);
+            return RET_FAILURE;
+        }
+    }
+    else
+        insertLegacy(db, rows, sensors);
+    elapsedUs = getMonotonicUs() - startUs;
+
+    if(sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM SensorData;", -1, &stmt, NULL) == SQLITE_OK &&
+       sqlite3_step(stmt) == SQLITE_ROW)
+        stored = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+
+    fprintf(stdout, "%-8s rows %u, stored %d, %.3f s, %.0f rows/sec\n", name, rows, stored,
+                (DOUBLE)elapsedUs / 1e6, elapsedUs ? ((DOUBLE)rows * 1e6 / elapsedUs) : 0);
+    return RET_OK;
+}
+
+/****************************************************************
+* Main
+****************************************************************/
+INT32 main(INT32 argc, CHAR **argv)
+{
+    INT32	rc = 0;
+    CHAR	*path = BENCH_DB_DEFAULT;
+    UINT32	rows = 2000, flushMs = DB_FLUSH_MS_DEFAULT;
+    UINT16	sensors = 3, flushSize = DB_FLUSH_SIZE_DEFAULT;
+
+    while((rc = getopt(argc, argv, "f:r:n:b:l:y:h")) != RET_FAILURE)
+    {
+        switch (rc)
+        {
+            case 'f': path = optarg; break;
+            case 'r': rows = (UINT32)atoi(optarg); break;
+            case 'n': sensors = (UINT16)atoi(optarg); break;
+            case 'b': flushSize = (UINT16)atoi(optarg); break;
+            case 'l': flushMs = (UINT32)atoi(optarg); break;
+            case 'y': benchSync = storeSyncLevel(optarg); break;
+            default:
+                printUsage();
+                return RET_FAILURE;
+        }
+    }
+
+    if(!rows || !sensors || !flushSize || flushSize > DB_FLUSH_SIZE_MAX || !flushMs || benchSync == RET_FAILURE)
+    {
+        printUsage();
+        return RET_FAILURE;
+    }
+
+    for(rc = 0; rc < sensors; rc++)
+    {
+        if(sensorTableAdd(&benchTbl, (UINT16)(rc + 1)) == RET_FAILURE)
+            return RET_FAILURE;
+    }
+
+    rc = (runMode(path, "legacy", rows, sensors, 0, flushMs) != RET_OK ||
+          runMode(path, "batched", rows, sensors, flushSize, flushMs) != RET_OK) ? RET_FAILURE : RET_OK;
+
+    sensorTableFree(&benchTbl);
+    unlink(path);
+    return rc;
+}
+
+/* EOF */
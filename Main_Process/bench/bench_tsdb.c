@@ -0,0 +1,343 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		Ring history engine
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include "general.h"
+
+#define BENCH_DIR_DEFAULT		"/tmp/bench_tsdb"
+#define BENCH_DB_DEFAULT		"/tmp/bench_tsdb.db"
+#define BENCH_HIST_DEFAULT		"/tmp/bench_history"
+
+/*** Globals ***/
+UINT64	flag1;
+BOOL	debug,modDebug;
+static const UINT64		benchEpochMs = 1791849600000ULL;	/* 2026-10-13 00:00:00 UTC */
+static SENSOR_TABLE		benchTbl;
+
+/* Rows and power total of a query, every engine must agree */
+typedef struct
+{
+    UINT32		rows;
+    UINT64		sum;
+}BENCH_RESULT;
+
+static void printUsage(void)
+{
+    fprintf(stdout,"Usage: bench_tsdb [OPTIONS]\n");
+    fprintf(stdout,"Options:\n");
+    fprintf(stdout,"  -d <dir>              Native store directory, emptied (default %s)\n", BENCH_DIR_DEFAULT);
+    fprintf(stdout,"  -f <file>             SQLite database, recreated (default %s)\n", BENCH_DB_DEFAULT);
+    fprintf(stdout,"  -r <dir>              Ring history directory, recreated (default %s)\n", BENCH_HIST_DEFAULT);
+    fprintf(stdout,"  -t <hours>            History per sensor, one read per second (default 24)\n");
+    fprintf(stdout,"  -n <sensors>          Sensors (default 3)\n");
+    fprintf(stdout,"  -w <watts>            Largest change between reads (default 5)\n");
+    fprintf(stdout,"  -j <ms>               Largest read time jitter (default 3)\n");
+    fprintf(stdout,"  -q <queries>          Queries per range (default 200)\n");
+}
+
+/* Counts a sample of a native range scan */
+static void countSample(void *ctx, UINT16 id, UINT16 power, UINT64 epochMs)
+{
+    BENCH_RESULT *res = (BENCH_RESULT *)ctx;
+
+    res->rows++;
+    res->sum += power;
+}
+
+/*************************************************************************
+* @brief        Builds the same history in every engine.
+*
+* @details      Reads come every second with a few ms of jitter and the
+*               power takes a bounded random walk, as a meter would report.
+*
+* @param[in]    cfg         Native store and ring history settings.
+* @param[in]    db          SQLite database with the SensorData table.
+* @param[in]    samples     Reads per sensor.
+* @param[in]    sensors     Number of sensors.
+* @param[in]    step        Largest power change.
+* @param[in]    jitter      Largest time jitter.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE fillHistory(const DB_CONFIG *cfg, sqlite3 *db, UINT32 samples, UINT16 sensors, UINT32 step,
+                              UINT32 jitter)
+{
+    sqlite3_stmt *stmt = NULL;
+    SAMPLE sample = {0};
+    UINT32 i = 0, level = 0;
+    UINT16 idx = 0;
+    UINT64 startUs = 0, nativeUs = 0, sqliteUs = 0, ringUs = 0;
+
+    if(tsOpen(cfg, sensors) != RET_OK || histOpen(cfg, &benchTbl, TRUE) != RET_OK ||
+       sqlite3_prepare_v2(db, "INSERT INTO SensorData (Device_ID, Power_Consumption, TimeMs) VALUES (?, ?, ?);",
+                          -1, &stmt, NULL) != SQLITE_OK)
+        return RET_FAILURE;
+
+    sqlite3_exec(db, "BEGIN;", 0, 0, 0);
+    for(idx = 0; idx < sensors; idx++)
+    {
+        level = 1000 + (UINT32)rand() % 1000;
+        for(i = 0; i < samples; i++)
+        {
+            level += (UINT32)rand() % (2 * step + 1);
+            level = (level > step) ? (level - step) : 0;
+
+            sample.idx = idx;
+            sample.id = (UINT16)(idx + 1);
+            /* The ring history keeps HIST_EMPTY for a missing reading */
+            sample.power = (UINT16)((level >= HIST_EMPTY) ? (HIST_EMPTY - 1) : level);
+            sample.epochMs = benchEpochMs + (UINT64)i * MS_PER_SEC + (jitter ? ((UINT32)rand() % (jitter + 1)) : 0);
+            sample.timeMs = getMonotonicMs();
+
+            startUs = getMonotonicUs();
+            tsAppend(&sample);
+            nativeUs += getMonotonicUs() - startUs;
+
+            startUs = getMonotonicUs();
+            histWrite(&sample);
+            ringUs += getMonotonicUs() - startUs;
+
+            startUs = getMonotonicUs();
+            sqlite3_bind_int(stmt, 1, sample.id);
+            sqlite3_bind_int(stmt, 2, sample.power);
+            sqlite3_bind_int64(stmt, 3, (sqlite3_int64)sample.epochMs);
+            if(sqlite3_step(stmt) != SQLITE_DONE)
+                fprintf(stderr, "INSERT SQL error: %s\n", sqlite3_errmsg(db));
+            sqlite3_reset(stmt);
+            sqliteUs += getMonotonicUs() - startUs;
+        }
+    }
+
+    startUs = getMonotonicUs();
+    sqlite3_exec(db, "COMMIT;", 0, 0, 0);
+    sqliteUs += getMonotonicUs() - startUs;
+    sqlite3_finalize(stmt);
+
+    /* Writes the open blocks and the mappings, then reopens read only as the export does */
+    startUs = getMonotonicUs();
+    tsClose();
+    nativeUs += getMonotonicUs() - startUs;
+    startUs = getMonotonicUs();
+    histClose();
+    ringUs += getMonotonicUs() - startUs;
+    if(tsOpen(cfg, 0) != RET_OK || histOpen(cfg, &benchTbl, FALSE) != RET_OK)
+        return RET_FAILURE;
+
+    fprintf(stdout, "insert   native %.0f samples/sec, ring %.0f samples/sec, sqlite %.0f samples/sec\n",
+                nativeUs ? ((DOUBLE)samples * sensors * 1e6 / nativeUs) : 0,
+                ringUs ? ((DOUBLE)samples * sensors * 1e6 / ringUs) : 0,
+                sqliteUs ? ((DOUBLE)samples * sensors * 1e6 / sqliteUs) : 0);
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Runs the same random range queries on every engine.
+*
+* @param[in]    db          SQLite database.
+* @param[in]    samples     Reads per sensor.
+* @param[in]    sensors     Number of sensors.
+* @param[in]    rangeSec    Length of each range.
+* @param[in]    queries     Number of queries.
+*
+* @return       ERROR_CODE  Returns RET_OK if every engine returns the same
+*                           rows, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE runRange(sqlite3 *db, UINT32 samples, UINT16 sensors, UINT32 rangeSec, UINT32 queries)
+{
+    sqlite3_stmt *stmt = NULL;
+    BENCH_RESULT native = {0}, ring = {0}, sql = {0};
+    UINT64 fromMs = 0, toMs = 0, startUs = 0, nativeUs = 0, ringUs = 0, sqliteUs = 0;
+    UINT32 q = 0, spanSec = (samples > rangeSec) ? (samples - rangeSec) : 1;
+    UINT16 id = 0;
+
+    if(sqlite3_prepare_v2(db, "SELECT Power_Consumption FROM SensorData WHERE Device_ID = ?1 AND "
+                              "TimeMs BETWEEN ?2 AND ?3 ORDER BY TimeMs;", -1, &stmt, NULL) != SQLITE_OK)
+        return RET_FAILURE;
+
+    for(q = 0; q < queries; q++)
+    {
+        id = (UINT16)(1 + (UINT32)rand() % sensors);
+        fromMs = benchEpochMs + ((UINT64)((UINT32)rand() % spanSec) * MS_PER_SEC);
+        toMs = fromMs + (UINT64)rangeSec * MS_PER_SEC - 1;
+
+        startUs = getMonotonicUs();
+        tsScan(id, fromMs, toMs, countSample, &native);
+        nativeUs += getMonotonicUs() - startUs;
+
+        startUs = getMonotonicUs();
+        histScan(id, fromMs, toMs, countSample, &ring);
+        ringUs += getMonotonicUs() - startUs;
+
+        startUs = getMonotonicUs();
+        sqlite3_bind_int(stmt, 1, id);
+        sqlite3_bind_int64(stmt, 2, (sqlite3_int64)fromMs);
+        sqlite3_bind_int64(stmt, 3, (sqlite3_int64)toMs);
+        while(sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            sql.rows++;
+            sql.sum += (UINT64)sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_reset(stmt);
+        sqliteUs += getMonotonicUs() - startUs;
+    }
+    sqlite3_finalize(stmt);
+
+    fprintf(stdout, "range %5u s, %u queries: native %.1f us/query, ring %.1f us/query, sqlite %.1f us/query, rows %u\n",
+                rangeSec, queries, (DOUBLE)nativeUs / queries, (DOUBLE)ringUs / queries, (DOUBLE)sqliteUs / queries,
+                sql.rows);
+
+    if(native.rows != sql.rows || native.sum != sql.sum || ring.rows != sql.rows || ring.sum != sql.sum)
+    {
+        fprintf(stderr, "Native store returned %u rows (sum %llu), ring %u rows (sum %llu), SQLite %u rows (sum %llu)\n",
+                    native.rows, (unsigned long long)native.sum, ring.rows, (unsigned long long)ring.sum, sql.rows,
+                    (unsigned long long)sql.sum);
+        return RET_FAILURE;
+    }
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Times copying the latest readings out of the ring history.
+*
+* @param[in]    sensors     Number of sensors.
+* @param[in]    count       Readings per query.
+* @param[in]    queries     Number of queries.
+*
+* @return       void
+*************************************************************************/
+static void runRecent(UINT16 sensors, UINT32 count, UINT32 queries)
+{
+    UINT16 *out = calloc(count, sizeof(UINT16));
+    UINT64 lastMs = 0, startUs = 0;
+    UINT32 q = 0, got = 0;
+
+    if(!out)
+        return;
+
+    startUs = getMonotonicUs();
+    for(q = 0; q < queries; q++)
+        got = histRecent((UINT16)(q % sensors), count, out, &lastMs);
+
+    fprintf(stdout, "recent %5u slots, %u queries: ring %.2f us/query, %u slots\n", count, queries,
+                (DOUBLE)(getMonotonicUs() - startUs) / queries, got);
+    free(out);
+}
+
+/****************************************************************
+* Main
+****************************************************************/
+INT32 main(INT32 argc, CHAR **argv)
+{
+    static const UINT32 rangeSec[] = {60, 3600};
+    INT32	rc = 0;
+    CHAR	*path = BENCH_DB_DEFAULT, file[SIZE_256] = {0};
+    UINT32	hours = 24, step = 5, jitter = 3, queries = 200, samples = 0, i = 0;
+    UINT16	sensors = 3;
+    UINT64	total = 0;
+    INT32	pages = 0, pageSize = 0;
+    sqlite3	*db = NULL;
+    sqlite3_stmt *stmt = NULL;
+    DB_CONFIG cfg = {.tsPath = BENCH_DIR_DEFAULT, .histPath = BENCH_HIST_DEFAULT, .sealSec = TS_SEAL_SEC_DEFAULT};
+
+    while((rc = getopt(argc, argv, "d:f:r:t:n:w:j:q:h")) != RET_FAILURE)
+    {
+        switch (rc)
+        {
+            case 'd': cfg.tsPath = optarg; break;
+            case 'r': cfg.histPath = optarg; break;
+            case 'f': path = optarg; break;
+            case 't': hours = (UINT32)atoi(optarg); break;
+            case 'n': sensors = (UINT16)atoi(optarg); break;
+            case 'w': step = (UINT32)atoi(optarg); break;
+            case 'j': jitter = (UINT32)atoi(optarg); break;
+            case 'q': queries = (UINT32)atoi(optarg); break;
+            default:
+                printUsage();
+                return RET_FAILURE;
+        }
+    }
+
+    if(!hours || !sensors || !queries)
+    {
+        printUsage();
+        return RET_FAILURE;
+    }
+
+    samples = hours * SEC_PER_HOUR;
+    total = (UINT64)samples * sensors;
+    cfg.retentionHours = (UINT16)hours;
+    srand(1);
+
+    /* One read per second, the ring holds exactly the history */
+    for(i = 0; i < sensors; i++)
+    {
+        if(sensorTableAdd(&benchTbl, (UINT16)(i + 1)) == RET_FAILURE)
+            return RET_FAILURE;
+        benchTbl.intervalMs[i] = MS_PER_SEC;
+        snprintf(file, sizeof(file), "%s/%u.hist", cfg.histPath, i + 1);
+        unlink(file);
+    }
+
+    /* Starts every engine empty */
+    if(tsOpen(&cfg, 0) != RET_OK)
+        return RET_FAILURE;
+    tsPurge(~0ULL);
+    tsClose();
+    unlink(path);
+    if(openStoreDb(path, &db) != RET_OK)
+        return RET_FAILURE;
+
+    if(fillHistory(&cfg, db, samples, sensors, step, jitter) != RET_OK)
+    {
+        sqlite3_close(db);
+        return RET_FAILURE;
+    }
+
+    /* Page count after a VACUUM is what the rows and the TimeMs index take */
+    sqlite3_exec(db, "PRAGMA wal_checkpoint(TRUNCATE); VACUUM;", 0, 0, 0);
+    if(sqlite3_prepare_v2(db, "SELECT page_count, page_size FROM pragma_page_count, pragma_page_size;",
+                          -1, &stmt, NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        pages = sqlite3_column_int(stmt, 0);
+        pageSize = sqlite3_column_int(stmt, 1);
+    }
+    sqlite3_finalize(stmt);
+
+    fprintf(stdout, "samples  %llu of %u sensors\n", (unsigned long long)total, sensors);
+    fprintf(stdout, "size     native %llu bytes, %.2f bytes/sample; ring %llu bytes, %.2f bytes/sample; "
+                    "sqlite %llu bytes, %.2f bytes/sample\n",
+                (unsigned long long)tsDiskBytes(), (DOUBLE)tsDiskBytes() / total,
+                (unsigned long long)histDiskBytes(), (DOUBLE)histDiskBytes() / total,
+                (unsigned long long)pages * pageSize, (DOUBLE)pages * pageSize / total);
+
+    rc = RET_OK;
+    for(i = 0; i < sizeof(rangeSec) / sizeof(rangeSec[0]); i++)
+    {
+        if(runRange(db, samples, sensors, rangeSec[i], queries) != RET_OK)
+            rc = RET_FAILURE;
+        runRecent(sensors, rangeSec[i], queries);
+    }
+
+    tsClose();
+    histClose();
+    sensorTableFree(&benchTbl);
+    sqlite3_close(db);
+    unlink(path);
+    return rc;
+}
+
+/* EOF */
@@ -0,0 +1,31 @@
+#!/bin/sh
+#Energy Monitor System - Modbus polling benchmark
+#Starts N sensor simulators on consecutive ports and polls them all at 1 Hz
+#With "shared" one simulator serves all N connections on the first port
+#Usage: bench/run_poll_bench.sh <count> [first port] [seconds] [shared]
+
+COUNT=${1:-100}
+PORT=${2:-15020}
+SECS=${3:-30}
+MODE=${4:-}
+SIM=../Sensor_Simulator/bin/ems_simulator
+
+[ -x $SIM ] || { echo "Build $SIM first"; exit 1; }
+ulimit -n 4096
+
+if [ "$MODE" = shared ]; then
+	$SIM -s 1 -m 10 -M 120 -p $PORT -c $COUNT -r $SECS &
+	sleep 1
+	./bin/bench_poller -p $PORT -n $COUNT -s -t $SECS 2>/dev/null
+else
+	i=0
+	while [ $i -lt $COUNT ]; do
+		$SIM -s 1 -m 10 -M 120 -p $((PORT + i)) > /dev/null 2>&1 &
+		i=$((i + 1))
+	done
+	sleep 1
+	./bin/bench_poller -p $PORT -n $COUNT -t $SECS 2>/dev/null
+fi
+
+kill $(jobs -p) 2>/dev/null
+wait 2>/dev/null
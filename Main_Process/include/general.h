@@ -23,6 +23,22 @@
 #include <time.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
 #include <modbus/modbus.h>
 #include <sqlite3.h>
 #include <mosquitto.h>
@@ -33,18 +49,111 @@
 *Macros
 */
 #define APP_VERSION				"MP 1.2.0 09042025"
-#define MAX_SENS_SIMULATOR		3
+#define MAX_SENSORS				65535
+#define SENSOR_TABLE_MIN_SIZE	16
 #define MIN_MQTT_PUB_INTERVAL	1
 #define MAX_MQTT_PUB_INTERVAL	59
-#define MQTT_PAYLOAD_MIN_SIZE   2
+#define MQTT_MAX_PAYLOAD_DEFAULT	16384	/* Bytes per MQTT message, larger payloads are split */
+#define MQTT_MAX_PAYLOAD_MIN	256
+#define MQTT_QOS_DEFAULT		1
+#define MQTT_INFLIGHT_DEFAULT	20		/* Messages published and not yet acknowledged */
+#define MQTT_INFLIGHT_MAX		1024
+#define MQTT_INFLIGHT_AGE_MS	30000	/* Unacknowledged longer, a message is taken as lost */
+#define PAYLOAD_MIN_SIZE		1024	/* First allocation of the payload buffer */
+#define PAYLOAD_RECORD_MAX		96		/* Longest JSON record of one sample */
+#define PAYLOAD_VARINT_MAX		10		/* Longest LEB128 varint of 64 bits */
+#define PAYLOAD_BIN_MAGIC		0xEB
+#define PAYLOAD_BIN_VERSION		2
+#define PAYLOAD_BIN_COUNT_LEN	3		/* Sample count of a block, patched in place */
+#define PAYLOAD_BIN_BLOCK_MAX	((1 << 21) - 1)
 
 #define CONFIG_FILE				"/root/config/config.ini"
 #define MQTT_CLIENT_ID			"ems_main_proc"
 #define MQTT_TOPIC				"sensor/data"
 #define DB_NAME					"/root/sensor_data.db"
 
+#define SENSOR_SECTION			"sensor"
+#define MS_PER_SEC				1000
+
+/* Modbus TCP client */
+#define MODBUS_UNIT_ID			0xFF
+#define MODBUS_MBAP_LENGTH		7
+#define MODBUS_READ_REQ_LENGTH	12
+#define MODBUS_BLOCK_MAX_REGS	32		/* Registers per block read */
+#define MODBUS_MAX_INFLIGHT		16		/* Pipelined requests per link */
+#define MODBUS_CONNECT_TIMEOUT_MS	3000
+#define MODBUS_RESPONSE_TIMEOUT_MS	500
+#define MODBUS_DEGRADED_LIMIT	3		/* Consecutive failed requests before the link is dropped */
+#define MODBUS_BACKOFF_MIN_MS	500
+#define MODBUS_BACKOFF_MAX_MS	60000
+#define POLL_EPOLL_EVENTS		64
+#define POLL_TIMER_EVENT		0xFFFFFFFF	/* epoll data of the scheduler timerfd */
+#define JITTER_BUCKETS			10
+#define POLL_MAX_OUTPUTS		4		/* Rings fed by the acquisition thread */
+#define DEADBAND_HEARTBEAT_DEFAULT	300		/* Max silence in seconds of a sensor with a deadband */
+
+/* Sample rings between pipeline stages */
+#define RING_CACHE_LINE			64
+#define RING_MIN_SIZE			1024
+#define RING_SLOTS_PER_SENSOR	8		/* Samples a consumer may fall behind per sensor */
+#define STORE_BATCH_MAX			256		/* Samples taken from the ring per wakeup */
+
+/* Rolling window of recent samples for publishing */
+#define WINDOW_MIN_SIZE			4
+#define PUBLISH_DRAIN_MS		250		/* Period the publish ring is moved into the windows */
+
+/* SQLite group commit */
+#define DB_SECTION				"database"
+#define DB_FLUSH_SIZE_DEFAULT	256		/* Samples per transaction */
+#define DB_FLUSH_SIZE_MAX		4096
+#define DB_FLUSH_MS_DEFAULT		1000	/* Longest a sample waits for its commit */
+#define DB_RETENTION_HOURS_DEFAULT	24
+#define DB_PURGE_INTERVAL_MS	60000	/* Retention check period */
+#define DB_PURGE_CHUNK			1000	/* Rows deleted per purge statement */
+#define SEC_PER_HOUR			3600
+#define DB_SYNC_DEFAULT			1		/* PRAGMA synchronous = NORMAL, safe with WAL */
+#define DB_CACHE_KB_DEFAULT		2000	/* SQLite's own default page cache */
+#define DB_CHECKPOINT_PAGES_DEFAULT	1000	/* PRAGMA wal_autocheckpoint, 0 disables it */
+#define DB_CHECKPOINT_SEC_DEFAULT	300		/* Timed passive checkpoint, 0 disables it */
+#define DB_BUSY_TIMEOUT_MS		5000
+
+/* Native compressed time series store */
+#define TS_PATH_DEFAULT			"/root/tsdb"
+#define TS_SEAL_SEC_DEFAULT		60		/* Longest an open block stays in memory */
+#define TS_SEGMENT_SEC			3600	/* Span of one segment file, retention drops whole files */
+#define TS_BLOCK_BYTES			2048	/* Encoded samples per block */
+#define TS_SAMPLE_BYTES_MAX		8		/* Longest encoded sample, 36 + 20 bits */
+#define TS_BLOCK_MAGIC			0x4B4C4254	/* "TBLK" */
+
+/* Memory mapped ring history, one slot per read interval */
+#define HIST_PATH_DEFAULT		"/root/history"
+#define HIST_MAGIC				0x54534948	/* "HIST" */
+#define HIST_EMPTY				0xFFFF		/* Slot without a reading, a read of 0xFFFF is stored as 0xFFFE */
+
+/* Store and forward spool of unsent MQTT messages */
+#define SPOOL_SECTION			"spool"
+#define SPOOL_PATH_DEFAULT		"/root/mqtt_spool.dat"
+#define SPOOL_SIZE_KB_DEFAULT	16384	/* 0 disables the spool */
+#define SPOOL_RATE_DEFAULT		16384	/* Replay bytes/sec */
+#define SPOOL_MAGIC				0x4C4F5053	/* "SPOL" */
+#define SPOOL_VERSION			2
+#define SPOOL_DATA_OFFSET		4096	/* Header page, records follow */
+#define SPOOL_ALIGN				8
+#define SPOOL_PAD				0xFFFFFFFF	/* Record flag, the rest of the file is unused */
+
+/* Windowed aggregates published instead of, or with, the raw samples */
+#define AGG_SECTION				"aggregate"
+#define AGG_WINDOWS_MAX			4		/* Window lengths per sensor */
+#define AGG_RECORD_MAX			192		/* Longest JSON record of one aggregate */
+#define AGG_OUT_MIN_SIZE		64		/* First allocation of the closed aggregates */
+#define INFLIGHT_UNTRACKED		(~0ULL)	/* spoolSeq of a message neither live nor replayed */
+
 //for Flags use only
 extern UINT64 flag1;
+extern BOOL debug,modDebug;
+
+#define MODBUS_DEBUG			modDebug
+#define DEBUG_LOG				debug
 
 #define	POWER_ON				0
 #define	MQTT_CONNECTED			1
@@ -60,47 +169,492 @@ extern UINT64 flag1;
 typedef enum {
     STATE_INIT,
     STATE_CONNECT_MODBUS,
-	STATE_CONNECT_MQTT,
-    STATE_READ_MODBUS,
-    STATE_INSERT_DB,
+    STATE_WAIT_PUBLISH,
     STATE_PUBLISH_MQTT,
     STATE_ERROR
 } STATE_TYPE;
 
+/* Modbus TCP link states, owned by the poller event loop */
+typedef enum {
+    LINK_IDLE,          /* Never connected */
+    LINK_CONNECTING,    /* Non-blocking connect in progress */
+    LINK_HEALTHY,       /* Connected, last request answered */
+    LINK_DEGRADED,      /* Connected, recent requests failed */
+    LINK_BACKOFF        /* Dropped, waiting to reconnect */
+} LINK_STATE;
+
 /*
 *Structure
 */
+/* Per sensor acquisition counters, used to verify achieved vs. configured rate */
+typedef struct
+{
+    UINT32		samples;		/* Successful reads */
+    UINT32		failures;		/* Failed connects or reads, lost slots */
+    UINT32		reconnects;		/* Successful connects after the first one */
+    UINT32		recoveries;		/* Outages ended by a successful read */
+    UINT32		recoverLastMs;	/* Time from first failure to data flowing again */
+    UINT32		recoverMaxMs;
+    UINT64		recoverTotalMs;
+    UINT64		startMs;		/* Monotonic time the poller was started */
+    UINT32		missed;			/* Slots skipped because the loop fell behind */
+    UINT32		jitterMaxUs;
+    UINT64		jitterTotalUs;
+    UINT32		jitterHist[JITTER_BUCKETS];	/* Delay of each read behind its slot */
+    UINT32		suppressed;		/* Reads within the deadband, not passed on */
+    UINT32		heartbeats;		/* Reads within the deadband passed on after max silence */
+}POLL_STATS;
+
+/*
+* Report by exception of one sensor. A read is passed on when it moves
+* more than both abs and pct of the last value passed on, or when nothing
+* was passed on for heartbeatMs. Touched by the acquisition thread only.
+*/
+typedef struct
+{
+    BOOL		enabled;
+    UINT16		abs;			/* Absolute change */
+    UINT16		pct100;			/* Percent change, in hundredths */
+    UINT32		heartbeatMs;	/* Max silence, 0 for none */
+    BOOL		reported;		/* lastPower is valid */
+    UINT16		lastPower;		/* Last value passed on */
+    UINT64		lastMs;			/* Monotonic time it was read */
+}DEADBAND;
+
+/* Min-heap of per sensor deadlines driving one timerfd */
+typedef struct
+{
+    INT32		fd;				/* timerfd, CLOCK_MONOTONIC */
+    UINT32		size;
+    UINT16		*heap;			/* Sensor indexes ordered by deadline */
+    UINT32		*pos;			/* Heap position of each sensor */
+    UINT64		*key;			/* Deadline of each sensor */
+    UINT64		armedMs;		/* Deadline the timerfd is armed on */
+}SCHED;
+
+/* Non-blocking Modbus TCP connection of one sensor, touched only on I/O */
+typedef struct
+{
+    INT32		fd;
+    BOOL		due;			/* A read slot is waiting to be served */
+    UINT8		inflight;		/* Requests outstanding */
+    UINT16		tid;			/* Last transaction ID sent */
+    UINT64		sentMs;			/* Connect start time */
+    UINT8		failStreak;		/* Consecutive failed requests */
+    BOOL		everUp;			/* Connected at least once */
+    UINT32		backoffMs;		/* Current reconnect backoff */
+    UINT64		retryMs;		/* Reconnect time while in LINK_BACKOFF */
+    UINT64		downMs;			/* Start of the current outage, 0 if none */
+    UINT16		pendTid[MODBUS_MAX_INFLIGHT];	/* Outstanding transaction IDs, oldest first */
+    UINT64		pendMs[MODBUS_MAX_INFLIGHT];	/* Send time of each outstanding request */
+    UINT16		rxLen;
+    UINT8		rx[MODBUS_TCP_MAX_ADU_LENGTH];
+}MODBUS_LINK;
+
+/*
+* Sensor table, one row per [sensorN] section of the configuration.
+* Each column is its own contiguous array so the timer scan and the
+* storage/publish loops only walk the fields they use.
+*/
+typedef struct
+{
+    UINT16		count;
+    UINT16		capacity;
+    UINT16		*id;			/* N of [sensorN], used as Device_ID */
+    CHAR		**ip;
+    UINT16		*port;
+    UINT8		*unitId;		/* Modbus unit ID, a device behind a gateway */
+    UINT32		*intervalMs;	/* Read interval in milliseconds */
+    UINT16		*regStart;		/* First holding register of the block */
+    UINT8		*regCount;		/* Registers in the block */
+    UINT8		*depth;			/* Max pipelined requests */
+    UINT16		*regs;			/* Last block read, MODBUS_BLOCK_MAX_REGS per sensor, acquisition thread only */
+    UINT8		*state;			/* LINK_STATE */
+    UINT64		*nextMs;		/* Next read slot, t0 + k * interval */
+    POLL_STATS	*stats;
+    MODBUS_LINK	*link;
+    DEADBAND	*deadband;
+}SENSOR_TABLE;
+
+/* Fixed size record passed between pipeline stages */
+typedef struct
+{
+    UINT16		idx;			/* Row in the sensor table */
+    UINT16		id;				/* Sensor ID */
+    UINT16		power;			/* First register of the block */
+    BOOL		suppressed;		/* Within the deadband, aggregated but neither stored nor published raw */
+    UINT64		timeMs;			/* Monotonic time the reply was received */
+    UINT64		epochMs;		/* Wall clock of the same instant, UTC ms since the epoch */
+}SAMPLE;
+
+/*
+* Bounded lock-free single producer / single consumer ring of samples.
+* The producer never blocks, a push to a full ring drops the sample and
+* counts it. head and tail sit on their own cache lines so the two
+* threads do not false share.
+*/
+typedef struct
+{
+    _Alignas(RING_CACHE_LINE) _Atomic UINT32 head;	/* Next slot written, producer only */
+    _Atomic UINT32	drops;
+    _Atomic UINT32	pushed;
+    UINT32			peak;		/* Highest depth seen by the producer */
+    _Alignas(RING_CACHE_LINE) _Atomic UINT32 tail;	/* Next slot read, consumer only */
+    _Atomic BOOL	waiting;	/* Consumer sleeps on efd */
+    _Alignas(RING_CACHE_LINE) UINT32 mask;
+    INT32			efd;		/* eventfd waking the consumer */
+    SAMPLE			*slot;
+}RING;
+
+/*
+* Per sensor rolling windows of recent samples, fed from acquisition and
+* read by the publish stage. Sensor idx owns entries base[idx] ..
+* base[idx] + mask[idx] of power[] and epochMs[]. head and sent count
+* samples, so head - sent is what is still to publish and sent -
+* delivered what the broker has not acknowledged yet.
+*/
+typedef struct
+{
+    UINT16		count;
+    UINT32		*base;
+    UINT32		*mask;			/* Capacity - 1, capacity is a power of two */
+    UINT32		*head;			/* Samples written */
+    UINT32		*sent;			/* Samples published */
+    UINT32		*delivered;		/* Samples acknowledged by the broker */
+    UINT32		*overruns;		/* Samples overwritten before they were published */
+    UINT16		*power;
+    UINT64		*epochMs;		/* Wall clock the sample was read, UTC ms */
+}SAMPLE_WINDOW;
+
+/* MQTT wire formats, [mqtt] encoding */
+typedef enum
+{
+	PAYLOAD_JSON = 0,
+	PAYLOAD_BINARY
+}PAYLOAD_ENCODING;
+
+/* Growable buffer building one MQTT message at a time */
+typedef struct
+{
+    CHAR		*buf;
+    UINT32		len;
+    UINT32		cap;
+    UINT32		maxLen;			/* Messages are closed before they grow past this */
+    UINT32		records;		/* Samples in the message */
+    UINT8		encoding;		/* PAYLOAD_ENCODING */
+}PAYLOAD;
+
+/* Next sample to encode, window idx and its sequence number */
+typedef struct
+{
+    UINT16		idx;
+    UINT32		seq;
+}PAYLOAD_CURSOR;
+
+/* Message published and not yet acknowledged */
+typedef struct
+{
+    INT32		mid;
+    BOOL		acked;
+    BOOL		lost;			/* Dropped by mosquitto with the connection */
+    BOOL		live;			/* From the windows, otherwise replayed from the spool */
+    PAYLOAD_CURSOR	from;		/* Samples carried, from is the first and to is past the last */
+    PAYLOAD_CURSOR	to;
+    UINT32		*start;			/* Send position of sensors from.idx..to.idx before the publish */
+    UINT32		*end;			/* Send position of sensors from.idx..to.idx after the publish */
+    UINT64		spoolSeq;
+    UINT32		records;
+    UINT64		sentUs;			/* Publish or reconnect time, the age limit counts from it */
+    CHAR		*copy;			/* Aggregate message, spooled if it is lost */
+    UINT32		copyLen;
+    UINT32		copyCap;
+}INFLIGHT;
+
+/* Spool file header, head and tail count bytes ever written and released */
+typedef struct
+{
+    UINT32		magic;
+    UINT32		version;
+    UINT64		capacity;		/* Bytes of records after the header page */
+    UINT64		head;
+    UINT64		tail;
+    UINT32		records;
+    UINT64		seq;			/* Sequence number of the next record */
+}SPOOL_HEADER;
+
+/* Spool record, followed by len bytes of message padded to SPOOL_ALIGN */
+typedef struct
+{
+    UINT32		len;
+    UINT32		flags;
+    UINT64		timeMs;			/* Wall clock when the message was spooled */
+    UINT64		seq;
+}SPOOL_RECORD;
+
+/* [spool] section of the configuration */
+typedef struct
+{
+    CHAR		*path;
+    UINT32		sizeKb;
+    UINT32		rate;			/* Replay bytes/sec */
+}SPOOL_CONFIG;
+
+/* Aggregate of one sensor over one window, open while samples arrive */
+typedef struct
+{
+    UINT64		startMs;		/* Window start, UTC ms, a multiple of its length */
+    INT64		sum;
+    UINT32		count;
+    UINT16		min;
+    UINT16		max;
+}AGG_STATE;
+
+/* Closed window waiting to be published */
+typedef struct
+{
+    UINT64		startMs;
+    INT64		sum;
+    UINT32		count;
+    UINT32		windowSec;
+    UINT16		id;
+    UINT16		min;
+    UINT16		max;
+}AGG_RECORD;
+
+/* [aggregate] section of the configuration */
+typedef struct
+{
+    UINT32		windowSec[AGG_WINDOWS_MAX];
+    UINT8		windows;		/* 0 publishes raw samples only */
+    BOOL		publishRaw;		/* Raw samples go out with the aggregates */
+}AGG_CONFIG;
+
+/* Storage engines of the [database] section */
+typedef enum {
+    DB_ENGINE_NATIVE = 0,
+    DB_ENGINE_SQLITE,
+    DB_ENGINE_RING
+} DB_ENGINE;
+
+/*
+* Block of one sensor in a segment file, followed by bytes of bit packed
+* samples. The first sample is held here, the others are encoded as
+* delta-of-delta time and delta power, see tsdb.c.
+*/
+typedef struct
+{
+    UINT32		magic;
+    UINT16		count;			/* Samples, including the first */
+    UINT16		bytes;			/* Encoded bytes after the header */
+    UINT64		firstMs;		/* UTC ms of the first and the last sample */
+    UINT64		lastMs;
+    UINT16		firstPower;
+    UINT16		reserved[3];
+}TS_BLOCK_HEADER;
+
+/* Open block of one sensor, owned by the storage thread */
+typedef struct
+{
+    UINT16		id;
+    INT32		fd;				/* Segment file blocks are appended to */
+    UINT64		fdSegment;		/* Start of that segment, UTC s */
+    UINT64		segment;		/* Segment of the open block */
+    UINT64		openMs;			/* Monotonic time the block was opened */
+    INT64		prevDelta;
+    UINT16		prevPower;
+    UINT32		bits;			/* Bits used in buf */
+    TS_BLOCK_HEADER	hdr;
+    UINT8		buf[TS_BLOCK_BYTES];
+}TS_SERIES;
+
+/* Called for each sample of a range scan */
+typedef void (*TS_SCAN_CB)(void *ctx, UINT16 id, UINT16 power, UINT64 epochMs);
+
+/* Start of a ring history file, followed by slots UINT16 readings */
+typedef struct
+{
+    UINT32		magic;
+    UINT16		id;
+    UINT16		reserved;
+    UINT32		intervalMs;
+    UINT32		slots;			/* Retention in read intervals */
+    UINT64		lastSlot;		/* UTC ms / intervalMs of the latest reading, 0 if none */
+}HIST_HEADER;
+
+/* Mapped ring history of one sensor */
+typedef struct
+{
+    INT32		fd;
+    size_t		mapBytes;
+    HIST_HEADER	*hdr;			/* Start of the mapping */
+    UINT16		*slot;			/* hdr->slots readings after the header */
+    UINT32		dirtyLo;		/* Slots written since the last sync */
+    UINT32		dirtyHi;
+}HIST_SERIES;
+
+/* [database] section of the configuration */
+typedef struct
+{
+    UINT16		flushSize;		/* Samples per transaction */
+    UINT32		flushMs;		/* Longest a sample waits for its commit */
+    UINT16		retentionHours;	/* History kept in SensorData */
+    INT32		synchronous;	/* PRAGMA synchronous level, 0 OFF .. 3 EXTRA */
+    UINT32		cacheKb;		/* Page cache of the writer connection */
+    UINT32		checkpointPages;	/* WAL size that triggers an automatic checkpoint */
+    UINT32		checkpointSec;	/* Period of the timed checkpoint */
+    INT32		engine;			/* DB_ENGINE */
+    CHAR		*tsPath;		/* Directory of the native store */
+    CHAR		*histPath;		/* Directory of the ring history files */
+    UINT32		sealSec;		/* Longest an open block stays in memory */
+}DB_CONFIG;
+
 #pragma pack(push,1)
 /* Define structure to hold program arguments */
 typedef struct
 {
-    CHAR		*sensorIP[MAX_SENS_SIMULATOR];
-    UINT16		sensorPort[MAX_SENS_SIMULATOR];
-    UINT16		readInterval[MAX_SENS_SIMULATOR];
     CHAR		*mqttIP;
     UINT16		mqttPort;
     CHAR		*mqttUsername;
     CHAR		*mqttPassword;
     UINT16		publishInterval;
+    UINT32		maxPayload;		/* Bytes per MQTT message */
+    UINT8		qos;
+    UINT16		maxInflight;
+    INT32		encoding;		/* PAYLOAD_ENCODING */
+    DB_CONFIG	db;
+    SPOOL_CONFIG	spool;
+    AGG_CONFIG	agg;
 }PROGRAM_ARGS;
+#pragma pack(pop)
 
 typedef struct
 {
     PROGRAM_ARGS		args;
+    SENSOR_TABLE		sensors;
     STATE_TYPE			state;
-    modbus_t			*ctx[MAX_SENS_SIMULATOR];
-    sqlite3				*db;
+    RING				pubRing;		/* Acquisition to publish stage */
+    SAMPLE_WINDOW		window;
     struct mosquitto	*mosq;
-    UINT8               mConnected[MAX_SENS_SIMULATOR];
-    CHAR                timestamp[SIZE_32];
-    UINT16				power[MAX_SENS_SIMULATOR];
-    CHAR				payload[SIZE_2048];
+    UINT64				nextPublishMs;
+    UINT64				nextStatsMs;
+    PAYLOAD				payload;
+    BOOL				publishPending;	/* Last publish stopped at a full in-flight window */
+    BOOL				publishRaw;		/* Raw samples beside the aggregates, SIGUSR1 toggles it, main thread only */
 }MP_INST;
-#pragma pack(pop)
 
 /*
 *Function declarations
 */
+/* sensor.c */
+INT32 sensorTableAdd(SENSOR_TABLE *tbl, UINT16 id);
+INT32 sensorTableFind(const SENSOR_TABLE *tbl, UINT16 id);
+void sensorTableTruncate(SENSOR_TABLE *tbl, UINT16 count);
+void sensorTableFree(SENSOR_TABLE *tbl);
+
+/* sched.c */
+ERROR_CODE schedInit(SCHED *sch, UINT16 count);
+void schedFree(SCHED *sch);
+void schedSet(SCHED *sch, UINT16 idx, UINT64 deadlineMs);
+INT32 schedTop(const SCHED *sch, UINT64 *deadlineMs);
+void schedArm(SCHED *sch);
+void schedAck(SCHED *sch);
+void jitterRecord(POLL_STATS *stats, UINT32 lateUs);
+void jitterPrint(FILE *fp, const POLL_STATS *stats);
+
+/* poller.c */
+UINT64 getMonotonicMs(void);
+UINT64 getMonotonicUs(void);
+UINT64 getRealtimeMs(void);
+ERROR_CODE startPoller(SENSOR_TABLE *tbl, RING *const *out, UINT8 outCount, UINT8 everyRead);
+void stopPoller(void);
+void printPollStats(FILE *fp, SENSOR_TABLE *tbl);
+
+/* ring.c */
+ERROR_CODE ringInit(RING *ring, UINT32 minSize);
+void ringFree(RING *ring);
+BOOL ringPush(RING *ring, const SAMPLE *sample);
+UINT32 ringPop(RING *ring, SAMPLE *out, UINT32 max);
+UINT32 ringDepth(RING *ring);
+void ringWait(RING *ring, INT32 timeoutMs);
+void ringWake(RING *ring);
+void printRingStats(FILE *fp, const CHAR *name, RING *ring);
+
+/* window.c */
+ERROR_CODE windowInit(SAMPLE_WINDOW *win, const SENSOR_TABLE *tbl, UINT16 publishSec);
+void windowFree(SAMPLE_WINDOW *win);
+UINT32 windowFeed(SAMPLE_WINDOW *win, const SAMPLE *batch, UINT32 count);
+void printWindowStats(FILE *fp, const SAMPLE_WINDOW *win, RING *ring);
+
+/* payload.c */
+void payloadInit(PAYLOAD *pl, UINT32 maxLen, UINT8 encoding);
+void payloadFree(PAYLOAD *pl);
+ERROR_CODE payloadEncode(PAYLOAD *pl, const SAMPLE_WINDOW *win, const UINT16 *ids, PAYLOAD_CURSOR *cur);
+void payloadTimestamp(CHAR *buf, UINT32 size, UINT64 epochMs);
+INT32 payloadEncoding(const CHAR *name);
+ERROR_CODE payloadEncodeAggregates(PAYLOAD *pl, const AGG_RECORD *rec, UINT32 count);
+
+/* inflight.c */
+ERROR_CODE inflightInit(UINT16 max, UINT8 qos, UINT16 sensorCount);
+void inflightFree(void);
+BOOL inflightFull(void);
+INT32 inflightPublish(struct mosquitto *mosq, const CHAR *buf, UINT32 len, const SAMPLE_WINDOW *win,
+                      const PAYLOAD_CURSOR *from, const PAYLOAD_CURSOR *to, UINT64 spoolSeq);
+void inflightAck(INT32 mid);
+void inflightConnect(void);
+void inflightDisconnect(void);
+UINT32 inflightCollect(SAMPLE_WINDOW *win, PAYLOAD *pl, const UINT16 *ids);
+void printInflightStats(FILE *fp);
+
+/* aggregate.c */
+ERROR_CODE aggregateInit(const AGG_CONFIG *cfg, const SENSOR_TABLE *tbl);
+void aggregateFree(void);
+UINT32 aggregateFeed(const SAMPLE *batch, UINT32 count);
+void aggregateClose(UINT64 nowMs);
+const AGG_RECORD *aggregatePending(UINT32 *count);
+void aggregateConsume(UINT32 count);
+INT32 aggregateWindows(const CHAR *list, UINT32 *windowSec);
+void printAggregateStats(FILE *fp, BOOL raw);
+
+/* spool.c */
+ERROR_CODE spoolOpen(const SPOOL_CONFIG *cfg);
+void spoolClose(void);
+ERROR_CODE spoolAppend(const CHAR *buf, UINT32 len, UINT64 timeMs);
+UINT32 spoolReplay(struct mosquitto *mosq, UINT64 nowMs);
+void spoolRelease(UINT64 seq);
+void spoolRewind(void);
+void printSpoolStats(FILE *fp);
+
+/* tsdb.c */
+ERROR_CODE tsOpen(const DB_CONFIG *cfg, UINT16 sensorCount);
+void tsClose(void);
+ERROR_CODE tsAppend(const SAMPLE *sample);
+void tsSealExpired(UINT64 nowMs);
+UINT64 tsSealDeadline(void);
+UINT32 tsPurge(UINT64 cutoffMs);
+UINT32 tsScan(UINT16 id, UINT64 fromMs, UINT64 toMs, TS_SCAN_CB cb, void *ctx);
+UINT64 tsDiskBytes(void);
+void printTsStats(FILE *fp);
+
+/* history.c */
+ERROR_CODE histOpen(const DB_CONFIG *cfg, const SENSOR_TABLE *tbl, BOOL writable);
+void histClose(void);
+ERROR_CODE histWrite(const SAMPLE *sample);
+void histSync(UINT64 nowMs);
+UINT64 histSyncDeadline(void);
+UINT32 histRecent(UINT16 idx, UINT32 count, UINT16 *out, UINT64 *lastMs);
+UINT32 histScan(UINT16 id, UINT64 fromMs, UINT64 toMs, TS_SCAN_CB cb, void *ctx);
+UINT64 histDiskBytes(void);
+void printHistStats(FILE *fp);
+
+/* store.c */
+ERROR_CODE openStoreDb(const CHAR *path, sqlite3 **db);
+INT32 storeSyncLevel(const CHAR *name);
+INT32 storeEngine(const CHAR *name);
+ERROR_CODE startStore(const CHAR *path, const SENSOR_TABLE *tbl, const DB_CONFIG *cfg);
+ERROR_CODE storeExport(const CHAR *path, const SENSOR_TABLE *tbl, const DB_CONFIG *cfg);
+void stopStore(void);
+RING *storeRing(void);
+void printStoreStats(FILE *fp);
 
 #endif
 
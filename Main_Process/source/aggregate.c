@@ -0,0 +1,341 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		Every read aggregated, deadband or not
+*	17/10/2026		1.2			Ganesh		Raw publishing state passed in
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include "general.h"
+
+/*** Globals ***/
+/* Windows are tumbling and aligned to multiples of their length in UTC, so
+   a 15 minute window starts at :00, :15, :30 and :45 on every device.
+   aggState holds aggWindows entries per sensor. */
+static AGG_STATE	*aggState;
+static const UINT16	*aggIds;
+static UINT16		aggSensors;
+static UINT8		aggWindows;
+static UINT64		aggLenMs[AGG_WINDOWS_MAX];
+static AGG_RECORD	*aggOut;		/* Closed windows, oldest first */
+static UINT32		aggOutCount;
+static UINT32		aggOutCap;
+
+static UINT64		aggSamples;
+static UINT32		aggClosed;
+static UINT32		aggPublished;
+static UINT32		aggLate;
+static UINT32		aggDropped;
+
+/****************************************************************
+* Private Function
+****************************************************************/
+/*************************************************************************
+* @brief        Queues a closed window for publishing and resets it.
+*
+* @param[in]    idx         Sensor index.
+* @param[in]    w           Window index.
+*
+* @return       void
+*************************************************************************/
+static void closeWindow(UINT16 idx, UINT8 w)
+{
+    AGG_STATE *st = &aggState[(UINT32)idx * aggWindows + w];
+    AGG_RECORD *rec = NULL, *grown = NULL;
+    UINT32 cap = 0;
+
+    if(aggOutCount == aggOutCap)
+    {
+        cap = aggOutCap ? aggOutCap * 2 : AGG_OUT_MIN_SIZE;
+        grown = realloc(aggOut, cap * sizeof(*aggOut));
+        if(!grown)
+        {
+            aggDropped++;
+            st->count = 0;
+            return;
+        }
+        aggOut = grown;
+        aggOutCap = cap;
+    }
+
+    rec = &aggOut[aggOutCount++];
+    rec->startMs = st->startMs;
+    rec->sum = st->sum;
+    rec->count = st->count;
+    rec->windowSec = (UINT32)(aggLenMs[w] / MS_PER_SEC);
+    rec->id = aggIds[idx];
+    rec->min = st->min;
+    rec->max = st->max;
+    aggClosed++;
+    st->count = 0;
+}
+
+/*************************************************************************
+* @brief        Adds one sample to every window of its sensor.
+*
+* @details      A sample of a later window closes the open one first. A
+*               sample older than the open window arrived after its own
+*               window was closed and is counted late.
+*
+* @param[in]    idx         Sensor index.
+* @param[in]    power       Power read.
+* @param[in]    epochMs     Read time, UTC ms.
+*
+* @return       void
+*************************************************************************/
+static void addSample(UINT16 idx, UINT16 power, UINT64 epochMs)
+{
+    AGG_STATE *st = &aggState[(UINT32)idx * aggWindows];
+    UINT64 startMs = 0;
+    UINT8 w = 0;
+
+    for(w = 0; w < aggWindows; w++, st++)
+    {
+        startMs = epochMs - (epochMs % aggLenMs[w]);
+        if(startMs < st->startMs)
+        {
+            aggLate++;
+            continue;
+        }
+
+        if(startMs != st->startMs)
+        {
+            if(st->count)
+                closeWindow(idx, w);
+            st->startMs = startMs;
+        }
+
+        if(!st->count)
+        {
+            st->sum = 0;
+            st->min = st->max = power;
+        }
+        else if(power < st->min)
+            st->min = power;
+        else if(power > st->max)
+            st->max = power;
+        st->sum += power;
+        st->count++;
+    }
+}
+
+/****************************************************************
+* Public Function
+****************************************************************/
+/*************************************************************************
+* @brief        Creates the aggregate of every sensor and window.
+*
+* @param[in]    cfg         Window lengths.
+* @param[in]    tbl         Sensor table, gives the IDs.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE aggregateInit(const AGG_CONFIG *cfg, const SENSOR_TABLE *tbl)
+{
+    UINT8 w = 0;
+
+    if(!cfg->windows)
+        return RET_OK;
+
+    aggState = calloc((UINT32)tbl->count * cfg->windows, sizeof(*aggState));
+    if(!aggState)
+    {
+        aggregateFree();
+        return RET_FAILURE;
+    }
+
+    for(w = 0; w < cfg->windows; w++)
+        aggLenMs[w] = (UINT64)cfg->windowSec[w] * MS_PER_SEC;
+    aggIds = tbl->id;
+    aggSensors = tbl->count;
+    aggWindows = cfg->windows;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Frees the aggregates, open windows are lost.
+*
+* @return       void
+*************************************************************************/
+void aggregateFree(void)
+{
+    free(aggState);
+    free(aggOut);
+    aggState = NULL;
+    aggOut = NULL;
+    aggOutCount = aggOutCap = 0;
+    aggSensors = 0;
+    aggWindows = 0;
+}
+
+/*************************************************************************
+* @brief        Aggregates samples popped from acquisition.
+*
+* @details      Each sample costs one update per window length, whatever
+*               the window holds. Reads within the deadband count too, so
+*               min, max and mean do not depend on it.
+*
+* @param[in]    batch       Samples, in the order they were read.
+* @param[in]    count       Number of samples.
+*
+* @return       UINT32      Number of samples aggregated.
+*************************************************************************/
+UINT32 aggregateFeed(const SAMPLE *batch, UINT32 count)
+{
+    UINT32 i = 0, total = 0;
+
+    for(i = 0; i < count; i++)
+    {
+        if(batch[i].idx < aggSensors)
+        {
+            addSample(batch[i].idx, batch[i].power, batch[i].epochMs);
+            total++;
+        }
+    }
+    aggSamples += total;
+    return total;
+}
+
+/*************************************************************************
+* @brief        Closes the windows whose end has passed.
+*
+* @details      A window is kept open for PUBLISH_DRAIN_MS after its end,
+*               so samples still on their way from acquisition count.
+*               A sensor that stops reporting closes its windows here.
+*
+* @param[in]    nowMs       Current wall clock, UTC ms.
+*
+* @return       void
+*************************************************************************/
+void aggregateClose(UINT64 nowMs)
+{
+    AGG_STATE *st = aggState;
+    UINT16 idx = 0;
+    UINT8 w = 0;
+
+    for(idx = 0; idx < aggSensors; idx++)
+    {
+        for(w = 0; w < aggWindows; w++, st++)
+        {
+            if(st->count && nowMs >= st->startMs + aggLenMs[w] + PUBLISH_DRAIN_MS)
+            {
+                closeWindow(idx, w);
+                st->startMs += aggLenMs[w];
+            }
+        }
+    }
+}
+
+/*************************************************************************
+* @brief        Returns the closed windows not yet published.
+*
+* @param[out]   count       Number of records.
+*
+* @return       const AGG_RECORD*   Records, oldest first.
+*************************************************************************/
+const AGG_RECORD *aggregatePending(UINT32 *count)
+{
+    *count = aggOutCount;
+    return aggOut;
+}
+
+/*************************************************************************
+* @brief        Removes the oldest closed windows once they are published
+*               or spooled.
+*
+* @param[in]    count       Number of records.
+*
+* @return       void
+*************************************************************************/
+void aggregateConsume(UINT32 count)
+{
+    if(count > aggOutCount)
+        count = aggOutCount;
+
+    memmove(aggOut, aggOut + count, (aggOutCount - count) * sizeof(*aggOut));
+    aggOutCount -= count;
+    aggPublished += count;
+}
+
+/*************************************************************************
+* @brief        Parses the [aggregate] windows list.
+*
+* @details      Lengths are separated by commas, a number may end in s, m
+*               or h, plain numbers are seconds, e.g. "10s, 1m, 15m".
+*
+* @param[in]    list        Window lengths.
+* @param[out]   windowSec   AGG_WINDOWS_MAX lengths in seconds.
+*
+* @return       INT32       Number of windows, RET_FAILURE if the list is
+*                           invalid.
+*************************************************************************/
+INT32 aggregateWindows(const CHAR *list, UINT32 *windowSec)
+{
+    const CHAR *p = list;
+    CHAR *end = NULL;
+    DWORD value = 0;
+    INT32 count = 0;
+
+    while(*p)
+    {
+        while(*p == ' ' || *p == ',')
+            p++;
+        if(!*p)
+            break;
+
+        value = strtoul(p, &end, 10);
+        if(end == p || count == AGG_WINDOWS_MAX)
+            return RET_FAILURE;
+
+        p = end;
+        if(*p == 'm')
+            value *= 60;
+        else if(*p == 'h')
+            value *= SEC_PER_HOUR;
+        if(*p == 's' || *p == 'm' || *p == 'h')
+            p++;
+        if(!value || value > 24 * SEC_PER_HOUR || (*p && *p != ',' && *p != ' '))
+            return RET_FAILURE;
+        windowSec[count++] = (UINT32)value;
+    }
+    return count;
+}
+
+/*************************************************************************
+* @brief        Prints the aggregation counters.
+*
+* @param[in]    fp          Output stream.
+* @param[in]    raw         TRUE if raw samples are published too.
+*
+* @return       void
+*************************************************************************/
+void printAggregateStats(FILE *fp, BOOL raw)
+{
+    UINT8 w = 0;
+
+    if(!aggWindows)
+        return;
+
+    fprintf(fp, "Aggregate : windows");
+    for(w = 0; w < aggWindows; w++)
+        fprintf(fp, "%s%llu", w ? "/" : " ", (unsigned long long)(aggLenMs[w] / MS_PER_SEC));
+    fprintf(fp, " s, raw samples %s, samples %llu, closed %u, published %u, pending %u\n",
+                raw ? "on" : "off", (unsigned long long)aggSamples,
+                aggClosed, aggPublished, aggOutCount);
+    fprintf(fp, "\tsamples per published aggregate %.1f, late %u, dropped %u\n",
+                aggPublished ? (DOUBLE)aggSamples / aggPublished : 0.0,
+                aggLate, aggDropped);
+}
+
+/* EOF */
@@ -0,0 +1,460 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*
+**************************************************************************************/
+
+/*
+*	Ring history, one file <sensor ID>.hist per sensor, mapped shared:
+*
+*	HIST_HEADER
+*	slots x UINT16, the reading of UTC ms t is in slot (t / intervalMs) % slots
+*
+*	A day at 1 Hz is 86400 slots, 169 KiB. Writing a slot overwrites the
+*	reading of one retention period ago, so there is nothing to delete.
+*	Slots skipped since the last reading, a missed read, a deadband or the
+*	process being down, are set to HIST_EMPTY by the next write.
+*/
+
+/*** Includes ***/
+#include "general.h"
+
+/*** Globals ***/
+static pthread_mutex_t	histLock = PTHREAD_MUTEX_INITIALIZER;
+static HIST_SERIES		*histSeries;	/* Indexed by sensor table row */
+static UINT16			*histIds;
+static UINT16			histCount;
+static UINT64			histSyncMs;		/* Sync period */
+static UINT64			histNextSyncMs;
+
+static UINT64			histWrites;
+static UINT64			histCleared;	/* Slots set empty by a gap */
+static UINT32			histStale;		/* Readings older than the retention */
+static UINT32			histSyncs;
+static UINT64			histSyncTotalUs;
+static UINT32			histSyncMaxUs;
+
+/****************************************************************
+* Private Function
+****************************************************************/
+/*************************************************************************
+* @brief        Maps the history file of a sensor.
+*
+* @details      A file of another interval or retention is started over,
+*               its slots would not line up with the new ones.
+*
+* @param[out]   s           Series.
+* @param[in]    dir         Directory of the history files.
+* @param[in]    id          Sensor ID.
+* @param[in]    intervalMs  Read interval.
+* @param[in]    slots       Retention in read intervals.
+* @param[in]    writable    FALSE maps only a matching file, read only.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE mapSeries(HIST_SERIES *s, const CHAR *dir, UINT16 id, UINT32 intervalMs, UINT32 slots, BOOL writable)
+{
+    CHAR path[SIZE_256] = {0};
+    HIST_HEADER hdr = {0};
+    struct stat st;
+    size_t bytes = sizeof(HIST_HEADER) + (size_t)slots * sizeof(UINT16);
+    BOOL match = FALSE;
+
+    snprintf(path, sizeof(path), "%s/%u.hist", dir, id);
+    if((s->fd = open(path, writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644)) < 0)
+    {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return RET_FAILURE;
+    }
+
+    match = (fstat(s->fd, &st) == 0 && (size_t)st.st_size == bytes &&
+             pread(s->fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr) && hdr.magic == HIST_MAGIC &&
+             hdr.id == id && hdr.intervalMs == intervalMs && hdr.slots == slots);
+    if(!match && !writable)
+    {
+        fprintf(stderr, "%s does not hold %u ms x %u slots, skipped\n", path, intervalMs, slots);
+        return RET_FAILURE;
+    }
+    if(!match && (ftruncate(s->fd, 0) != 0 || ftruncate(s->fd, (off_t)bytes) != 0))
+    {
+        fprintf(stderr, "Failed to size %s: %s\n", path, strerror(errno));
+        return RET_FAILURE;
+    }
+
+    s->hdr = mmap(NULL, bytes, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, s->fd, 0);
+    if(s->hdr == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map %s: %s\n", path, strerror(errno));
+        s->hdr = NULL;
+        return RET_FAILURE;
+    }
+    s->mapBytes = bytes;
+    s->slot = (UINT16 *)(s->hdr + 1);
+    s->dirtyLo = slots;
+    s->dirtyHi = 0;
+
+    if(!match)
+    {
+        if(st.st_size)
+            fprintf(stdout, "History of sensor ID %u started over for %u ms x %u slots\n", id, intervalMs, slots);
+        memset(s->slot, 0xFF, (size_t)slots * sizeof(UINT16));
+        s->hdr->magic = HIST_MAGIC;
+        s->hdr->id = id;
+        s->hdr->intervalMs = intervalMs;
+        s->hdr->slots = slots;
+        s->hdr->lastSlot = 0;
+        s->dirtyLo = 0;
+        s->dirtyHi = slots - 1;
+    }
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Sets one slot and widens the range to sync.
+*
+* @param[in,out] s          Series.
+* @param[in]    k           Absolute slot, UTC ms / intervalMs.
+* @param[in]    value       Reading or HIST_EMPTY.
+*
+* @return       void
+*************************************************************************/
+static void setSlot(HIST_SERIES *s, UINT64 k, UINT16 value)
+{
+    UINT32 i = (UINT32)(k % s->hdr->slots);
+
+    s->slot[i] = value;
+    if(i < s->dirtyLo)
+        s->dirtyLo = i;
+    if(i > s->dirtyHi)
+        s->dirtyHi = i;
+}
+
+/*************************************************************************
+* @brief        Writes the changed pages of a series to its file.
+*
+* @param[in,out] s          Series.
+*
+* @return       void
+*************************************************************************/
+static void syncSeries(HIST_SERIES *s)
+{
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = 0, end = 0;
+
+    if(!s->hdr || s->dirtyLo > s->dirtyHi)
+        return;
+
+    /* The header page goes too, it holds lastSlot */
+    start = (uintptr_t)&s->slot[s->dirtyLo] & ~(page - 1);
+    end = (uintptr_t)&s->slot[s->dirtyHi + 1];
+    if(msync(s->hdr, sizeof(HIST_HEADER), MS_SYNC) != 0 || msync((void *)start, end - start, MS_SYNC) != 0)
+        fprintf(stderr, "Failed to sync the history of sensor ID %u: %s\n", s->hdr->id, strerror(errno));
+    s->dirtyLo = s->hdr->slots;
+    s->dirtyHi = 0;
+}
+
+/****************************************************************
+* Public Function
+****************************************************************/
+/*************************************************************************
+* @brief        Maps the history file of every sensor.
+*
+* @param[in]    cfg         histPath, retentionHours and sealSec are used.
+* @param[in]    tbl         Sensors and their read intervals.
+* @param[in]    writable    TRUE for the storage stage, FALSE to only read.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE histOpen(const DB_CONFIG *cfg, const SENSOR_TABLE *tbl, BOOL writable)
+{
+    UINT64 slots = 0;
+    UINT16 idx = 0;
+
+    if(writable && mkdir(cfg->histPath, 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "Failed to create %s: %s\n", cfg->histPath, strerror(errno));
+        return RET_FAILURE;
+    }
+
+    histSeries = calloc(tbl->count, sizeof(*histSeries));
+    histIds = calloc(tbl->count, sizeof(*histIds));
+    if(!histSeries || !histIds)
+    {
+        histClose();
+        return RET_FAILURE;
+    }
+    histCount = tbl->count;
+    for(idx = 0; idx < histCount; idx++)
+        histSeries[idx].fd = RET_FAILURE;
+
+    for(idx = 0; idx < histCount; idx++)
+    {
+        histIds[idx] = tbl->id[idx];
+        slots = (UINT64)cfg->retentionHours * SEC_PER_HOUR * MS_PER_SEC / tbl->intervalMs[idx];
+        if(!slots || slots > 0xFFFFFFFFULL ||
+           (mapSeries(&histSeries[idx], cfg->histPath, tbl->id[idx], tbl->intervalMs[idx], (UINT32)slots,
+                      writable) != RET_OK && writable))
+        {
+            histClose();
+            return RET_FAILURE;
+        }
+    }
+
+    histSyncMs = (UINT64)cfg->sealSec * MS_PER_SEC;
+    histNextSyncMs = getMonotonicMs() + histSyncMs;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Syncs and unmaps every history file.
+*
+* @return       void
+*************************************************************************/
+void histClose(void)
+{
+    UINT16 idx = 0;
+
+    pthread_mutex_lock(&histLock);
+    for(idx = 0; idx < histCount; idx++)
+    {
+        syncSeries(&histSeries[idx]);
+        if(histSeries[idx].hdr)
+            munmap(histSeries[idx].hdr, histSeries[idx].mapBytes);
+        if(histSeries[idx].fd >= 0)
+            close(histSeries[idx].fd);
+    }
+    free(histSeries);
+    free(histIds);
+    histSeries = NULL;
+    histIds = NULL;
+    histCount = 0;
+    pthread_mutex_unlock(&histLock);
+}
+
+/*************************************************************************
+* @brief        Stores a reading in the slot of its read time.
+*
+* @details      O(1), a store to the mapping. A gap since the previous
+*               reading costs one more store per skipped slot, at most a
+*               retention period, and each slot is skipped once per lap.
+*
+* @param[in]    sample      Sample, idx must be below the table count.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE histWrite(const SAMPLE *sample)
+{
+    HIST_SERIES *s = NULL;
+    UINT64 k = 0, gap = 0, last = 0;
+
+    if(sample->idx >= histCount || !histSeries[sample->idx].hdr)
+        return RET_FAILURE;
+
+    s = &histSeries[sample->idx];
+    k = sample->epochMs / s->hdr->intervalMs;
+
+    pthread_mutex_lock(&histLock);
+    last = s->hdr->lastSlot;
+    if(last && k + s->hdr->slots <= last)
+    {
+        histStale++;
+        pthread_mutex_unlock(&histLock);
+        return RET_OK;
+    }
+
+    if(last && k > last + 1)
+    {
+        gap = k - last - 1;
+        if(gap > s->hdr->slots)
+            gap = s->hdr->slots;
+        histCleared += gap;
+        while(gap--)
+            setSlot(s, k - 1 - gap, HIST_EMPTY);
+    }
+
+    setSlot(s, k, (sample->power == HIST_EMPTY) ? (HIST_EMPTY - 1) : sample->power);
+    if(k > last)
+        s->hdr->lastSlot = k;
+    histWrites++;
+    pthread_mutex_unlock(&histLock);
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Writes the changed pages to the files every sealSec.
+*
+* @details      The page cache keeps the mappings across a restart of the
+*               process, the sync bounds what a power cut can lose.
+*
+* @param[in]    nowMs       Current monotonic time.
+*
+* @return       void
+*************************************************************************/
+void histSync(UINT64 nowMs)
+{
+    UINT64 startUs = 0;
+    UINT32 latencyUs = 0;
+    UINT16 idx = 0;
+
+    if(nowMs < histNextSyncMs)
+        return;
+
+    startUs = getMonotonicUs();
+    pthread_mutex_lock(&histLock);
+    for(idx = 0; idx < histCount; idx++)
+        syncSeries(&histSeries[idx]);
+    pthread_mutex_unlock(&histLock);
+
+    latencyUs = (UINT32)(getMonotonicUs() - startUs);
+    histSyncs++;
+    histSyncTotalUs += latencyUs;
+    if(latencyUs > histSyncMaxUs)
+        histSyncMaxUs = latencyUs;
+    histNextSyncMs = nowMs + histSyncMs;
+}
+
+/*************************************************************************
+* @brief        Returns when the next sync is due.
+*
+* @return       UINT64      Monotonic time.
+*************************************************************************/
+UINT64 histSyncDeadline(void)
+{
+    return histNextSyncMs;
+}
+
+/*************************************************************************
+* @brief        Copies the latest readings of a sensor, oldest first.
+*
+* @details      The slots are contiguous in the mapping, so this is at
+*               most two copies, one on each side of the wrap.
+*
+* @param[in]    idx         Sensor table row.
+* @param[in]    count       Slots wanted, up to the retention.
+* @param[out]   out         count readings, HIST_EMPTY where none was stored.
+* @param[out]   lastMs      UTC ms of the slot of the last reading.
+*
+* @return       UINT32      Slots copied, 0 if there is no reading yet.
+*************************************************************************/
+UINT32 histRecent(UINT16 idx, UINT32 count, UINT16 *out, UINT64 *lastMs)
+{
+    HIST_SERIES *s = NULL;
+    UINT32 end = 0, head = 0;
+
+    pthread_mutex_lock(&histLock);
+    if(idx >= histCount || !(s = &histSeries[idx])->hdr || !s->hdr->lastSlot)
+    {
+        pthread_mutex_unlock(&histLock);
+        return 0;
+    }
+
+    if(count > s->hdr->slots)
+        count = s->hdr->slots;
+    end = (UINT32)(s->hdr->lastSlot % s->hdr->slots) + 1;
+    head = (count > end) ? (count - end) : 0;
+    memcpy(out, &s->slot[s->hdr->slots - head], head * sizeof(UINT16));
+    memcpy(out + head, &s->slot[end - (count - head)], (count - head) * sizeof(UINT16));
+    *lastMs = s->hdr->lastSlot * s->hdr->intervalMs;
+    pthread_mutex_unlock(&histLock);
+    return count;
+}
+
+/*************************************************************************
+* @brief        Reports the readings of a sensor within a time range, in
+*               time order.
+*
+* @param[in]    id          Sensor ID.
+* @param[in]    fromMs      Range start, UTC ms, inclusive.
+* @param[in]    toMs        Range end, UTC ms, inclusive.
+* @param[in]    cb          Called per reading, with the start of its slot.
+* @param[in]    ctx         Passed to cb.
+*
+* @return       UINT32      Readings reported.
+*************************************************************************/
+UINT32 histScan(UINT16 id, UINT64 fromMs, UINT64 toMs, TS_SCAN_CB cb, void *ctx)
+{
+    HIST_SERIES *s = NULL;
+    UINT64 k = 0, first = 0, last = 0;
+    UINT32 found = 0;
+    UINT16 idx = 0, value = 0;
+
+    pthread_mutex_lock(&histLock);
+    for(idx = 0; idx < histCount; idx++)
+    {
+        s = &histSeries[idx];
+        if(histIds[idx] != id || !s->hdr || !s->hdr->lastSlot)
+            continue;
+
+        /* Only the last lap is held */
+        first = (fromMs + s->hdr->intervalMs - 1) / s->hdr->intervalMs;
+        if(first + s->hdr->slots <= s->hdr->lastSlot)
+            first = s->hdr->lastSlot - s->hdr->slots + 1;
+        last = toMs / s->hdr->intervalMs;
+        if(last > s->hdr->lastSlot)
+            last = s->hdr->lastSlot;
+
+        for(k = first; k <= last; k++)
+        {
+            value = s->slot[k % s->hdr->slots];
+            if(value != HIST_EMPTY)
+            {
+                cb(ctx, id, value, k * s->hdr->intervalMs);
+                found++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&histLock);
+    return found;
+}
+
+/*************************************************************************
+* @brief        Returns the size of the mapped history files.
+*
+* @return       UINT64      Bytes on disk.
+*************************************************************************/
+UINT64 histDiskBytes(void)
+{
+    UINT64 total = 0;
+    UINT16 idx = 0;
+
+    pthread_mutex_lock(&histLock);
+    for(idx = 0; idx < histCount; idx++)
+        total += histSeries[idx].mapBytes;
+    pthread_mutex_unlock(&histLock);
+    return total;
+}
+
+/*************************************************************************
+* @brief        Prints the ring history counters.
+*
+* @param[in]    fp          Output stream.
+*
+* @return       void
+*************************************************************************/
+void printHistStats(FILE *fp)
+{
+    UINT64 bytes = 0;
+    UINT16 idx = 0;
+
+    pthread_mutex_lock(&histLock);
+    for(idx = 0; idx < histCount; idx++)
+        bytes += histSeries[idx].mapBytes;
+    fprintf(fp, "\thistory writes %llu, gap slots cleared %llu, older than retention %u, %llu bytes mapped\n",
+                (unsigned long long)histWrites, (unsigned long long)histCleared, histStale,
+                (unsigned long long)bytes);
+    fprintf(fp, "\tsyncs %u, sync latency avg %llu us, max %u us\n", histSyncs,
+                histSyncs ? (unsigned long long)(histSyncTotalUs / histSyncs) : 0ULL, histSyncMaxUs);
+    pthread_mutex_unlock(&histLock);
+}
+
+/* EOF */
@@ -0,0 +1,486 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		Untracked aggregate messages
+*	17/10/2026		1.2			Ganesh		Lost and expired messages are retired, live ones respooled
+*	17/10/2026		1.3			Ganesh		Age only while connected, lost aggregates respooled
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include "general.h"
+
+/*** Globals ***/
+/* Entries tail..head-1 are in flight, oldest first. The lock is shared with
+   the mosquitto network thread, which only marks entries acknowledged. */
+static pthread_mutex_t	inflightLock = PTHREAD_MUTEX_INITIALIZER;
+static INFLIGHT		*inflightTab;
+static UINT32		*inflightEnds;
+static UINT32		*inflightStarts;
+static UINT32		*inflightViewHead;	/* Window view of a message being respooled */
+static UINT32		*inflightViewSent;
+static UINT16		inflightMax;
+static UINT8		inflightQos;
+static UINT32		inflightHead;
+static UINT32		inflightTail;
+static BOOL			inflightSending;	/* Entry at head is being published */
+static BOOL			inflightEarly;		/* An ack came while publishing, before the ID was known */
+static INT32		inflightEarlyMid;
+static BOOL			inflightLinkUp;		/* Messages only age while connected */
+
+static UINT32		inflightPublished;
+static UINT32		inflightAcked;
+static UINT32		inflightUnknown;
+static UINT32		inflightLost;
+static UINT32		inflightExpired;
+static UINT64		inflightRespooled;
+static UINT64		inflightOverwritten;	/* Samples of lost messages gone from the windows */
+static UINT32		inflightAggRespooled;
+static UINT64		inflightSamples;
+static UINT64		inflightAckTotalUs;
+static UINT32		inflightAckMaxUs;
+
+/****************************************************************
+* Private Function
+****************************************************************/
+/*************************************************************************
+* @brief        Marks a message acknowledged, with inflightLock held.
+*
+* @param[in,out] msg        Message.
+*
+* @return       void
+*************************************************************************/
+static void markAcked(INFLIGHT *msg)
+{
+    UINT32 latencyUs = (UINT32)(getMonotonicUs() - msg->sentUs);
+
+    msg->acked = TRUE;
+    inflightAcked++;
+    inflightAckTotalUs += latencyUs;
+    if(latencyUs > inflightAckMaxUs)
+        inflightAckMaxUs = latencyUs;
+}
+
+/*************************************************************************
+* @brief        Spools the samples of a live message that was lost.
+*
+* @details      The message is encoded again from a view of the windows
+*               that starts and ends each sensor where the message did.
+*               Samples overwritten meanwhile, or that do not fit the
+*               spool, are counted as not respooled.
+*
+* @param[in]    msg         Lost message, at the tail.
+* @param[in]    win         Rolling windows.
+* @param[in,out] pl         Payload builder.
+* @param[in]    ids         Sensor ID of each window.
+* @param[in]    last        Last sensor the message carries.
+*
+* @return       void
+*************************************************************************/
+static void respoolLive(const INFLIGHT *msg, const SAMPLE_WINDOW *win, PAYLOAD *pl, const UINT16 *ids, UINT16 last)
+{
+    SAMPLE_WINDOW view = *win;
+    PAYLOAD_CURSOR cur = msg->from;
+    UINT64 nowMs = getRealtimeMs();
+    UINT32 oldest = 0, spooled = 0, *head = inflightViewHead, *sent = inflightViewSent;
+    UINT16 idx = 0;
+
+    /* Sensors the message does not carry are empty in the view */
+    memcpy(head, win->sent, win->count * sizeof(*head));
+    memcpy(sent, win->sent, win->count * sizeof(*sent));
+    for(idx = msg->from.idx; idx <= last && idx < win->count; idx++)
+    {
+        head[idx] = msg->end[idx - msg->from.idx];
+        sent[idx] = msg->start[idx - msg->from.idx];
+        oldest = win->head[idx] - (win->mask[idx] + 1);
+        if((INT32)(oldest - sent[idx]) > 0)
+            sent[idx] = oldest;
+        if((INT32)(sent[idx] - head[idx]) > 0)
+            sent[idx] = head[idx];
+    }
+    if(cur.idx < win->count)
+        cur.seq = sent[cur.idx];
+
+    view.head = head;
+    view.sent = sent;
+    while(payloadEncode(pl, &view, ids, &cur) == RET_OK && pl->records)
+    {
+        if(spoolAppend(pl->buf, pl->len, nowMs) != RET_OK)
+            break;
+        spooled += pl->records;
+    }
+    inflightRespooled += spooled;
+    inflightOverwritten += msg->records - spooled;
+}
+
+/****************************************************************
+* Public Function
+****************************************************************/
+/*************************************************************************
+* @brief        Creates the in-flight window.
+*
+* @param[in]    max         Messages published and not yet acknowledged.
+* @param[in]    qos         MQTT QoS of every message.
+* @param[in]    sensorCount Number of rolling windows.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE inflightInit(UINT16 max, UINT8 qos, UINT16 sensorCount)
+{
+    UINT16 i = 0;
+
+    inflightTab = calloc(max, sizeof(*inflightTab));
+    inflightEnds = calloc((UINT32)max * sensorCount, sizeof(*inflightEnds));
+    inflightStarts = calloc((UINT32)max * sensorCount, sizeof(*inflightStarts));
+    inflightViewHead = calloc(sensorCount, sizeof(*inflightViewHead));
+    inflightViewSent = calloc(sensorCount, sizeof(*inflightViewSent));
+    if(!inflightTab || !inflightEnds || !inflightStarts || !inflightViewHead || !inflightViewSent)
+    {
+        inflightFree();
+        return RET_FAILURE;
+    }
+
+    for(i = 0; i < max; i++)
+    {
+        inflightTab[i].start = inflightStarts + (UINT32)i * sensorCount;
+        inflightTab[i].end = inflightEnds + (UINT32)i * sensorCount;
+    }
+
+    inflightMax = max;
+    inflightQos = qos;
+    inflightHead = inflightTail = 0;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Frees the in-flight window.
+*
+* @return       void
+*************************************************************************/
+void inflightFree(void)
+{
+    UINT16 i = 0;
+
+    pthread_mutex_lock(&inflightLock);
+    for(i = 0; inflightTab && i < inflightMax; i++)
+        free(inflightTab[i].copy);
+    free(inflightTab);
+    free(inflightEnds);
+    free(inflightStarts);
+    free(inflightViewHead);
+    free(inflightViewSent);
+    inflightTab = NULL;
+    inflightEnds = NULL;
+    inflightStarts = NULL;
+    inflightViewHead = NULL;
+    inflightViewSent = NULL;
+    inflightMax = 0;
+    inflightHead = inflightTail = 0;
+    pthread_mutex_unlock(&inflightLock);
+}
+
+/*************************************************************************
+* @brief        Tells whether another message may be published.
+*
+* @return       BOOL        TRUE if the window is full.
+*************************************************************************/
+BOOL inflightFull(void)
+{
+    return inflightHead - inflightTail >= inflightMax;
+}
+
+/*************************************************************************
+* @brief        Publishes a message and remembers what it carries.
+*
+* @details      The message ID is only known once mosquitto_publish()
+*               returns, an acknowledgement arriving before is kept by
+*               inflightAck and matched here. An aggregate message is
+*               copied, it can not be encoded again if it is lost.
+*
+* @param[in]    mosq        The Mosquitto instance.
+* @param[in]    buf         Message.
+* @param[in]    len         Message length.
+* @param[in]    win         Rolling windows the samples come from, NULL for
+*                           a message replayed from the spool.
+* @param[in]    from        First sample carried.
+* @param[in]    to          Position after the last sample carried.
+* @param[in]    spoolSeq    Spool sequence number of a replayed message,
+*                           INFLIGHT_UNTRACKED for an aggregate message.
+*
+* @return       INT32       mosquitto error code, MOSQ_ERR_NOMEM when the
+*                           window is full.
+*************************************************************************/
+INT32 inflightPublish(struct mosquitto *mosq, const CHAR *buf, UINT32 len, const SAMPLE_WINDOW *win,
+                      const PAYLOAD_CURSOR *from, const PAYLOAD_CURSOR *to, UINT64 spoolSeq)
+{
+    INFLIGHT *msg = NULL;
+    CHAR *grown = NULL;
+    UINT16 idx = 0;
+    INT32 rc = 0, mid = 0;
+
+    if(inflightFull())
+        return MOSQ_ERR_NOMEM;
+
+    msg = &inflightTab[inflightHead % inflightMax];
+    msg->live = (win != NULL);
+    msg->acked = FALSE;
+    msg->lost = FALSE;
+    msg->spoolSeq = spoolSeq;
+    msg->records = 0;
+    if(win)
+    {
+        /* Sensors before to.idx are published up to their head */
+        msg->from = *from;
+        msg->to = *to;
+        for(idx = from->idx; idx <= to->idx && idx < win->count; idx++)
+        {
+            msg->start[idx - from->idx] = (idx == from->idx) ? from->seq : win->sent[idx];
+            msg->end[idx - from->idx] = (idx == to->idx) ? to->seq : win->head[idx];
+            msg->records += msg->end[idx - from->idx] - msg->start[idx - from->idx];
+        }
+    }
+
+    msg->copyLen = 0;
+    if(!win && spoolSeq == INFLIGHT_UNTRACKED)
+    {
+        if(len > msg->copyCap)
+        {
+            if(!(grown = realloc(msg->copy, len)))
+                return MOSQ_ERR_NOMEM;
+            msg->copy = grown;
+            msg->copyCap = len;
+        }
+        memcpy(msg->copy, buf, len);
+        msg->copyLen = len;
+    }
+
+    pthread_mutex_lock(&inflightLock);
+    msg->mid = RET_FAILURE;
+    msg->sentUs = getMonotonicUs();
+    inflightSending = TRUE;
+    inflightEarly = FALSE;
+    pthread_mutex_unlock(&inflightLock);
+
+    rc = mosquitto_publish(mosq, &mid, MQTT_TOPIC, (INT32)len, buf, inflightQos, false);
+
+    pthread_mutex_lock(&inflightLock);
+    inflightSending = FALSE;
+    if(rc == MOSQ_ERR_SUCCESS)
+    {
+        msg->mid = mid;
+        if(inflightEarly && inflightEarlyMid == mid)
+            markAcked(msg);
+        else if(inflightEarly)
+            inflightUnknown++;
+        inflightHead++;
+        inflightPublished++;
+    }
+    else if(inflightEarly)
+        inflightUnknown++;
+    inflightEarly = FALSE;
+    pthread_mutex_unlock(&inflightLock);
+    return rc;
+}
+
+/*************************************************************************
+* @brief        Marks a message acknowledged, called from the mosquitto
+*               network thread.
+*
+* @details      With QoS 0 mosquitto reports a message once it is written
+*               to the socket, with QoS 1 once the broker sends PUBACK.
+*               An ack matching no entry while a message is being
+*               published may be for it, it is kept for inflightPublish.
+*
+* @param[in]    mid         Message ID.
+*
+* @return       void
+*************************************************************************/
+void inflightAck(INT32 mid)
+{
+    UINT32 pos = 0;
+    INFLIGHT *msg = NULL;
+
+    pthread_mutex_lock(&inflightLock);
+    for(pos = inflightTail; pos != inflightHead; pos++)
+    {
+        msg = &inflightTab[pos % inflightMax];
+        if(msg->mid == mid && !msg->acked)
+        {
+            markAcked(msg);
+            break;
+        }
+    }
+    if(pos == inflightHead)
+    {
+        if(inflightSending && !inflightEarly)
+        {
+            inflightEarly = TRUE;
+            inflightEarlyMid = mid;
+        }
+        else
+            inflightUnknown++;
+    }
+    pthread_mutex_unlock(&inflightLock);
+}
+
+/*************************************************************************
+* @brief        Restarts the age of unacknowledged messages, called from the
+*               mosquitto network thread on connect.
+*
+* @details      mosquitto sends QoS 1 messages again after a reconnect,
+*               each gets MQTT_INFLIGHT_AGE_MS from now.
+*
+* @return       void
+*************************************************************************/
+void inflightConnect(void)
+{
+    UINT64 nowUs = getMonotonicUs();
+    UINT32 pos = 0;
+
+    pthread_mutex_lock(&inflightLock);
+    inflightLinkUp = TRUE;
+    for(pos = inflightTail; pos != inflightHead; pos++)
+    {
+        if(!inflightTab[pos % inflightMax].acked)
+            inflightTab[pos % inflightMax].sentUs = nowUs;
+    }
+    pthread_mutex_unlock(&inflightLock);
+}
+
+/*************************************************************************
+* @brief        Marks the messages mosquitto drops with the connection,
+*               called from the mosquitto network thread.
+*
+* @details      QoS 0 messages still queued in mosquitto are discarded
+*               and never reported, QoS 1 messages are sent again after
+*               the reconnect and do not age until then.
+*
+* @return       void
+*************************************************************************/
+void inflightDisconnect(void)
+{
+    UINT32 pos = 0;
+
+    pthread_mutex_lock(&inflightLock);
+    inflightLinkUp = FALSE;
+    for(pos = inflightTail; inflightQos == 0 && pos != inflightHead; pos++)
+    {
+        if(!inflightTab[pos % inflightMax].acked)
+            inflightTab[pos % inflightMax].lost = TRUE;
+    }
+    pthread_mutex_unlock(&inflightLock);
+}
+
+/*************************************************************************
+* @brief        Retires acknowledged messages in publish order.
+*
+* @details      The samples of a live message are marked delivered in the
+*               windows, a replayed message is released from the spool.
+*               Neither is ever sent again. Aggregate messages only free
+*               their entry. A message lost with the connection, or not
+*               acknowledged within MQTT_INFLIGHT_AGE_MS of connected
+*               time, is retired too: live samples and the copy of an
+*               aggregate message go to the spool, a replayed message is
+*               replayed again.
+*
+* @param[in,out] win        Rolling windows.
+* @param[in,out] pl         Payload builder, encodes lost live samples.
+* @param[in]    ids         Sensor ID of each window.
+*
+* @return       UINT32      Number of messages retired.
+*************************************************************************/
+UINT32 inflightCollect(SAMPLE_WINDOW *win, PAYLOAD *pl, const UINT16 *ids)
+{
+    INFLIGHT *msg = NULL;
+    UINT64 expiredUs = getMonotonicUs() - (UINT64)MQTT_INFLIGHT_AGE_MS * 1000;
+    UINT32 done = 0, pos = 0;
+    UINT16 idx = 0, last = 0;
+    BOOL lost = FALSE;
+
+    pthread_mutex_lock(&inflightLock);
+    while(inflightTail != inflightHead)
+    {
+        msg = &inflightTab[inflightTail % inflightMax];
+        lost = msg->lost || (!msg->acked && inflightLinkUp && (INT64)(msg->sentUs - expiredUs) < 0);
+        if(!msg->acked && !lost)
+            break;
+
+        if(lost)
+        {
+            inflightLost++;
+            if(!msg->lost)
+                inflightExpired++;
+        }
+        last = (msg->to.idx < win->count) ? msg->to.idx : (UINT16)(win->count - 1);
+        if(msg->live && lost)
+            respoolLive(msg, win, pl, ids, last);
+        else if(lost && msg->copyLen)
+        {
+            if(spoolAppend(msg->copy, msg->copyLen, getRealtimeMs()) == RET_OK)
+                inflightAggRespooled++;
+        }
+        else if(lost && msg->spoolSeq != INFLIGHT_UNTRACKED)
+        {
+            /* Replayed messages after it must not release it, they are replayed again too */
+            for(pos = inflightTail + 1; pos != inflightHead; pos++)
+            {
+                if(!inflightTab[pos % inflightMax].live)
+                    inflightTab[pos % inflightMax].spoolSeq = INFLIGHT_UNTRACKED;
+            }
+            spoolRewind();
+        }
+
+        if(msg->live)
+        {
+            for(idx = msg->from.idx; idx <= last && idx < win->count; idx++)
+            {
+                /* Only forward, an overrun may have moved it already */
+                if((INT32)(msg->end[idx - msg->from.idx] - win->delivered[idx]) > 0)
+                    win->delivered[idx] = msg->end[idx - msg->from.idx];
+            }
+            if(!lost)
+                inflightSamples += msg->records;
+        }
+        else if(!lost && msg->spoolSeq != INFLIGHT_UNTRACKED)
+            spoolRelease(msg->spoolSeq);
+
+        inflightTail++;
+        done++;
+    }
+    pthread_mutex_unlock(&inflightLock);
+    return done;
+}
+
+/*************************************************************************
+* @brief        Prints the in-flight window and acknowledgement counters.
+*
+* @param[in]    fp          Output stream.
+*
+* @return       void
+*************************************************************************/
+void printInflightStats(FILE *fp)
+{
+    pthread_mutex_lock(&inflightLock);
+    fprintf(fp, "MQTT : qos %u, in flight %u/%u, published %u, acknowledged %u, samples delivered %llu\n",
+                inflightQos, inflightHead - inflightTail, inflightMax, inflightPublished, inflightAcked,
+                (unsigned long long)inflightSamples);
+    fprintf(fp, "\tack latency avg %llu us, max %u us, unknown acks %u\n",
+                inflightAcked ? (unsigned long long)(inflightAckTotalUs / inflightAcked) : 0ULL,
+                inflightAckMaxUs, inflightUnknown);
+    fprintf(fp, "\tlost %u (expired %u), samples respooled %llu, not respooled %llu, aggregate messages respooled %u\n",
+                inflightLost, inflightExpired, (unsigned long long)inflightRespooled,
+                (unsigned long long)inflightOverwritten, inflightAggRespooled);
+    pthread_mutex_unlock(&inflightLock);
+}
+
+/* EOF */
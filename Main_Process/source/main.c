@@ -18,36 +18,20 @@
 #include "general.h"
 
 #define	CUR_SENS_SIMULATOR	curSs
-#define MODBUS_DEBUG		modDebug
-#define DEBUG_LOG			debug
 
 /*** Globals ***/
 UINT64	flag1;
-MP_INST	mpInst;
-UINT16	curSs;
+MP_INST	mpInst = {.pubRing.efd = RET_FAILURE};
+UINT16	curSs,statsInterval;
 BOOL	debug,modDebug;
+static volatile sig_atomic_t toggleRaw;
+static CHAR	*exportPath;		/* -x, copy the stored history to SQLite and exit */
+static CHAR	rejectedSection[SIZE_256];	/* Last invalid sensor section, reported once */
 
 /****************************************************************
 * Private Function
 ****************************************************************/
 /*************************************************************************
-* @brief        Generates a timestamp from the system RTC.
-*
-* @details      This function generates a timestamp in the format "YYYY-MM-DD HH:MM:SS"
-*               from the system RTC.
-*
-* @param[out]   buffer      Pointer to the buffer where the timestamp will be stored.
-* @param[in]    bufferSize  The size of the buffer.
-*
-* @return       void
-*************************************************************************/
-void generateTimestamp(char *buffer, size_t bufferSize)
-{
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    strftime(buffer, bufferSize, "%Y-%m-%d %H:%M:%S", t);
-}
-/*************************************************************************
 * @brief        Reads configuration from a file.
 *
 * @details      This function reads and parses the configuration file provided
@@ -63,21 +47,63 @@ void generateTimestamp(char *buffer, size_t bufferSize)
 *************************************************************************/
 static int iniHandler(void* user, const char* section, const char* name, const char* value)
 {
-    PROGRAM_ARGS *args = (PROGRAM_ARGS*)user;
-	const CHAR *ssSection[MAX_SENS_SIMULATOR] = {"sensor1","sensor2","sensor3"};
-	UINT16 ssIdx = 0;
-
-	for(ssIdx=0;ssIdx < CUR_SENS_SIMULATOR;ssIdx++)
+    MP_INST *inst = (MP_INST*)user;
+    PROGRAM_ARGS *args = &inst->args;
+    SENSOR_TABLE *tbl = &inst->sensors;
+	CHAR *end = NULL;
+	DWORD ssID = 0;
+	INT32 ssIdx = 0, windows = 0;
+
+	/* Any [sensorN] section adds or updates the row of sensor ID N */
+	if (strncmp(section, SENSOR_SECTION, strlen(SENSOR_SECTION)) == 0)
 	{
-		if (strcmp(section, ssSection[ssIdx]) == 0)
+		ssID = strtoul(section + strlen(SENSOR_SECTION), &end, 10);
+		if (end == section + strlen(SENSOR_SECTION) || *end != '\0' || ssID == 0 || ssID > MAX_SENSORS)
 		{
-			if (strcmp(name, "sensorIP") == 0)
-				args->sensorIP[ssIdx] = strdup(value);
-			else if (strcmp(name, "sensorPort") == 0)
-				args->sensorPort[ssIdx] = (UINT16)atoi(value);
-			else if (strcmp(name, "readInterval") == 0)
-				args->readInterval[ssIdx] = (UINT16)atoi(value);
+			/* Called for every key of the section */
+			if (strncmp(rejectedSection, section, sizeof(rejectedSection) - 1) != 0)
+			{
+				fprintf(stderr, "Ignoring invalid sensor section [%s]\n", section);
+				strncpy(rejectedSection, section, sizeof(rejectedSection) - 1);
+			}
+			return RET_SUCCESS;
+		}
+
+		if ((ssIdx = sensorTableAdd(tbl, (UINT16)ssID)) == RET_FAILURE)
+			return 0; /* Reported by ini_parse as a parse error */
+
+		if (strcmp(name, "sensorIP") == 0)
+		{
+			free(tbl->ip[ssIdx]);
+			tbl->ip[ssIdx] = strdup(value);
 		}
+		else if (strcmp(name, "sensorPort") == 0)
+			tbl->port[ssIdx] = (UINT16)atoi(value);
+		else if (strcmp(name, "unitId") == 0)
+			tbl->unitId[ssIdx] = (UINT8)atoi(value);
+		else if (strcmp(name, "readInterval") == 0)
+			tbl->intervalMs[ssIdx] = (UINT32)atoi(value) * MS_PER_SEC;
+		else if (strcmp(name, "readIntervalMs") == 0)
+			tbl->intervalMs[ssIdx] = (UINT32)atoi(value);
+		else if (strcmp(name, "registerStart") == 0)
+			tbl->regStart[ssIdx] = (UINT16)atoi(value);
+		else if (strcmp(name, "registerCount") == 0)
+			tbl->regCount[ssIdx] = (UINT8)atoi(value);
+		else if (strcmp(name, "pipelineDepth") == 0)
+			tbl->depth[ssIdx] = (UINT8)atoi(value);
+		else if (strcmp(name, "deadbandAbs") == 0)
+		{
+			tbl->deadband[ssIdx].abs = (UINT16)atoi(value);
+			tbl->deadband[ssIdx].enabled = TRUE;
+		}
+		else if (strcmp(name, "deadbandPct") == 0)
+		{
+			tbl->deadband[ssIdx].pct100 = (UINT16)(atof(value) * 100 + 0.5);
+			tbl->deadband[ssIdx].enabled = TRUE;
+		}
+		else if (strcmp(name, "heartbeatSec") == 0)
+			tbl->deadband[ssIdx].heartbeatMs = (UINT32)atoi(value) * MS_PER_SEC;
+		return RET_SUCCESS;
 	}
 
 	if (strcmp(section, "mqtt") == 0)
@@ -92,38 +118,134 @@ static int iniHandler(void* user, const char* section, const char* name, const c
             args->mqttPassword = strdup(value);
         else if (strcmp(name, "publishInterval") == 0)
             args->publishInterval = (UINT16)atoi(value);
+        else if (strcmp(name, "maxPayloadBytes") == 0)
+            args->maxPayload = (UINT32)atoi(value);
+        else if (strcmp(name, "encoding") == 0)
+            args->encoding = payloadEncoding(value);
+        else if (strcmp(name, "qos") == 0)
+            args->qos = (UINT8)atoi(value);
+        else if (strcmp(name, "maxInflight") == 0)
+            args->maxInflight = (UINT16)atoi(value);
     }
 
+	if (strcmp(section, DB_SECTION) == 0)
+	{
+		if (strcmp(name, "flushSize") == 0)
+			args->db.flushSize = (UINT16)atoi(value);
+		else if (strcmp(name, "flushLatencyMs") == 0)
+			args->db.flushMs = (UINT32)atoi(value);
+		else if (strcmp(name, "retentionHours") == 0)
+			args->db.retentionHours = (UINT16)atoi(value);
+		else if (strcmp(name, "synchronous") == 0)
+			args->db.synchronous = storeSyncLevel(value);
+		else if (strcmp(name, "cacheSizeKb") == 0)
+			args->db.cacheKb = (UINT32)atoi(value);
+		else if (strcmp(name, "checkpointPages") == 0)
+			args->db.checkpointPages = (UINT32)atoi(value);
+		else if (strcmp(name, "checkpointIntervalSec") == 0)
+			args->db.checkpointSec = (UINT32)atoi(value);
+		else if (strcmp(name, "engine") == 0)
+			args->db.engine = storeEngine(value);
+		else if (strcmp(name, "tsPath") == 0)
+			args->db.tsPath = strdup(value);
+		else if (strcmp(name, "historyPath") == 0)
+			args->db.histPath = strdup(value);
+		else if (strcmp(name, "sealIntervalSec") == 0)
+			args->db.sealSec = (UINT32)atoi(value);
+	}
+
+	if (strcmp(section, SPOOL_SECTION) == 0)
+	{
+		if (strcmp(name, "path") == 0)
+			args->spool.path = strdup(value);
+		else if (strcmp(name, "sizeKb") == 0)
+			args->spool.sizeKb = (UINT32)atoi(value);
+		else if (strcmp(name, "replayBytesPerSec") == 0)
+			args->spool.rate = (UINT32)atoi(value);
+	}
+
+	if (strcmp(section, AGG_SECTION) == 0)
+	{
+		if (strcmp(name, "windows") == 0)
+		{
+			if ((windows = aggregateWindows(value, args->agg.windowSec)) == RET_FAILURE)
+			{
+				fprintf(stderr, "Aggregate: Invalid windows \"%s\", up to %d lengths in s, m or h\n", value, AGG_WINDOWS_MAX);
+				return 0;
+			}
+			args->agg.windows = (UINT8)windows;
+		}
+		else if (strcmp(name, "publishRaw") == 0)
+			args->agg.publishRaw = (BOOL)atoi(value);
+	}
+
     return RET_SUCCESS;
 }
 
-static ERROR_CODE readConfig(const CHAR *filename, PROGRAM_ARGS *args)
+static ERROR_CODE readConfig(const CHAR *filename, MP_INST *inst)
 {
+    PROGRAM_ARGS *args = &inst->args;
+    SENSOR_TABLE *tbl = &inst->sensors;
 	UINT16 ssIdx = 0;
-    if(ini_parse(filename, iniHandler, args) < 0)
+
+    args->maxPayload = MQTT_MAX_PAYLOAD_DEFAULT;
+    args->qos = MQTT_QOS_DEFAULT;
+    args->maxInflight = MQTT_INFLIGHT_DEFAULT;
+    args->db.flushSize = DB_FLUSH_SIZE_DEFAULT;
+    args->db.flushMs = DB_FLUSH_MS_DEFAULT;
+    args->db.retentionHours = DB_RETENTION_HOURS_DEFAULT;
+    args->db.synchronous = DB_SYNC_DEFAULT;
+    args->db.cacheKb = DB_CACHE_KB_DEFAULT;
+    args->db.checkpointPages = DB_CHECKPOINT_PAGES_DEFAULT;
+    args->db.checkpointSec = DB_CHECKPOINT_SEC_DEFAULT;
+    args->db.engine = DB_ENGINE_NATIVE;
+    args->db.tsPath = TS_PATH_DEFAULT;
+    args->db.histPath = HIST_PATH_DEFAULT;
+    args->db.sealSec = TS_SEAL_SEC_DEFAULT;
+    args->spool.path = SPOOL_PATH_DEFAULT;
+    args->spool.sizeKb = SPOOL_SIZE_KB_DEFAULT;
+    args->spool.rate = SPOOL_RATE_DEFAULT;
+
+    if(ini_parse(filename, iniHandler, inst) < 0)
 	{
         fprintf(stderr, "Failed to load config file: %s\n", filename);
         return RET_FAILURE;
     }
 
+	/* -n limits the number of sensors polled, default is all configured */
+	if(CUR_SENS_SIMULATOR)
+		sensorTableTruncate(tbl, CUR_SENS_SIMULATOR);
+
 	if(DEBUG_LOG)
 	{
 		fprintf(stdout,"Reading configuration..\n");
-		fprintf(stdout,"Number of sensor simulator : %d out of %d\n",CUR_SENS_SIMULATOR,MAX_SENS_SIMULATOR);
+		fprintf(stdout,"Number of sensor simulator : %d\n",tbl->count);
+	}
+
+	if(tbl->count == 0)
+	{
+		fprintf(stderr, "SS: No sensor configured\n");
+		return RET_FAILURE;
 	}
 
-	for(ssIdx=0;ssIdx < CUR_SENS_SIMULATOR;ssIdx++)
+	for(ssIdx=0;ssIdx < tbl->count;ssIdx++)
 	{
-		if(!args->sensorIP[ssIdx] || !args->sensorPort[ssIdx] || !args->readInterval[ssIdx] )
+		if(!tbl->ip[ssIdx] || !tbl->port[ssIdx] || !tbl->intervalMs[ssIdx] ||
+		   !tbl->regCount[ssIdx] || tbl->regCount[ssIdx] > MODBUS_BLOCK_MAX_REGS ||
+		   !tbl->depth[ssIdx] || tbl->depth[ssIdx] > MODBUS_MAX_INFLIGHT)
 		{
-			fprintf(stderr, "SS: Invalid configuration values\n");
+			fprintf(stderr, "SS: Invalid configuration values of sensor ID %d\n", tbl->id[ssIdx]);
 			return RET_FAILURE;
 		}
 		else
 		{
 			if(DEBUG_LOG)
-				fprintf(stdout,"Sensor ID : %d\n\tSensor simulator IP : %s\n\tPort: %d\n\tInterval : %d\n",
-							ssIdx,args->sensorIP[ssIdx],args->sensorPort[ssIdx],args->readInterval[ssIdx]);
+				fprintf(stdout,"Sensor ID : %d\n\tSensor simulator IP : %s\n\tPort: %d, unit ID %d\n\tInterval : %u ms\n\tRegisters : %d..%d\n\tPipeline : %d\n",
+							tbl->id[ssIdx],tbl->ip[ssIdx],tbl->port[ssIdx],tbl->unitId[ssIdx],tbl->intervalMs[ssIdx],
+							tbl->regStart[ssIdx],tbl->regStart[ssIdx] + tbl->regCount[ssIdx] - 1,tbl->depth[ssIdx]);
+			if(DEBUG_LOG && tbl->deadband[ssIdx].enabled)
+				fprintf(stdout,"\tDeadband : abs %u, pct %.2f%%, heartbeat %u s\n",tbl->deadband[ssIdx].abs,
+							(DOUBLE)tbl->deadband[ssIdx].pct100 / 100,tbl->deadband[ssIdx].heartbeatMs / MS_PER_SEC);
 		}
 	}
 
@@ -135,191 +257,224 @@ static ERROR_CODE readConfig(const CHAR *filename, PROGRAM_ARGS *args)
 	else
 	{
 		if(DEBUG_LOG)
-			fprintf(stdout,"\nMQTT Broker IP/URL : %s\nPort: %d\nInterval : %d\n",
-								args->mqttIP,args->mqttPort,args->publishInterval);
+			fprintf(stdout,"\nMQTT Broker IP/URL : %s\nPort: %d\nInterval : %d\nMax payload : %u bytes\nEncoding : %s\nQoS : %d, in flight %d\n",
+								args->mqttIP,args->mqttPort,args->publishInterval,args->maxPayload,
+								(args->encoding == PAYLOAD_BINARY) ? "binary" : "json",args->qos,args->maxInflight);
 	}
 
-    if(args->publishInterval < MIN_MQTT_PUB_INTERVAL || args->publishInterval > MAX_MQTT_PUB_INTERVAL)
+    if(args->maxPayload < MQTT_MAX_PAYLOAD_MIN || args->encoding == RET_FAILURE)
     {
-        fprintf(stderr, "Error: MQTT publish interval must be between %d and %d seconds.\n",MIN_MQTT_PUB_INTERVAL,MAX_MQTT_PUB_INTERVAL);
+        fprintf(stderr, "Error: MQTT maxPayloadBytes must be at least %d, encoding json or binary.\n",MQTT_MAX_PAYLOAD_MIN);
         return RET_FAILURE;
     }
 
-    return RET_OK;
-}
-
-/*************************************************************************
-* @brief        Connects to the Modbus TCP server.
-*
-* @details      This function connects to the Modbus TCP server using the provided
-*               IP address and port.
-*
-* @param[out]   ctx         Pointer to the Modbus context.
-* @param[in]    ip          The IP address of the Modbus TCP server.
-* @param[in]    port        The port of the Modbus TCP server.
-*
-* @return       ERROR_CODE  Returns RET_OK if the connection is successful,
-*                           otherwise returns RET_FAILURE.
-*************************************************************************/
-static ERROR_CODE connectModbus(modbus_t **ctx, const CHAR *ip, UINT16 port)
-{
-	if(DEBUG_LOG)
-		fprintf(stdout, "Modbus Connecting to %s:%d\n",ip,port);
-
-    *ctx = modbus_new_tcp(ip, port);
-    if(*ctx == NULL)
+    if(args->qos > 1 || !args->maxInflight || args->maxInflight > MQTT_INFLIGHT_MAX)
     {
-        fprintf(stderr, "Unable to allocate libmodbus context\n");
+        fprintf(stderr, "Error: MQTT qos must be 0 or 1, maxInflight 1..%d.\n",MQTT_INFLIGHT_MAX);
         return RET_FAILURE;
     }
 
-    if(modbus_connect(*ctx) == RET_FAILURE)
+    if(args->publishInterval < MIN_MQTT_PUB_INTERVAL || args->publishInterval > MAX_MQTT_PUB_INTERVAL)
     {
-        fprintf(stderr, "Connection failed: %s\n", modbus_strerror(errno));
-        modbus_free(*ctx);
-		*ctx = NULL;
+        fprintf(stderr, "Error: MQTT publish interval must be between %d and %d seconds.\n",MIN_MQTT_PUB_INTERVAL,MAX_MQTT_PUB_INTERVAL);
         return RET_FAILURE;
     }
+
+	if(!args->db.flushSize || args->db.flushSize > DB_FLUSH_SIZE_MAX || !args->db.flushMs || !args->db.retentionHours ||
+	   args->db.synchronous == RET_FAILURE || !args->db.cacheKb || args->db.engine == RET_FAILURE ||
+	   !args->db.tsPath || !args->db.histPath || !args->db.sealSec)
+	{
+		fprintf(stderr, "DB: Invalid configuration values, flushSize must be 1..%d, synchronous OFF/NORMAL/FULL/EXTRA, engine native, sqlite or ring\n", DB_FLUSH_SIZE_MAX);
+		return RET_FAILURE;
+	}
+	else
+	{
+		if(DEBUG_LOG && args->db.engine == DB_ENGINE_NATIVE)
+			fprintf(stdout,"\nDB engine : native, %s\nFlush latency : %u ms\nRetention : %d h\nBlock seal : every %u s\n",
+								args->db.tsPath,args->db.flushMs,args->db.retentionHours,args->db.sealSec);
+		else if(DEBUG_LOG && args->db.engine == DB_ENGINE_RING)
+			fprintf(stdout,"\nDB engine : ring, %s\nFlush latency : %u ms\nRetention : %d h\nSync : every %u s\n",
+								args->db.histPath,args->db.flushMs,args->db.retentionHours,args->db.sealSec);
+		else if(DEBUG_LOG)
+			fprintf(stdout,"\nDB engine : sqlite\nDB flush size : %d\nFlush latency : %u ms\nRetention : %d h\nSynchronous : %d\nCache : %u KiB\nCheckpoint : %u pages, every %u s\n",
+								args->db.flushSize,args->db.flushMs,args->db.retentionHours,args->db.synchronous,
+								args->db.cacheKb,args->db.checkpointPages,args->db.checkpointSec);
+	}
+
+	/* Without windows there is nothing but the raw samples to publish */
+	if(!args->agg.windows)
+		args->agg.publishRaw = TRUE;
+	else if(DEBUG_LOG)
+		fprintf(stdout,"\nAggregate : %d windows from %u s, raw samples %s\n",
+							args->agg.windows,args->agg.windowSec[0],args->agg.publishRaw ? "on" : "off");
+
+	if(args->spool.sizeKb && (!args->spool.path || !args->spool.rate))
+	{
+		fprintf(stderr, "Spool: Invalid configuration values, path and replayBytesPerSec are required\n");
+		return RET_FAILURE;
+	}
 	else
 	{
 		if(DEBUG_LOG)
-			fprintf(stdout, "Modbus Connected to %s:%d\n",ip,port);
+			fprintf(stdout,"\nSpool : %s, %u KiB, replay %u bytes/sec\n",
+								args->spool.path,args->spool.sizeKb,args->spool.rate);
 	}
 
     return RET_OK;
 }
 
 /*************************************************************************
-* @brief        Reads data from the Modbus TCP server.
+* @brief        Publishes data to the MQTT broker.
 *
-* @details      This function reads the power consumption data from the Modbus TCP server.
+* @details      This function publishes the power consumption data to the MQTT broker
+*               in JSON or the compact binary format. Every sample not yet
+*               sent is read from the rolling windows, so the cost is
+*               O(samples published) and SQLite is not queried. Samples
+*               carry the UTC read time in ms, JSON renders it as text with
+*               millisecond resolution. A message reaching
+*               maxPayloadBytes is sent and the rest continues in the next one.
+*               While the broker is unreachable messages go to the spool,
+*               they are replayed once it is back. Otherwise up to
+*               maxInflight messages await their acknowledgement, a full
+*               window leaves the rest for the next round.
 *
-* @param[in]    ctx         The Modbus context.
-* @param[out]   power       Pointer to the variable where the power consumption data will be stored.
+* @param[in]    mosq        The Mosquitto instance.
+* @param[in,out] win        Rolling windows, marked sent as messages go out.
 *
-* @return       ERROR_CODE  Returns RET_OK if the data is successfully read,
+* @return       ERROR_CODE  Returns RET_OK if the data is successfully published,
 *                           otherwise returns RET_FAILURE.
 *************************************************************************/
-static ERROR_CODE readModbus(modbus_t *ctx, UINT16 *power)
+static ERROR_CODE publishMQTT(struct mosquitto *mosq, SAMPLE_WINDOW *win)
 {
-    UINT8 tab_reg[MODBUS_TCP_MAX_ADU_LENGTH]={0};
-	UINT16 val=0;
-	const uint8_t raw_req[] = { 0xFF, MODBUS_FC_READ_HOLDING_REGISTERS, 0x00, 0x00, 0x00, 0x01 };
-	int req_length = modbus_send_raw_request(ctx, raw_req, 6 * sizeof(uint8_t));
+    PAYLOAD *pl = &mpInst.payload;
+    PAYLOAD_CURSOR cur = {0}, from = {0};
+    INT32 rc=0;
+    UINT64 nowMs=getRealtimeMs();
 
-	if(modbus_receive_confirmation(ctx, tab_reg) == -1)
+    mpInst.publishPending = FALSE;
+    cur.seq = win->count ? win->sent[0] : 0;
+    for(;;)
     {
-        fprintf(stderr, "Failed to read registers: %s\n", modbus_strerror(errno));
-        return RET_FAILURE;
-    }
+        if(CHECK_FLAG(MQTT_CONNECTED) && inflightFull())
+        {
+            mpInst.publishPending = TRUE;
+            break;
+        }
 
-	*power = tab_reg[1];
-	*power = (*power << 8) | tab_reg[0];
-	if(DEBUG_LOG)
-		fprintf(stdout, "Received modbus data %d\n",*power);
+        from = cur;
+        if(payloadEncode(pl, win, mpInst.sensors.id, &cur) != RET_OK)
+            return RET_FAILURE;
+
+        /* Nothing is published when there is no new data */
+        if(pl->records == 0)
+            break;
+
+        /* mosquitto copies the buffer into its own packet, the builder is reused straight away */
+        rc = MOSQ_ERR_NO_CONN;
+        if(CHECK_FLAG(MQTT_CONNECTED))
+            rc = inflightPublish(mosq, pl->buf, pl->len, win, &from, &cur, 0);
+        if(rc != MOSQ_ERR_SUCCESS && spoolAppend(pl->buf, pl->len, nowMs) != RET_OK)
+        {
+            fprintf(stderr, "Failed to publish message: %s\n",mosquitto_strerror(rc));
+            return RET_FAILURE;
+        }
+
+        /* Samples are taken sensor by sensor, everything before the cursor is sent */
+        memcpy(win->sent, win->head, cur.idx * sizeof(*win->sent));
+        if(cur.idx < win->count)
+            win->sent[cur.idx] = cur.seq;
+    }
 
     return RET_OK;
 }
 
 /*************************************************************************
-* @brief        Inserts data into the SQLite database.
+* @brief        Publishes the aggregate windows closed since the last call.
 *
-* @details      This function inserts the power consumption data into the SQLite database.
+* @details      Aggregates take the in-flight window before the raw
+*               samples, like them they are spooled while the broker is
+*               unreachable. A full window leaves the rest for the next
+*               round.
 *
-* @param[in]    db          The SQLite database connection.
-* @param[in]    sensorID    The ID of the sensor.
-* @param[in]    power       The power consumption data.
+* @param[in]    mosq        The Mosquitto instance.
 *
-* @return       ERROR_CODE  Returns RET_OK if the data is successfully inserted,
-*                           otherwise returns RET_FAILURE.
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
 *************************************************************************/
-static ERROR_CODE insertDB(sqlite3 *db, UINT16 sensorID, UINT16 power)
+static ERROR_CODE publishAggregates(struct mosquitto *mosq)
 {
-    INT32 rc=0;
-    CHAR sql[SIZE_256] = {0};
-    snprintf(sql, sizeof(sql), "INSERT INTO SensorData (Device_ID, Power_Consumption) VALUES (%d, %d);", sensorID, power);
-
-    if(sqlite3_exec(db, sql, 0, 0, 0) != SQLITE_OK)
+    PAYLOAD *pl = &mpInst.payload;
+    const AGG_RECORD *rec = NULL;
+    UINT32 count = 0;
+    INT32 rc = 0;
+    UINT64 nowMs = getRealtimeMs();
+
+    aggregateClose(nowMs);
+    for(rec = aggregatePending(&count); count; rec = aggregatePending(&count))
     {
-        fprintf(stderr, "INSERT SQL error: %s\n", sqlite3_errmsg(db));
-        /* Publish it directly to Server */
-        generateTimestamp(mpInst.timestamp, sizeof(mpInst.timestamp));
-        memset(sql,0,sizeof(sql));
-        snprintf(sql, sizeof(sql), "[{\"sensorID\": %d, \"power\": %d, \"Timestamp\": \"%s\"}]", sensorID, power, mpInst.timestamp);
-        if((rc = mosquitto_publish(mpInst.mosq, NULL, MQTT_TOPIC, strlen(sql), sql, 0, false)) != MOSQ_ERR_SUCCESS)
-            fprintf(stderr, "Failed to publish message: %s\n", mosquitto_strerror(rc));
-    }
-	else
-	{
-		if(DEBUG_LOG)
-			fprintf(stdout, "Modbus data of sensor ID %d inserted to DB : %d\n",sensorID,power);
-	}
+        if(CHECK_FLAG(MQTT_CONNECTED) && inflightFull())
+            break;
 
-    /* Delete old data beyond 24 hours */
-	memset(sql,0,sizeof(sql));
-    snprintf(sql, sizeof(sql), "DELETE FROM SensorData WHERE Timestamp < datetime('now', '-1 day');");
-    if(sqlite3_exec(db, sql, 0, 0, 0) != SQLITE_OK)
-        fprintf(stderr, "DELETE SQL error: %s\n", sqlite3_errmsg(db));
+        if(payloadEncodeAggregates(pl, rec, count) != RET_OK)
+            return RET_FAILURE;
+
+        rc = MOSQ_ERR_NO_CONN;
+        if(CHECK_FLAG(MQTT_CONNECTED))
+            rc = inflightPublish(mosq, pl->buf, pl->len, NULL, NULL, NULL, INFLIGHT_UNTRACKED);
+        if(rc != MOSQ_ERR_SUCCESS && spoolAppend(pl->buf, pl->len, nowMs) != RET_OK)
+        {
+            fprintf(stderr, "Failed to publish message: %s\n",mosquitto_strerror(rc));
+            return RET_FAILURE;
+        }
+        aggregateConsume(pl->records);
+    }
 
     return RET_OK;
 }
 
 /*************************************************************************
-* @brief        Publishes data to the MQTT broker.
+* @brief        Moves the samples queued by acquisition into the windows
+*               and the aggregates.
 *
-* @details      This function publishes the power consumption data to the MQTT broker
-*               in JSON format.
-*
-* @param[in]    mosq        The Mosquitto instance.
-* @param[in]    db          The SQLite database connection.
-* @param[in]    publishInterval The interval in seconds to publish the data.
+* @details      The aggregates take every read, the windows only those
+*               outside the deadband. While raw samples are not published
+*               they are marked sent and delivered as soon as they are
+*               aggregated.
 *
-* @return       ERROR_CODE  Returns RET_OK if the data is successfully published,
-*                           otherwise returns RET_FAILURE.
+* @return       void
 *************************************************************************/
-static ERROR_CODE publishMQTT(struct mosquitto *mosq, sqlite3 *db, UINT16 publishInterval)
+static void feedWindows(void)
 {
-    sqlite3_stmt *stmt=NULL;
-    CHAR temp[SIZE_256]={0};
-    INT32 rc=0;
-
-    snprintf(temp, sizeof(temp), "SELECT Device_ID, Power_Consumption, Timestamp FROM SensorData WHERE Timestamp >= datetime('now', '-%d seconds');", publishInterval);
+    SAMPLE_WINDOW *win = &mpInst.window;
+    SAMPLE batch[STORE_BATCH_MAX];
+    UINT32 n = 0;
 
-    rc = sqlite3_prepare_v2(db, temp, -1, &stmt, NULL);
-    if (rc != SQLITE_OK)
+    while((n = ringPop(&mpInst.pubRing, batch, STORE_BATCH_MAX)) > 0)
     {
-        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
-        return RET_FAILURE;
+        if(mpInst.args.agg.windows)
+            aggregateFeed(batch, n);
+        windowFeed(win, batch, n);
     }
+    if(!mpInst.args.agg.windows)
+        return;
 
-	memset(mpInst.payload,0,sizeof(mpInst.payload));
-    strcpy(mpInst.payload, "[");
-    while((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    if(toggleRaw)
     {
-		memset(temp,0,sizeof(temp));
-        snprintf(temp, sizeof(temp), "{\"sensorID\": %d, \"power\": %d, \"Timestamp\": \"%s\"},",
-                 sqlite3_column_int(stmt, 0),
-                 sqlite3_column_int(stmt, 1),
-                 sqlite3_column_text(stmt, 2));
-        strcat(mpInst.payload, temp);
+        toggleRaw = 0;
+        mpInst.publishRaw = !mpInst.publishRaw;
+        fprintf(stdout, "Raw samples are %s published\n", mpInst.publishRaw ? "now" : "no longer");
     }
-    sqlite3_finalize(stmt);
-
-    /* Remove the trailing comma and close the JSON array */
-    if(mpInst.payload[strlen(mpInst.payload) - 1] == ',')
-        mpInst.payload[strlen(mpInst.payload) - 1] = '\0';
-
-    strcat(mpInst.payload, "]");
 
-    if(strlen(mpInst.payload) > MQTT_PAYLOAD_MIN_SIZE) // to check if there is any data to publish
+    if(!mpInst.publishRaw)
     {
-        if((rc = mosquitto_publish(mpInst.mosq, NULL, MQTT_TOPIC, strlen(mpInst.payload), mpInst.payload, 0, false)) != MOSQ_ERR_SUCCESS)
-        {
-            fprintf(stderr, "Failed to publish message: %s\n",mosquitto_strerror(rc));
-            return RET_FAILURE;
-        }
+        memcpy(win->sent, win->head, win->count * sizeof(*win->sent));
+        memcpy(win->delivered, win->head, win->count * sizeof(*win->delivered));
     }
-    return RET_OK;
+}
+
+/* SIGUSR1 asks for raw samples on top of the aggregates, or stops them */
+static void on_sigusr1(int sig)
+{
+	toggleRaw = 1;
 }
 
 /* Callback for successful connection to the MQTT broker */
@@ -328,6 +483,7 @@ static void on_connect(struct mosquitto *mosq, void *obj, int rc)
     if(rc == 0)
 	{
 		SET_FLAG(MQTT_CONNECTED);
+		inflightConnect();
 		if(DEBUG_LOG)
 			fprintf(stdout,"Connected to MQTT broker successfully.\n");
 	}
@@ -335,9 +491,19 @@ static void on_connect(struct mosquitto *mosq, void *obj, int rc)
         fprintf(stderr, "Failed to connect to MQTT broker, return code: %d\n", rc);
 }
 
+/* Callback for a lost connection, mosquitto reconnects by itself */
+static void on_disconnect(struct mosquitto *mosq, void *obj, int rc)
+{
+	CLR_FLAG(MQTT_CONNECTED);
+	inflightDisconnect();
+	if(rc != 0)
+		fprintf(stderr, "Disconnected from MQTT broker, messages are spooled until it is back\n");
+}
+
 /* Callback for successful message publication */
 static void on_publish(struct mosquitto *mosq, void *obj, int mid)
 {
+	inflightAck(mid);
 	if(DEBUG_LOG)
 		fprintf(stdout,"Message published successfully, message ID: %d\n", mid);
 }
@@ -353,8 +519,11 @@ static void printUsage(void)
 {
     fprintf(stdout,"Usage: ems_mainProc [OPTIONS]\n");
     fprintf(stdout,"Options:\n");
-    fprintf(stdout,"  -n <max sensor>       Max number of sensor simulator(Upto 3)\n");
+    fprintf(stdout,"  -n <max sensor>       Poll only the first n configured sensors (default all)\n");
+    fprintf(stdout,"  -s <seconds>          Print per sensor polling statistics periodically\n");
     fprintf(stdout,"  -d                    Enable debug\n");
+    fprintf(stdout,"  -x <sqlite file>      Export the native or ring history to a SQLite SensorData table and exit\n");
+    fprintf(stdout,"SIGUSR1 switches raw samples on or off when [aggregate] windows are set\n");
     fprintf(stdout,"  -h, --help            Show this help message and exit\n");
 }
 
@@ -364,18 +533,26 @@ static void printUsage(void)
 INT32 main(INT32 argc, CHAR **argv, CHAR **envp)
 {
     INT32	rc = 0;
-	UINT16	idx = 0;
+	UINT64	nowMs = 0, wakeMs = 0;
+	struct timespec ts;
+	RING	*out[2];
 
-	while((rc = getopt(argc, argv, "n:h:d")) != RET_FAILURE)
+	while((rc = getopt(argc, argv, "n:s:x:h:d")) != RET_FAILURE)
     {
         switch (rc)
         {
             case 'n':
                 curSs = (UINT16)atoi(optarg);
             break;
+            case 's':
+                statsInterval = (UINT16)atoi(optarg);
+            break;
             case 'd':
 				modDebug = debug = TRUE;
             break;
+            case 'x':
+                exportPath = optarg;
+            break;
             case 'h':
                 printUsage();
                 exit(RET_OK);
@@ -387,7 +564,7 @@ INT32 main(INT32 argc, CHAR **argv, CHAR **envp)
         }
     }
 
-	if(curSs > MAX_SENS_SIMULATOR || curSs <= 0)
+	if(optind < argc)
 	{
 		fprintf(stderr, "Invalid inputs\n");
 		printUsage();
@@ -403,36 +580,44 @@ INT32 main(INT32 argc, CHAR **argv, CHAR **envp)
         {
             case STATE_INIT:
 			{
-				if(readConfig(CONFIG_FILE, &mpInst.args) != RET_OK)
+				if(readConfig(CONFIG_FILE, &mpInst) != RET_OK)
 				{
 					mpInst.state = STATE_ERROR;
 					break;
 				}
 
-				/* Initialize SQLite database */
-				rc = sqlite3_open(DB_NAME, &mpInst.db);
-				if(rc != SQLITE_OK)
+				/* SQLite stays available as an export target of the other engines */
+				if(exportPath)
+					return storeExport(exportPath, &mpInst.sensors, &mpInst.args.db);
+
+				/* Publishing reads recent samples from memory, the SQLite database is
+				   opened by the storage stage */
+				payloadInit(&mpInst.payload, mpInst.args.maxPayload, (UINT8)mpInst.args.encoding);
+				if(windowInit(&mpInst.window, &mpInst.sensors, mpInst.args.publishInterval) != RET_OK ||
+				   ringInit(&mpInst.pubRing, (UINT32)mpInst.sensors.count * RING_SLOTS_PER_SENSOR) != RET_OK)
 				{
-					fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(mpInst.db));
+					fprintf(stderr, "Failed to create the publish window\n");
 					mpInst.state = STATE_ERROR;
 					break;
 				}
 
-				/* Create table if not exists */
-				const CHAR *sql = "CREATE TABLE IF NOT EXISTS SensorData ("
-								  "ID INTEGER PRIMARY KEY AUTOINCREMENT, "
-								  "Device_ID INTEGER, "
-								  "Timestamp DATETIME DEFAULT CURRENT_TIMESTAMP, "
-								  "Power_Consumption INTEGER);";
-				rc = sqlite3_exec(mpInst.db, sql, 0, 0, 0);
-				if(rc != SQLITE_OK)
+				/* Messages left unsent by an earlier run are replayed once connected */
+				if(spoolOpen(&mpInst.args.spool) != RET_OK ||
+				   inflightInit(mpInst.args.maxInflight, mpInst.args.qos, mpInst.sensors.count) != RET_OK)
 				{
-					fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(mpInst.db));
-					sqlite3_close(mpInst.db);
 					mpInst.state = STATE_ERROR;
 					break;
 				}
 
+				if(aggregateInit(&mpInst.args.agg, &mpInst.sensors) != RET_OK)
+				{
+					fprintf(stderr, "Failed to create the aggregates\n");
+					mpInst.state = STATE_ERROR;
+					break;
+				}
+				mpInst.publishRaw = mpInst.args.agg.publishRaw;
+				signal(SIGUSR1, on_sigusr1);
+
 				/* Initialize MQTT */
 				CLR_FLAG(MQTT_CONNECTED);
 				mosquitto_lib_init();
@@ -440,7 +625,6 @@ INT32 main(INT32 argc, CHAR **argv, CHAR **envp)
 				if(!mpInst.mosq)
 				{
 					fprintf(stderr, "Failed to create mosquitto instance\n");
-					sqlite3_close(mpInst.db);
 					mpInst.state = STATE_ERROR;
 					break;
 				}
@@ -450,88 +634,115 @@ INT32 main(INT32 argc, CHAR **argv, CHAR **envp)
 
 				/* Set callbacks */
 				mosquitto_connect_callback_set(mpInst.mosq, on_connect);
+				mosquitto_disconnect_callback_set(mpInst.mosq, on_disconnect);
 				mosquitto_publish_callback_set(mpInst.mosq, on_publish);
 				mosquitto_log_callback_set(mpInst.mosq, on_log);
+				mosquitto_max_inflight_messages_set(mpInst.mosq, mpInst.args.maxInflight);
 
-				/* Connect to MQTT broker */
-				rc = mosquitto_connect(mpInst.mosq, mpInst.args.mqttIP, mpInst.args.mqttPort, 60);
-				if(rc != MOSQ_ERR_SUCCESS)
+				/* Connect in the background, samples are collected and spooled while the
+				   broker is unreachable and mosquitto retries until it is back */
+				rc = mosquitto_connect_async(mpInst.mosq, mpInst.args.mqttIP, mpInst.args.mqttPort, 60);
+				if(rc == MOSQ_ERR_INVAL)
 				{
-					fprintf(stderr, "Failed to connect to MQTT broker: %s\n", mosquitto_strerror(rc));
-					sqlite3_close(mpInst.db);
+					fprintf(stderr, "Invalid MQTT broker %s:%d\n", mpInst.args.mqttIP, mpInst.args.mqttPort);
 					mosquitto_destroy(mpInst.mosq);
 					mosquitto_lib_cleanup();
 					mpInst.state = STATE_ERROR;
 					break;
 				}
-				else
+				else if(rc != MOSQ_ERR_SUCCESS)
+					fprintf(stderr, "MQTT broker not reachable: %s, messages are spooled until it is back\n",
+							(rc == MOSQ_ERR_ERRNO) ? strerror(errno) : mosquitto_strerror(rc));
+
+				/* Create Mqtt Network Handle Thread */
+				rc = mosquitto_loop_start(mpInst.mosq);
+				if( rc != MOSQ_ERR_SUCCESS )
 				{
-					/* Create Mqtt Network Handle Thread */
-					rc = mosquitto_loop_start(mpInst.mosq);
-					if( rc != MOSQ_ERR_SUCCESS )
-					{
-						if(DEBUG_LOG)
-							fprintf(stderr,"Mqtt Loop thread start error..\n");
-
-						mpInst.state = STATE_ERROR;
-						break;
-					}
+					if(DEBUG_LOG)
+						fprintf(stderr,"Mqtt Loop thread start error..\n");
+
+					mpInst.state = STATE_ERROR;
+					break;
 				}
-                mpInst.state = STATE_CONNECT_MQTT;
+                mpInst.state = STATE_CONNECT_MODBUS;
 			}
             break;
-			case STATE_CONNECT_MQTT:
-			{
-				sleep(1);
-				mpInst.state = (CHECK_FLAG(MQTT_CONNECTED)) ? STATE_CONNECT_MODBUS : STATE_CONNECT_MQTT;
-			}
-			break;
             case STATE_CONNECT_MODBUS:
 			{
-                for(idx = 0; idx < CUR_SENS_SIMULATOR; idx++)
-                {
-                    if(!mpInst.mConnected[idx] && connectModbus(&mpInst.ctx[idx], mpInst.args.sensorIP[idx], mpInst.args.sensorPort[idx]) != RET_OK)
-                    {
-                        mpInst.mConnected[idx] = FALSE;
-                        continue;
-                    }
-                    else
-                        mpInst.mConnected[idx] = TRUE;
-
-					if(MODBUS_DEBUG) // Enable debug mode for the Modbus context
-						modbus_set_debug(mpInst.ctx[idx], TRUE);
-
-                    if(mpInst.mConnected[idx])
-                    {
-                        if(readModbus(mpInst.ctx[idx], &mpInst.power[idx]) != RET_OK)
-                            mpInst.mConnected[idx] = FALSE;
-                    }
-                }
-
-                mpInst.state = STATE_INSERT_DB;
+				/* Acquisition, storage and publishing run as separate stages joined by rings */
+				if(startStore(DB_NAME, &mpInst.sensors, &mpInst.args.db) != RET_OK)
+				{
+					mpInst.state = STATE_ERROR;
+					break;
+				}
+
+				/* Every sensor is polled on its own interval by the epoll event loop,
+				   the publish stage also gets the reads within the deadband to aggregate them */
+				out[0] = storeRing();
+				out[1] = &mpInst.pubRing;
+				if(startPoller(&mpInst.sensors, out, 2, 1 << 1) != RET_OK)
+				{
+					mpInst.state = STATE_ERROR;
+					break;
+				}
+
+				mpInst.nextPublishMs = getMonotonicMs() + ((UINT64)mpInst.args.publishInterval * MS_PER_SEC);
+				mpInst.nextStatsMs = getMonotonicMs() + ((UINT64)statsInterval * MS_PER_SEC);
+                mpInst.state = STATE_WAIT_PUBLISH;
 			}
             break;
-            case STATE_INSERT_DB:
+            case STATE_WAIT_PUBLISH:
 			{
-                for(idx = 0; idx < CUR_SENS_SIMULATOR; idx++)
-                {
-                    if(mpInst.mConnected[idx])
-                        insertDB(mpInst.db, (idx + 1), mpInst.power[idx]);
-                }
-                mpInst.state = STATE_PUBLISH_MQTT;
+				/* Samples are polled and stored by their own threads, move the new ones
+				   into the windows until the next deadline */
+				feedWindows();
+				wakeMs = getMonotonicMs() + PUBLISH_DRAIN_MS;
+				if(mpInst.nextPublishMs < wakeMs)
+					wakeMs = mpInst.nextPublishMs;
+				if(statsInterval && mpInst.nextStatsMs < wakeMs)
+					wakeMs = mpInst.nextStatsMs;
+
+				ts.tv_sec = (time_t)(wakeMs / MS_PER_SEC);
+				ts.tv_nsec = (long)((wakeMs % MS_PER_SEC) * 1000000);
+				clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+				/* Acknowledged messages free the in-flight window, live samples take
+				   it first and the spool replays in what is left */
+				nowMs = getMonotonicMs();
+				inflightCollect(&mpInst.window, &mpInst.payload, mpInst.sensors.id);
+				if(CHECK_FLAG(MQTT_CONNECTED) && !mpInst.publishPending)
+					spoolReplay(mpInst.mosq, nowMs);
+
+				if(nowMs >= mpInst.nextPublishMs || (statsInterval && nowMs >= mpInst.nextStatsMs) ||
+				   (mpInst.publishPending && !inflightFull()))
+					mpInst.state = STATE_PUBLISH_MQTT;
 			}
             break;
             case STATE_PUBLISH_MQTT:
 			{
-                if(publishMQTT(mpInst.mosq, mpInst.db, mpInst.args.publishInterval) != RET_OK)
-					mpInst.state = STATE_ERROR;
-                else
-                {
-                    for(idx = 0; idx < CUR_SENS_SIMULATOR; idx++)
-                        sleep(mpInst.args.readInterval[idx]);
+				mpInst.state = STATE_WAIT_PUBLISH;
+				nowMs = getMonotonicMs();
+
+				if(statsInterval && nowMs >= mpInst.nextStatsMs)
+				{
+					printPollStats(stdout, &mpInst.sensors);
+					printStoreStats(stdout);
+					printWindowStats(stdout, &mpInst.window, &mpInst.pubRing);
+					printInflightStats(stdout);
+					printSpoolStats(stdout);
+					printAggregateStats(stdout, mpInst.publishRaw);
+					mpInst.nextStatsMs += (UINT64)statsInterval * MS_PER_SEC;
+				}
 
-                    mpInst.state = STATE_CONNECT_MODBUS;
-                }
+				if(nowMs >= mpInst.nextPublishMs)
+					mpInst.nextPublishMs += (UINT64)mpInst.args.publishInterval * MS_PER_SEC;
+				else if(!mpInst.publishPending || inflightFull())
+					break;
+
+				feedWindows();
+                if(publishAggregates(mpInst.mosq) != RET_OK ||
+                   publishMQTT(mpInst.mosq, &mpInst.window) != RET_OK)
+					mpInst.state = STATE_ERROR;
 			}
             break;
             default:
@@ -540,18 +751,16 @@ INT32 main(INT32 argc, CHAR **argv, CHAR **envp)
         }
     }
 
-    /* Cleanup */
-    for(idx = 0; idx < CUR_SENS_SIMULATOR; idx++)
-    {
-        if(mpInst.ctx[idx])
-        {
-            modbus_close(mpInst.ctx[idx]);
-            modbus_free(mpInst.ctx[idx]);
-        }
-    }
-
-    if(mpInst.db)
-        sqlite3_close(mpInst.db);
+    /* Cleanup, producer first so the storage stage drains a closed ring */
+    stopPoller();
+    stopStore();
+    windowFree(&mpInst.window);
+    ringFree(&mpInst.pubRing);
+    payloadFree(&mpInst.payload);
+    spoolClose();
+    inflightFree();
+    aggregateFree();
+    sensorTableFree(&mpInst.sensors);
 
     if(mpInst.mosq)
     {
@@ -0,0 +1,429 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		Binary encoding
+*	17/10/2026		1.2			Ganesh		Samples carry the wall clock
+*	17/10/2026		1.3			Ganesh		Aggregate messages
+*	17/10/2026		1.4			Ganesh		Binary version 2, signed time deltas
+*
+**************************************************************************************/
+
+/*
+*	Binary message, version 2. Integers are LEB128 varints, zz() is zigzag.
+*
+*	UINT8	magic, PAYLOAD_BIN_MAGIC
+*	UINT8	version, PAYLOAD_BIN_VERSION
+*	varint	base time, UTC ms since the epoch, of the first sample
+*	blocks until the end of the message, one per sensor:
+*		varint	sensor ID
+*		varint	sample count, always 3 bytes so it can be patched
+*		per sample:
+*			varint	first sample zz(time - base), then zz(time - previous time),
+*					signed as the wall clock may step back on an NTP correction
+*			varint	zz(power - previous power), previous power starts at 0
+*/
+
+/*** Includes ***/
+#include <stdarg.h>
+#include "general.h"
+
+static const CHAR *encodingName[] = {"json", "binary"};
+
+/****************************************************************
+* Private Function
+****************************************************************/
+/*************************************************************************
+* @brief        Makes room for more bytes at the end of the payload.
+*
+* @param[in,out] pl         Payload.
+* @param[in]    extra       Bytes needed after the current end.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE payloadReserve(PAYLOAD *pl, UINT32 extra)
+{
+    UINT32 cap = pl->cap ? pl->cap : PAYLOAD_MIN_SIZE;
+    CHAR *buf = NULL;
+
+    if(pl->len + extra <= pl->cap)
+        return RET_OK;
+
+    while(cap < pl->len + extra)
+        cap *= 2;
+
+    buf = realloc(pl->buf, cap);
+    if(buf == NULL)
+        return RET_FAILURE;
+
+    pl->buf = buf;
+    pl->cap = cap;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Appends one formatted record to the message.
+*
+* @details      The record is printed straight into the buffer, the length
+*               is tracked so nothing is rescanned, appending is linear in
+*               the size of the message.
+*
+* @param[in,out] pl         Payload.
+* @param[in]    fmt         printf format of the record.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE payloadAppendf(PAYLOAD *pl, const CHAR *fmt, ...)
+{
+    va_list ap;
+    INT32 n = 0;
+    UINT32 sep = pl->records ? 1 : 0;
+
+    if(payloadReserve(pl, sep + 1) != RET_OK)
+        return RET_FAILURE;
+
+    for(;;)
+    {
+        va_start(ap, fmt);
+        n = vsnprintf(pl->buf + pl->len + sep, pl->cap - pl->len - sep, fmt, ap);
+        va_end(ap);
+        if(n < 0)
+            return RET_FAILURE;
+        if((UINT32)n < pl->cap - pl->len - sep)
+            break;
+        if(payloadReserve(pl, sep + (UINT32)n + 2) != RET_OK)
+            return RET_FAILURE;
+    }
+
+    if(sep)
+        pl->buf[pl->len] = ',';
+    pl->len += sep + (UINT32)n;
+    pl->records++;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Writes a LEB128 varint.
+*
+* @param[out]   out         At least PAYLOAD_VARINT_MAX bytes.
+* @param[in]    value       Value.
+*
+* @return       UINT32      Bytes written.
+*************************************************************************/
+static UINT32 putVarint(UINT8 *out, UINT64 value)
+{
+    UINT32 n = 0;
+
+    while(value >= 0x80)
+    {
+        out[n++] = (UINT8)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (UINT8)value;
+    return n;
+}
+
+/*************************************************************************
+* @brief        Maps a signed value to an unsigned one, small magnitudes
+*               give short varints.
+*
+* @param[in]    value       Signed value.
+*
+* @return       UINT64      Zigzag encoded value.
+*************************************************************************/
+static UINT64 zigzag(INT64 value)
+{
+    return ((UINT64)value << 1) ^ (UINT64)(value >> 63);
+}
+
+/*************************************************************************
+* @brief        Skips sensors whose samples are all consumed.
+*
+* @param[in]    win         Rolling windows.
+* @param[in,out] cur        Position of the next sample.
+*
+* @return       BOOL        FALSE once every sample is consumed.
+*************************************************************************/
+static BOOL cursorNext(const SAMPLE_WINDOW *win, PAYLOAD_CURSOR *cur)
+{
+    while(cur->idx < win->count && cur->seq == win->head[cur->idx])
+    {
+        if(++cur->idx < win->count)
+            cur->seq = win->sent[cur->idx];
+    }
+    return cur->idx < win->count;
+}
+
+/*************************************************************************
+* @brief        Fills one JSON message.
+*
+* @param[in,out] pl         Payload.
+* @param[in]    win         Rolling windows.
+* @param[in]    ids         Sensor ID of each window.
+* @param[in,out] cur        Position of the next sample.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE encodeJson(PAYLOAD *pl, const SAMPLE_WINDOW *win, const UINT16 *ids, PAYLOAD_CURSOR *cur)
+{
+    CHAR timestamp[SIZE_32] = {0};
+    UINT32 slot = 0;
+
+    if(payloadReserve(pl, PAYLOAD_RECORD_MAX) != RET_OK)
+        return RET_FAILURE;
+    pl->buf[pl->len++] = '[';
+
+    /* A message always takes one record, so a maxLen below one record still makes progress.
+       The check leaves room for the separator, a worst case record and the closing bracket. */
+    while(cursorNext(win, cur) && !(pl->records && pl->len + 1 + PAYLOAD_RECORD_MAX + 1 > pl->maxLen))
+    {
+        slot = win->base[cur->idx] + (cur->seq & win->mask[cur->idx]);
+        payloadTimestamp(timestamp, sizeof(timestamp), win->epochMs[slot]);
+
+        if(payloadAppendf(pl, "{\"sensorID\": %d, \"power\": %d, \"Timestamp\": \"%s\"}",
+                          ids[cur->idx], win->power[slot], timestamp) != RET_OK)
+            return RET_FAILURE;
+        cur->seq++;
+    }
+
+    if(payloadReserve(pl, 2) != RET_OK)
+        return RET_FAILURE;
+    pl->buf[pl->len++] = ']';
+    pl->buf[pl->len] = '\0';
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Fills one binary message, see the layout at the top.
+*
+* @details      Each record is encoded aside first so the message is
+*               filled exactly up to maxLen.
+*
+* @param[in,out] pl         Payload.
+* @param[in]    win         Rolling windows.
+* @param[in]    ids         Sensor ID of each window.
+* @param[in,out] cur        Position of the next sample.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE encodeBinary(PAYLOAD *pl, const SAMPLE_WINDOW *win, const UINT16 *ids, PAYLOAD_CURSOR *cur)
+{
+    UINT8 rec[2 * PAYLOAD_VARINT_MAX], *out = NULL;
+    UINT32 slot = 0, n = 0, block = 0, count = 0;
+    UINT64 baseMs = 0, prevMs = 0, timeMs = 0;
+    UINT16 prevPower = 0, blockIdx = 0;
+
+    if(!cursorNext(win, cur))
+        return RET_OK;
+
+    if(payloadReserve(pl, 2 + PAYLOAD_VARINT_MAX) != RET_OK)
+        return RET_FAILURE;
+    out = (UINT8*)pl->buf;
+    slot = win->base[cur->idx] + (cur->seq & win->mask[cur->idx]);
+    baseMs = win->epochMs[slot];
+    out[pl->len++] = PAYLOAD_BIN_MAGIC;
+    out[pl->len++] = PAYLOAD_BIN_VERSION;
+    pl->len += putVarint(out + pl->len, baseMs);
+
+    while(cursorNext(win, cur))
+    {
+        slot = win->base[cur->idx] + (cur->seq & win->mask[cur->idx]);
+        timeMs = win->epochMs[slot];
+
+        /* A new block starts per sensor and when the patched count is full */
+        if(!count || cur->idx != blockIdx || count == PAYLOAD_BIN_BLOCK_MAX)
+        {
+            n = putVarint(rec, zigzag((INT64)(timeMs - baseMs)));
+            n += putVarint(rec + n, zigzag((INT64)win->power[slot]));
+            if(pl->records && pl->len + PAYLOAD_VARINT_MAX + PAYLOAD_BIN_COUNT_LEN + n > pl->maxLen)
+                break;
+            if(payloadReserve(pl, PAYLOAD_VARINT_MAX + PAYLOAD_BIN_COUNT_LEN + n) != RET_OK)
+                return RET_FAILURE;
+
+            out = (UINT8*)pl->buf;
+            pl->len += putVarint(out + pl->len, ids[cur->idx]);
+            block = pl->len;
+            pl->len += PAYLOAD_BIN_COUNT_LEN;
+            blockIdx = cur->idx;
+            count = 0;
+        }
+        else
+        {
+            n = putVarint(rec, zigzag((INT64)(timeMs - prevMs)));
+            n += putVarint(rec + n, zigzag((INT64)win->power[slot] - prevPower));
+            if(pl->len + n > pl->maxLen)
+                break;
+            if(payloadReserve(pl, n) != RET_OK)
+                return RET_FAILURE;
+            out = (UINT8*)pl->buf;
+        }
+
+        memcpy(out + pl->len, rec, n);
+        pl->len += n;
+        pl->records++;
+        prevMs = timeMs;
+        prevPower = win->power[slot];
+        cur->seq++;
+
+        /* Non minimal 3 byte varint, any LEB128 decoder reads it */
+        count++;
+        out[block] = (UINT8)(count | 0x80);
+        out[block + 1] = (UINT8)((count >> 7) | 0x80);
+        out[block + 2] = (UINT8)(count >> 14);
+    }
+    return RET_OK;
+}
+
+/****************************************************************
+* Public Function
+****************************************************************/
+/*************************************************************************
+* @brief        Sets up an empty payload builder.
+*
+* @param[out]   pl          Payload.
+* @param[in]    maxLen      Largest message the builder lets through.
+* @param[in]    encoding    PAYLOAD_JSON or PAYLOAD_BINARY.
+*
+* @return       void
+*************************************************************************/
+void payloadInit(PAYLOAD *pl, UINT32 maxLen, UINT8 encoding)
+{
+    memset(pl, 0, sizeof(*pl));
+    pl->maxLen = maxLen;
+    pl->encoding = encoding;
+}
+
+/*************************************************************************
+* @brief        Frees the payload buffer.
+*
+* @param[in,out] pl         Payload.
+*
+* @return       void
+*************************************************************************/
+void payloadFree(PAYLOAD *pl)
+{
+    free(pl->buf);
+    memset(pl, 0, sizeof(*pl));
+}
+
+/*************************************************************************
+* @brief        Builds the next message from the samples not yet sent.
+*
+* @details      Samples are taken sensor by sensor from the cursor on until
+*               the message reaches maxLen. The buffer can be handed to
+*               mosquitto_publish() as it is, it stays valid until the
+*               next call. No records means nothing was left to send.
+*
+* @param[in,out] pl         Payload, holds the message on return.
+* @param[in]    win         Rolling windows.
+* @param[in]    ids         Sensor ID of each window.
+* @param[in,out] cur        Position of the next sample, start it at
+*                           sensor 0 and its first unsent sample.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE payloadEncode(PAYLOAD *pl, const SAMPLE_WINDOW *win, const UINT16 *ids, PAYLOAD_CURSOR *cur)
+{
+    pl->len = 0;
+    pl->records = 0;
+    if(pl->encoding == PAYLOAD_BINARY)
+        return encodeBinary(pl, win, ids, cur);
+
+    return encodeJson(pl, win, ids, cur);
+}
+
+/*************************************************************************
+* @brief        Builds the next message of closed aggregate windows.
+*
+* @details      Aggregates are few, so they are always JSON whatever the
+*               encoding of the raw samples. Timestamp is the start of
+*               the window and window its length in seconds.
+*
+* @param[in,out] pl         Payload, holds the message on return.
+* @param[in]    rec         Aggregates not yet published.
+* @param[in]    count       Number of aggregates.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*                           pl->records tells how many were taken.
+*************************************************************************/
+ERROR_CODE payloadEncodeAggregates(PAYLOAD *pl, const AGG_RECORD *rec, UINT32 count)
+{
+    CHAR timestamp[SIZE_32] = {0};
+    UINT32 i = 0;
+
+    pl->len = 0;
+    pl->records = 0;
+    if(!count)
+        return RET_OK;
+
+    if(payloadReserve(pl, AGG_RECORD_MAX) != RET_OK)
+        return RET_FAILURE;
+    pl->buf[pl->len++] = '[';
+
+    for(i = 0; i < count && !(pl->records && pl->len + 1 + AGG_RECORD_MAX + 1 > pl->maxLen); i++)
+    {
+        payloadTimestamp(timestamp, sizeof(timestamp), rec[i].startMs);
+        if(payloadAppendf(pl, "{\"sensorID\": %d, \"window\": %u, \"Timestamp\": \"%s\", "
+                              "\"count\": %u, \"min\": %u, \"max\": %u, \"avg\": %.2f}",
+                          rec[i].id, rec[i].windowSec, timestamp, rec[i].count, rec[i].min, rec[i].max,
+                          (DOUBLE)rec[i].sum / rec[i].count) != RET_OK)
+            return RET_FAILURE;
+    }
+
+    if(payloadReserve(pl, 2) != RET_OK)
+        return RET_FAILURE;
+    pl->buf[pl->len++] = ']';
+    pl->buf[pl->len] = '\0';
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Formats a sample time for JSON, the only place it becomes
+*               text.
+*
+* @param[out]   buf         Output, SIZE_32 is enough.
+* @param[in]    size        Size of buf.
+* @param[in]    epochMs     UTC ms since the epoch.
+*
+* @return       void
+*************************************************************************/
+void payloadTimestamp(CHAR *buf, UINT32 size, UINT64 epochMs)
+{
+    time_t sec = (time_t)(epochMs / MS_PER_SEC);
+    struct tm tmUtc;
+    UINT32 len = 0;
+
+    gmtime_r(&sec, &tmUtc);
+    len = (UINT32)strftime(buf, size, "%Y-%m-%d %H:%M:%S", &tmUtc);
+    snprintf(buf + len, size - len, ".%03u", (UINT32)(epochMs % MS_PER_SEC));
+}
+
+/*************************************************************************
+* @brief        Converts an [mqtt] encoding name to its value.
+*
+* @param[in]    name        json or binary, case insensitive.
+*
+* @return       INT32       Encoding, RET_FAILURE if the name is unknown.
+*************************************************************************/
+INT32 payloadEncoding(const CHAR *name)
+{
+    INT32 i = 0;
+
+    for(i = 0; i < (INT32)(sizeof(encodingName) / sizeof(encodingName[0])); i++)
+    {
+        if(strcasecmp(name, encodingName[i]) == 0)
+            return i;
+    }
+    return RET_FAILURE;
+}
+
+/* EOF */
@@ -0,0 +1,824 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		Deadband
+*	17/10/2026		1.2			Ganesh		Modbus unit ID per sensor
+*	17/10/2026		1.3			Ganesh		Reads within the deadband still aggregated
+*	17/10/2026		1.4			Ganesh		Responses checked against the polled unit ID
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include "general.h"
+
+/*** Globals ***/
+static pthread_t		pollThread;
+static BOOL				pollStarted;
+static INT32			pollEpoll = RET_FAILURE;
+static pthread_mutex_t	pollLock = PTHREAD_MUTEX_INITIALIZER;
+static SENSOR_TABLE		*pollTbl;
+static RING				*pollOut[POLL_MAX_OUTPUTS];	/* Stages fed with every sample */
+static UINT8			pollOutCount;
+static UINT8			pollEveryRead;	/* Bit per output also fed the reads within the deadband */
+static UINT32			pollSeed;
+static SCHED			pollSched = {.fd = RET_FAILURE};
+
+/****************************************************************
+* Private Function
+****************************************************************/
+/*************************************************************************
+* @brief        Prints a Modbus frame in hex when Modbus debug is enabled.
+*
+* @param[in]    dir         Direction marker, '>' sent or '<' received.
+* @param[in]    buf         Frame bytes.
+* @param[in]    len         Frame length.
+*
+* @return       void
+*************************************************************************/
+static void dumpFrame(CHAR dir, const UINT8 *buf, UINT16 len)
+{
+    UINT16 i = 0;
+
+    if(!MODBUS_DEBUG)
+        return;
+
+    for(i = 0; i < len; i++)
+        fprintf(stdout, "%c%.2X%s", (i == 0) ? dir : ' ', buf[i], (i == len - 1) ? "\n" : "");
+}
+
+/*************************************************************************
+* @brief        Counts a lost read slot of a sensor.
+*
+* @param[in]    idx         Sensor index.
+*
+* @return       void
+*************************************************************************/
+static void countFailure(UINT16 idx)
+{
+    pthread_mutex_lock(&pollLock);
+    pollTbl->stats[idx].failures++;
+    pthread_mutex_unlock(&pollLock);
+}
+
+/*************************************************************************
+* @brief        Closes the socket of a link and schedules a reconnect.
+*
+* @details      The reconnect waits for an exponential backoff with jitter
+*               so dead meters cost nothing between attempts and many links
+*               dropped together do not reconnect in lock step.
+*
+* @param[in]    idx         Sensor index.
+* @param[in]    reason      Text printed to stderr.
+* @param[in]    nowMs       Current monotonic time.
+*
+* @return       void
+*************************************************************************/
+static void dropLink(UINT16 idx, const CHAR *reason, UINT64 nowMs)
+{
+    MODBUS_LINK *link = &pollTbl->link[idx];
+
+    /* Report the start of an outage, retries only in debug */
+    if(!link->downMs || DEBUG_LOG)
+        fprintf(stderr, "Sensor ID %d (%s:%d): %s\n", pollTbl->id[idx],
+                    pollTbl->ip[idx], pollTbl->port[idx], reason);
+
+    if(link->fd >= 0)
+    {
+        epoll_ctl(pollEpoll, EPOLL_CTL_DEL, link->fd, NULL);
+        close(link->fd);
+    }
+    link->fd = RET_FAILURE;
+    link->inflight = 0;
+    link->rxLen = 0;
+    link->failStreak = 0;
+    pollTbl->deadband[idx].reported = FALSE;	/* The first read after the outage goes out */
+    if(!link->downMs)
+        link->downMs = nowMs;
+
+    link->backoffMs = link->backoffMs ? (link->backoffMs * 2) : MODBUS_BACKOFF_MIN_MS;
+    if(link->backoffMs > MODBUS_BACKOFF_MAX_MS)
+        link->backoffMs = MODBUS_BACKOFF_MAX_MS;
+    link->retryMs = nowMs + link->backoffMs + (UINT64)(rand_r(&pollSeed) % (link->backoffMs / 4 + 1));
+    pollTbl->state[idx] = LINK_BACKOFF;
+
+    countFailure(idx);
+}
+
+/*************************************************************************
+* @brief        Counts a failed request on a link that is still connected.
+*
+* @details      A single lost or rejected reply only degrades the link, the
+*               socket is reused. It is dropped after MODBUS_DEGRADED_LIMIT
+*               failures in a row.
+*
+* @param[in]    idx         Sensor index.
+* @param[in]    reason      Text printed to stderr.
+* @param[in]    nowMs       Current monotonic time.
+*
+* @return       void
+*************************************************************************/
+static void degradeLink(UINT16 idx, const CHAR *reason, UINT64 nowMs)
+{
+    MODBUS_LINK *link = &pollTbl->link[idx];
+
+    if(++link->failStreak >= MODBUS_DEGRADED_LIMIT)
+    {
+        dropLink(idx, reason, nowMs);
+        return;
+    }
+
+    if(DEBUG_LOG)
+        fprintf(stderr, "Sensor ID %d: %s\n", pollTbl->id[idx], reason);
+
+    if(!link->downMs)
+        link->downMs = nowMs;
+    pollTbl->state[idx] = LINK_DEGRADED;
+    countFailure(idx);
+}
+
+/*************************************************************************
+* @brief        Marks a link healthy after a successful read.
+*
+* @details      Ends an outage, if any, and records the time it took to
+*               recover. Called with pollLock held.
+*
+* @param[in]    idx         Sensor index.
+* @param[in]    nowMs       Current monotonic time.
+*
+* @return       void
+*************************************************************************/
+static void markHealthy(UINT16 idx, UINT64 nowMs)
+{
+    MODBUS_LINK *link = &pollTbl->link[idx];
+    POLL_STATS *stats = &pollTbl->stats[idx];
+    UINT32 recoverMs = 0;
+
+    if(link->downMs)
+    {
+        recoverMs = (UINT32)(nowMs - link->downMs);
+        stats->recoveries++;
+        stats->recoverLastMs = recoverMs;
+        stats->recoverTotalMs += recoverMs;
+        if(recoverMs > stats->recoverMaxMs)
+            stats->recoverMaxMs = recoverMs;
+        link->downMs = 0;
+    }
+    link->failStreak = 0;
+    link->backoffMs = 0;
+    pollTbl->state[idx] = LINK_HEALTHY;
+}
+
+/*************************************************************************
+* @brief        Starts a non-blocking TCP connect for a link.
+*
+* @details      The socket is registered for EPOLLOUT, completion is handled
+*               by the event loop so a dead meter never blocks the others.
+*
+* @param[in]    idx         Sensor index.
+* @param[in]    nowMs       Current monotonic time.
+*
+* @return       void
+*************************************************************************/
+static void startConnect(UINT16 idx, UINT64 nowMs)
+{
+    MODBUS_LINK *link = &pollTbl->link[idx];
+    struct sockaddr_in addr;
+    struct epoll_event ev;
+    INT32 one = 1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(pollTbl->port[idx]);
+    if(inet_pton(AF_INET, pollTbl->ip[idx], &addr.sin_addr) != 1)
+    {
+        dropLink(idx, "Invalid IP address", nowMs);
+        return;
+    }
+
+    link->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(link->fd < 0)
+    {
+        dropLink(idx, strerror(errno), nowMs);
+        return;
+    }
+    setsockopt(link->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if(DEBUG_LOG)
+        fprintf(stdout, "Modbus Connecting to %s:%d\n", pollTbl->ip[idx], pollTbl->port[idx]);
+
+    if(connect(link->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS)
+    {
+        dropLink(idx, strerror(errno), nowMs);
+        return;
+    }
+
+    ev.events = EPOLLOUT;
+    ev.data.u32 = idx;
+    if(epoll_ctl(pollEpoll, EPOLL_CTL_ADD, link->fd, &ev) < 0)
+    {
+        dropLink(idx, strerror(errno), nowMs);
+        return;
+    }
+
+    pollTbl->state[idx] = LINK_CONNECTING;
+    link->sentMs = nowMs;
+}
+
+/*************************************************************************
+* @brief        Sends the read holding registers request of a link.
+*
+* @details      The request reads the configured register block. Up to
+*               depth requests may be outstanding on the link, each one
+*               tracked by its transaction ID.
+*
+* @param[in]    idx         Sensor index.
+* @param[in]    nowMs       Current monotonic time.
+*
+* @return       void
+*************************************************************************/
+static void sendRequest(UINT16 idx, UINT64 nowMs)
+{
+    MODBUS_LINK *link = &pollTbl->link[idx];
+    UINT8 req[MODBUS_READ_REQ_LENGTH] = {0};
+
+    link->tid++;
+    req[0] = (UINT8)(link->tid >> 8);
+    req[1] = (UINT8)(link->tid & 0xFF);
+    req[5] = 6;                                 /* Length of unit ID + PDU */
+    req[6] = pollTbl->unitId[idx];
+    req[7] = MODBUS_FC_READ_HOLDING_REGISTERS;
+    req[8] = (UINT8)(pollTbl->regStart[idx] >> 8);
+    req[9] = (UINT8)(pollTbl->regStart[idx] & 0xFF);
+    req[11] = pollTbl->regCount[idx];
+
+    dumpFrame('>', req, sizeof(req));
+    if(send(link->fd, req, sizeof(req), MSG_NOSIGNAL) != sizeof(req))
+    {
+        dropLink(idx, "Failed to send request", nowMs);
+        return;
+    }
+
+    link->due = FALSE;
+    link->pendTid[link->inflight] = link->tid;
+    link->pendMs[link->inflight] = nowMs;
+    link->inflight++;
+}
+
+/*************************************************************************
+* @brief        Removes an outstanding request matching a transaction ID.
+*
+* @param[in]    link        Modbus link.
+* @param[in]    tid         Transaction ID of the response.
+*
+* @return       BOOL        TRUE if the request was outstanding.
+*************************************************************************/
+static BOOL takePending(MODBUS_LINK *link, UINT16 tid)
+{
+    UINT8 i = 0;
+
+    for(i = 0; i < link->inflight; i++)
+    {
+        if(link->pendTid[i] == tid)
+        {
+            link->inflight--;
+            memmove(&link->pendTid[i], &link->pendTid[i + 1], (link->inflight - i) * sizeof(link->pendTid[0]));
+            memmove(&link->pendMs[i], &link->pendMs[i + 1], (link->inflight - i) * sizeof(link->pendMs[0]));
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*************************************************************************
+* @brief        Decides whether a read is stored and published raw.
+*
+* @details      The change is measured against the last value passed on,
+*               not the last read, so a slow drift is still reported
+*               once it adds up to the deadband.
+*
+* @param[in]    idx         Sensor index.
+* @param[in]    power       Power read.
+* @param[in]    nowMs       Current monotonic time.
+* @param[out]   heartbeat   TRUE if only the max silence passes it on.
+*
+* @return       BOOL        TRUE if the read is passed on.
+*************************************************************************/
+static BOOL deadbandPass(UINT16 idx, UINT16 power, UINT64 nowMs, BOOL *heartbeat)
+{
+    DEADBAND *db = &pollTbl->deadband[idx];
+    UINT32 delta = 0;
+
+    *heartbeat = FALSE;
+    if(!db->enabled)
+        return TRUE;
+
+    if(db->reported)
+    {
+        delta = (power > db->lastPower) ? (UINT32)(power - db->lastPower) : (UINT32)(db->lastPower - power);
+        if(delta <= db->abs || (UINT64)delta * 10000 <= (UINT64)db->pct100 * db->lastPower)
+        {
+            if(!db->heartbeatMs || nowMs - db->lastMs < db->heartbeatMs)
+                return FALSE;
+            *heartbeat = TRUE;
+        }
+    }
+
+    db->reported = TRUE;
+    db->lastPower = power;
+    db->lastMs = nowMs;
+    return TRUE;
+}
+
+/*************************************************************************
+* @brief        Parses the frames buffered on a link.
+*
+* @details      The MBAP length field tells where each frame ends, so
+*               partial reads are kept until the rest of the frame arrives.
+*               Responses are matched to requests by transaction ID, so
+*               pipelined replies may complete in any order, and must
+*               come from the unit ID polled, a gateway serves several. Each sample
+*               outside the deadband is pushed to every output ring, one
+*               within it only to the rings asking for every read. A full
+*               ring drops it rather than stalling the event loop.
+*
+* @param[in]    idx         Sensor index.
+* @param[in]    nowMs       Current monotonic time.
+*
+* @return       void
+*************************************************************************/
+static void parseFrames(UINT16 idx, UINT64 nowMs)
+{
+    MODBUS_LINK *link = &pollTbl->link[idx];
+    UINT16 frameLen = 0, tid = 0, reg = 0;
+    UINT16 *block = &pollTbl->regs[(size_t)idx * MODBUS_BLOCK_MAX_REGS];
+    UINT8 count = pollTbl->regCount[idx], out = 0;
+    const UINT8 *rx = link->rx;
+    BOOL pass = FALSE, heartbeat = FALSE;
+    SAMPLE sample;
+
+    while(link->rxLen >= MODBUS_MBAP_LENGTH)
+    {
+        frameLen = (UINT16)(6 + ((rx[4] << 8) | rx[5]));
+        if(frameLen > sizeof(link->rx) || frameLen < MODBUS_MBAP_LENGTH + 2)
+        {
+            dropLink(idx, "Invalid Modbus frame", nowMs);
+            return;
+        }
+        if(link->rxLen < frameLen)
+            return;
+
+        dumpFrame('<', rx, frameLen);
+        tid = (UINT16)((rx[0] << 8) | rx[1]);
+        if(!takePending(link, tid))
+        {
+            if(DEBUG_LOG)
+                fprintf(stdout, "Sensor ID %d: dropped response with transaction ID %d\n", pollTbl->id[idx], tid);
+        }
+        else if(rx[6] != pollTbl->unitId[idx] || rx[7] != MODBUS_FC_READ_HOLDING_REGISTERS ||
+                rx[8] != count * 2 || frameLen != MODBUS_MBAP_LENGTH + 2 + (count * 2))
+        {
+            /* The framing is intact, so the socket is kept */
+            degradeLink(idx, (rx[6] != pollTbl->unitId[idx]) ? "Modbus response from another unit ID" :
+                             (rx[7] & 0x80) ? "Modbus exception response" : "Unexpected Modbus response", nowMs);
+            if(pollTbl->state[idx] == LINK_BACKOFF)
+                return;
+        }
+        else
+        {
+            for(reg = 0; reg < count; reg++)
+                block[reg] = (UINT16)((rx[9 + (reg * 2)] << 8) | rx[10 + (reg * 2)]);
+
+            sample.idx = idx;
+            sample.id = pollTbl->id[idx];
+            sample.power = block[0];
+            sample.timeMs = nowMs;
+            sample.epochMs = getRealtimeMs();
+            pass = deadbandPass(idx, sample.power, nowMs, &heartbeat);
+            sample.suppressed = !pass;
+            for(out = 0; out < pollOutCount; out++)
+            {
+                if(pass || (pollEveryRead & (1 << out)))
+                    ringPush(pollOut[out], &sample);
+            }
+
+            pthread_mutex_lock(&pollLock);
+            pollTbl->stats[idx].samples++;
+            pollTbl->stats[idx].suppressed += !pass;
+            pollTbl->stats[idx].heartbeats += heartbeat;
+            markHealthy(idx, nowMs);
+            pthread_mutex_unlock(&pollLock);
+
+            if(DEBUG_LOG)
+                fprintf(stdout, "Received modbus data %d (%d registers)\n", block[0], count);
+        }
+
+        link->rxLen -= frameLen;
+        memmove(link->rx, link->rx + frameLen, link->rxLen);
+    }
+}
+
+/*************************************************************************
+* @brief        Handles an epoll event of a link.
+*
+* @param[in]    idx         Sensor index.
+* @param[in]    events      epoll event mask.
+* @param[in]    nowMs       Current monotonic time.
+*
+* @return       void
+*************************************************************************/
+static void handleEvent(UINT16 idx, UINT32 events, UINT64 nowMs)
+{
+    MODBUS_LINK *link = &pollTbl->link[idx];
+    struct epoll_event ev;
+    INT32 err = 0;
+    socklen_t len = sizeof(err);
+    ssize_t n = 0;
+
+    if(link->fd < 0)
+        return;
+
+    if(pollTbl->state[idx] == LINK_CONNECTING)
+    {
+        getsockopt(link->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if(err)
+        {
+            dropLink(idx, strerror(err), nowMs);
+            return;
+        }
+
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.u32 = idx;
+        epoll_ctl(pollEpoll, EPOLL_CTL_MOD, link->fd, &ev);
+        pollTbl->state[idx] = link->downMs ? LINK_DEGRADED : LINK_HEALTHY;
+        if(link->everUp)
+        {
+            pthread_mutex_lock(&pollLock);
+            pollTbl->stats[idx].reconnects++;
+            pthread_mutex_unlock(&pollLock);
+        }
+        link->everUp = TRUE;
+
+        if(DEBUG_LOG)
+            fprintf(stdout, "Modbus Connected to %s:%d\n", pollTbl->ip[idx], pollTbl->port[idx]);
+
+        if(link->due)
+            sendRequest(idx, nowMs);
+        return;
+    }
+
+    if(events & EPOLLIN)
+    {
+        n = recv(link->fd, link->rx + link->rxLen, sizeof(link->rx) - link->rxLen, 0);
+        if(n > 0)
+        {
+            link->rxLen += (UINT16)n;
+            parseFrames(idx, nowMs);
+            return;
+        }
+        if(n < 0 && (errno == EAGAIN || errno == EINTR))
+            return;
+    }
+
+    dropLink(idx, (events & EPOLLERR) ? "Socket error" : "Connection closed by peer", nowMs);
+}
+
+/*************************************************************************
+* @brief        Returns the earliest deadline of a link.
+*
+* @details      That is the next read slot, or an earlier connect timeout,
+*               reconnect or response timeout.
+*
+* @param[in]    idx         Sensor index.
+*
+* @return       UINT64      Monotonic deadline in milliseconds.
+*************************************************************************/
+static UINT64 linkDeadline(UINT16 idx)
+{
+    MODBUS_LINK *link = &pollTbl->link[idx];
+    UINT64 deadlineMs = pollTbl->nextMs[idx];
+
+    if(pollTbl->state[idx] == LINK_CONNECTING && link->sentMs + MODBUS_CONNECT_TIMEOUT_MS < deadlineMs)
+        deadlineMs = link->sentMs + MODBUS_CONNECT_TIMEOUT_MS;
+    if(pollTbl->state[idx] == LINK_BACKOFF && link->retryMs < deadlineMs)
+        deadlineMs = link->retryMs;
+    if(link->inflight && link->pendMs[0] + MODBUS_RESPONSE_TIMEOUT_MS < deadlineMs)
+        deadlineMs = link->pendMs[0] + MODBUS_RESPONSE_TIMEOUT_MS;
+
+    return deadlineMs;
+}
+
+/*************************************************************************
+* @brief        Serves the expired timers of one link.
+*
+* @details      Read slots are fired on a fixed grid t0 + k * interval, so
+*               a late wakeup does not shift the following slots. Slots the
+*               loop fell behind on are skipped and counted as missed, the
+*               delay of the slot served is added to the jitter histogram.
+*               Slots of a link that cannot take a request (connecting,
+*               backing off or pipeline full) are counted as lost at once,
+*               nothing waits on them.
+*
+* @param[in]    idx         Sensor index.
+* @param[in]    nowMs       Current monotonic time.
+* @param[in]    nowUs       Current monotonic time in microseconds.
+*
+* @return       void
+*************************************************************************/
+static void runLinkTimers(UINT16 idx, UINT64 nowMs, UINT64 nowUs)
+{
+    MODBUS_LINK *link = &pollTbl->link[idx];
+    UINT8 *state = pollTbl->state;
+    UINT64 *dueMs = pollTbl->nextMs;
+    UINT64 intervalMs = pollTbl->intervalMs[idx], skipped = 0, slotUs = 0;
+
+    if(state[idx] == LINK_CONNECTING && nowMs - link->sentMs >= MODBUS_CONNECT_TIMEOUT_MS)
+        dropLink(idx, "Connection timed out", nowMs);
+    else if(state[idx] == LINK_BACKOFF && nowMs >= link->retryMs)
+        startConnect(idx, nowMs);
+
+    while(link->inflight && nowMs - link->pendMs[0] >= MODBUS_RESPONSE_TIMEOUT_MS)
+    {
+        /* Forget the oldest request, a late reply is dropped by its transaction ID */
+        takePending(link, link->pendTid[0]);
+        degradeLink(idx, "Response timed out", nowMs);
+    }
+
+    if(nowMs >= dueMs[idx])
+    {
+        /* Skip the slots already lost instead of bursting to catch up */
+        skipped = (nowMs - dueMs[idx]) / intervalMs;
+        slotUs = (dueMs[idx] + (skipped * intervalMs)) * 1000;
+        dueMs[idx] += (skipped + 1) * intervalMs;
+
+        pthread_mutex_lock(&pollLock);
+        pollTbl->stats[idx].missed += (UINT32)skipped;
+        jitterRecord(&pollTbl->stats[idx], (nowUs > slotUs) ? (UINT32)(nowUs - slotUs) : 0);
+        pthread_mutex_unlock(&pollLock);
+
+        if(state[idx] == LINK_IDLE)
+        {
+            link->due = TRUE;
+            startConnect(idx, nowMs);
+        }
+        else if((state[idx] == LINK_HEALTHY || state[idx] == LINK_DEGRADED) &&
+                link->inflight < pollTbl->depth[idx])
+        {
+            link->due = TRUE;
+            sendRequest(idx, nowMs);
+        }
+        else
+        {
+            /* Link not usable or pipeline full, this slot is lost */
+            link->due = (state[idx] == LINK_CONNECTING);
+            countFailure(idx);
+        }
+    }
+
+    schedSet(&pollSched, idx, linkDeadline(idx));
+}
+
+/*************************************************************************
+* @brief        Modbus acquisition event loop.
+*
+* @details      A single thread owns the sockets of all sensors. Reads are
+*               issued when a sensor's slot is due and responses are parsed
+*               as they arrive, so the number of sensors is bound by the
+*               event rate rather than by the Modbus round-trip time. The
+*               deadlines of all links are kept in a heap behind one timerfd,
+*               so a wakeup costs O(log n) per expired timer instead of a
+*               scan of every link.
+*
+* @param[in]    arg         Unused.
+*
+* @return       void*       Always NULL.
+*************************************************************************/
+static void *pollLoop(void *arg)
+{
+    struct epoll_event events[POLL_EPOLL_EVENTS];
+    INT32 n = 0, i = 0, idx = 0;
+    UINT64 nowMs = 0, deadlineMs = 0;
+
+    for(;;)
+    {
+        nowMs = getMonotonicMs();
+        while((idx = schedTop(&pollSched, &deadlineMs)) != RET_FAILURE && deadlineMs <= nowMs)
+            runLinkTimers((UINT16)idx, nowMs, getMonotonicUs());
+        schedArm(&pollSched);
+
+        n = epoll_wait(pollEpoll, events, POLL_EPOLL_EVENTS, -1);
+        for(i = 0; i < n; i++)
+        {
+            if(events[i].data.u32 == POLL_TIMER_EVENT)
+            {
+                schedAck(&pollSched);
+                continue;
+            }
+            idx = (INT32)events[i].data.u32;
+            handleEvent((UINT16)idx, events[i].events, getMonotonicMs());
+            schedSet(&pollSched, (UINT16)idx, linkDeadline((UINT16)idx));
+        }
+    }
+
+    return NULL;
+}
+
+/****************************************************************
+* Public Function
+****************************************************************/
+/*************************************************************************
+* @brief        Reads the monotonic clock.
+*
+* @details      Used for all scheduling so that wall clock adjustments
+*               (NTP, RTC sync) do not disturb the sampling intervals.
+*
+* @return       UINT64      Monotonic time in milliseconds.
+*************************************************************************/
+UINT64 getMonotonicMs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((UINT64)ts.tv_sec * MS_PER_SEC) + (UINT64)(ts.tv_nsec / 1000000);
+}
+
+/*************************************************************************
+* @brief        Reads the monotonic clock with microsecond resolution.
+*
+* @return       UINT64      Monotonic time in microseconds.
+*************************************************************************/
+UINT64 getMonotonicUs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((UINT64)ts.tv_sec * 1000000) + (UINT64)(ts.tv_nsec / 1000);
+}
+
+/*************************************************************************
+* @brief        Reads the wall clock, for timestamps leaving the process.
+*
+* @return       UINT64      UTC time in milliseconds since the epoch.
+*************************************************************************/
+UINT64 getRealtimeMs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ((UINT64)ts.tv_sec * MS_PER_SEC) + (UINT64)(ts.tv_nsec / 1000000);
+}
+
+/*************************************************************************
+* @brief        Starts the Modbus acquisition event loop.
+*
+* @param[in]    tbl         Sensor table to poll.
+* @param[in]    out         Rings of the stages fed with every sample, the
+*                           event loop is their only producer.
+* @param[in]    outCount    Number of rings, up to POLL_MAX_OUTPUTS.
+* @param[in]    everyRead   Bit per ring that also gets the reads within
+*                           the deadband, marked suppressed.
+*
+* @return       ERROR_CODE  Returns RET_OK if the event loop is started,
+*                           otherwise returns RET_FAILURE.
+*************************************************************************/
+ERROR_CODE startPoller(SENSOR_TABLE *tbl, RING *const *out, UINT8 outCount, UINT8 everyRead)
+{
+    struct epoll_event ev;
+    UINT16 idx = 0;
+    UINT64 nowMs = getMonotonicMs();
+
+    if(outCount > POLL_MAX_OUTPUTS)
+        return RET_FAILURE;
+    memcpy(pollOut, out, outCount * sizeof(*pollOut));
+    pollOutCount = outCount;
+    pollEveryRead = everyRead;
+
+    pollEpoll = epoll_create1(EPOLL_CLOEXEC);
+    ev.events = EPOLLIN;
+    ev.data.u32 = POLL_TIMER_EVENT;
+    if(pollEpoll < 0 || schedInit(&pollSched, tbl->count) != RET_OK ||
+       epoll_ctl(pollEpoll, EPOLL_CTL_ADD, pollSched.fd, &ev) < 0)
+    {
+        fprintf(stderr, "Failed to create the polling event loop: %s\n", strerror(errno));
+        stopPoller();
+        return RET_FAILURE;
+    }
+
+    pollTbl = tbl;
+    pollSeed = (UINT32)nowMs ^ (UINT32)getpid();
+    for(idx = 0; idx < tbl->count; idx++)
+    {
+        tbl->link[idx].fd = RET_FAILURE;
+        tbl->state[idx] = LINK_IDLE;
+        /* Spread the first slots over one interval so sensors do not fire together */
+        tbl->nextMs[idx] = nowMs + ((UINT64)tbl->intervalMs[idx] * idx / tbl->count);
+        tbl->stats[idx].startMs = nowMs;
+        schedSet(&pollSched, idx, tbl->nextMs[idx]);
+    }
+
+    if(pthread_create(&pollThread, NULL, pollLoop, NULL) != 0)
+    {
+        fprintf(stderr, "Failed to start the polling thread\n");
+        stopPoller();
+        return RET_FAILURE;
+    }
+    pollStarted = TRUE;
+
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Stops the event loop and closes all Modbus links.
+*
+* @return       void
+*************************************************************************/
+void stopPoller(void)
+{
+    UINT16 idx = 0;
+
+    if(pollStarted)
+    {
+        pthread_cancel(pollThread);
+        pthread_join(pollThread, NULL);
+        pollStarted = FALSE;
+
+        for(idx = 0; idx < pollTbl->count; idx++)
+        {
+            if(pollTbl->link[idx].fd >= 0)
+                close(pollTbl->link[idx].fd);
+            pollTbl->link[idx].fd = RET_FAILURE;
+        }
+    }
+
+    if(pollEpoll >= 0)
+        close(pollEpoll);
+    pollEpoll = RET_FAILURE;
+    schedFree(&pollSched);
+    pollOutCount = 0;
+    pollEveryRead = 0;
+}
+
+/*************************************************************************
+* @brief        Prints achieved vs. configured sample rate per sensor.
+*
+* @param[in]    fp          Output stream.
+* @param[in]    tbl         Sensor table.
+*
+* @return       void
+*************************************************************************/
+void printPollStats(FILE *fp, SENSOR_TABLE *tbl)
+{
+    const CHAR *stateName[] = {"idle","connecting","healthy","degraded","backoff"};
+    UINT16 idx = 0;
+    UINT64 elapsedMs = 0, samples = 0, suppressed = 0;
+    POLL_STATS stats;
+    DOUBLE configured = 0, achieved = 0;
+    const DEADBAND *db = NULL;
+
+    for(idx = 0; idx < tbl->count; idx++)
+    {
+        pthread_mutex_lock(&pollLock);
+        stats = tbl->stats[idx];
+        pthread_mutex_unlock(&pollLock);
+
+        elapsedMs = getMonotonicMs() - stats.startMs;
+        configured = (DOUBLE)MS_PER_SEC / tbl->intervalMs[idx];
+        achieved = elapsedMs ? ((DOUBLE)stats.samples * MS_PER_SEC / elapsedMs) : 0;
+        fprintf(fp, "Sensor ID %d : %s, configured %.3f Hz, achieved %.3f Hz (%.1f%%), samples %u, failures %u\n",
+                    tbl->id[idx], stateName[tbl->state[idx]], configured, achieved,
+                    configured ? (achieved * 100 / configured) : 0, stats.samples, stats.failures);
+        if(stats.reconnects || stats.recoveries)
+            fprintf(fp, "\treconnects %u, recoveries %u, time to recover last %u ms, avg %llu ms, max %u ms\n",
+                        stats.reconnects, stats.recoveries, stats.recoverLastMs,
+                        stats.recoveries ? (stats.recoverTotalMs / stats.recoveries) : 0, stats.recoverMaxMs);
+        jitterPrint(fp, &stats);
+
+        db = &tbl->deadband[idx];
+        if(db->enabled)
+        {
+            fprintf(fp, "\tdeadband abs %u, pct %.2f%%, heartbeat %u s: passed on %u, suppressed %u (%.1f%%), heartbeats %u\n",
+                        db->abs, (DOUBLE)db->pct100 / 100, db->heartbeatMs / MS_PER_SEC,
+                        stats.samples - stats.suppressed, stats.suppressed,
+                        stats.samples ? ((DOUBLE)stats.suppressed * 100 / stats.samples) : 0, stats.heartbeats);
+            samples += stats.samples;
+            suppressed += stats.suppressed;
+        }
+    }
+
+    /* Uplink and broker load scale with what is passed on */
+    if(samples)
+        fprintf(fp, "Deadband : suppressed %llu of %llu reads (%.1f%%), %.2f reads per sample passed on\n",
+                    (unsigned long long)suppressed, (unsigned long long)samples, (DOUBLE)suppressed * 100 / samples,
+                    (samples > suppressed) ? ((DOUBLE)samples / (samples - suppressed)) : 0);
+}
+
+/* EOF */
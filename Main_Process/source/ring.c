@@ -0,0 +1,201 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include "general.h"
+
+/****************************************************************
+* Public Function
+****************************************************************/
+/*************************************************************************
+* @brief        Creates an empty ring.
+*
+* @param[out]   ring        Ring.
+* @param[in]    minSize     Minimum number of samples, rounded up to a
+*                           power of two.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE ringInit(RING *ring, UINT32 minSize)
+{
+    UINT32 size = RING_MIN_SIZE;
+
+    while(size < minSize && size < (1U << 31))
+        size <<= 1;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->mask = size - 1;
+    ring->slot = calloc(size, sizeof(*ring->slot));
+    ring->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(!ring->slot || ring->efd < 0)
+    {
+        ringFree(ring);
+        return RET_FAILURE;
+    }
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Frees a ring. Neither side may use it any more.
+*
+* @param[in,out] ring       Ring.
+*
+* @return       void
+*************************************************************************/
+void ringFree(RING *ring)
+{
+    if(ring->efd >= 0)
+        close(ring->efd);
+    free(ring->slot);
+    ring->slot = NULL;
+    ring->efd = RET_FAILURE;
+}
+
+/*************************************************************************
+* @brief        Appends a sample, called by the producer thread only.
+*
+* @details      Never blocks. The consumer is woken only when it is
+*               sleeping, so a busy consumer costs no system call.
+*
+* @param[in,out] ring       Ring.
+* @param[in]    sample      Sample to copy into the ring.
+*
+* @return       BOOL        FALSE if the ring was full and the sample dropped.
+*************************************************************************/
+BOOL ringPush(RING *ring, const SAMPLE *sample)
+{
+    UINT32 head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    UINT32 tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    UINT64 one = 1;
+
+    if(head - tail > ring->mask)
+    {
+        atomic_fetch_add_explicit(&ring->drops, 1, memory_order_relaxed);
+        return FALSE;
+    }
+
+    ring->slot[head & ring->mask] = *sample;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    atomic_fetch_add_explicit(&ring->pushed, 1, memory_order_relaxed);
+    if(head + 1 - tail > ring->peak)
+        ring->peak = head + 1 - tail;
+
+    /* Pairs with the fence in ringWait, either the consumer sees the new head or we see it waiting */
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load_explicit(&ring->waiting, memory_order_relaxed) &&
+       atomic_exchange_explicit(&ring->waiting, FALSE, memory_order_relaxed))
+    {
+        if(write(ring->efd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            fprintf(stderr, "Failed to wake ring consumer: %s\n", strerror(errno));
+    }
+    return TRUE;
+}
+
+/*************************************************************************
+* @brief        Takes up to max samples, called by the consumer thread only.
+*
+* @param[in,out] ring       Ring.
+* @param[out]   out         Samples taken, oldest first.
+* @param[in]    max         Capacity of out.
+*
+* @return       UINT32      Number of samples taken, 0 if the ring is empty.
+*************************************************************************/
+UINT32 ringPop(RING *ring, SAMPLE *out, UINT32 max)
+{
+    UINT32 tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    UINT32 head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    UINT32 n = head - tail, i = 0;
+
+    if(n > max)
+        n = max;
+    for(i = 0; i < n; i++)
+        out[i] = ring->slot[(tail + i) & ring->mask];
+
+    atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+    return n;
+}
+
+/*************************************************************************
+* @brief        Returns the number of samples waiting in the ring.
+*
+* @param[in]    ring        Ring.
+*
+* @return       UINT32      Depth of the ring.
+*************************************************************************/
+UINT32 ringDepth(RING *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire) -
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+/*************************************************************************
+* @brief        Sleeps until the ring is not empty, called by the consumer.
+*
+* @param[in,out] ring       Ring.
+* @param[in]    timeoutMs   Maximum time to sleep, -1 for no limit.
+*
+* @return       void
+*************************************************************************/
+void ringWait(RING *ring, INT32 timeoutMs)
+{
+    struct pollfd pfd = {.fd = ring->efd, .events = POLLIN};
+    UINT64 count = 0;
+
+    atomic_store_explicit(&ring->waiting, TRUE, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if(ringDepth(ring) == 0)
+        poll(&pfd, 1, timeoutMs);
+
+    atomic_store_explicit(&ring->waiting, FALSE, memory_order_relaxed);
+    if(read(ring->efd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        fprintf(stderr, "Failed to read ring eventfd: %s\n", strerror(errno));
+}
+
+/*************************************************************************
+* @brief        Wakes the consumer even if the ring is empty.
+*
+* @details      Used to make the consumer thread check its stop flag.
+*
+* @param[in,out] ring       Ring.
+*
+* @return       void
+*************************************************************************/
+void ringWake(RING *ring)
+{
+    UINT64 one = 1;
+
+    if(write(ring->efd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        fprintf(stderr, "Failed to wake ring consumer: %s\n", strerror(errno));
+}
+
+/*************************************************************************
+* @brief        Prints the depth and drop counters of a ring.
+*
+* @param[in]    fp          Output stream.
+* @param[in]    name        Name of the queue.
+* @param[in]    ring        Ring.
+*
+* @return       void
+*************************************************************************/
+void printRingStats(FILE *fp, const CHAR *name, RING *ring)
+{
+    fprintf(fp, "Queue %s : depth %u/%u, peak %u, pushed %u, dropped %u\n", name,
+                ringDepth(ring), ring->mask + 1, ring->peak,
+                atomic_load_explicit(&ring->pushed, memory_order_relaxed),
+                atomic_load_explicit(&ring->drops, memory_order_relaxed));
+}
+
+/* EOF */
@@ -0,0 +1,252 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include "general.h"
+
+/* Upper bound in microseconds of each jitter histogram bucket, last one is open */
+static const UINT32 jitterBound[JITTER_BUCKETS - 1] = {100, 250, 500, 1000, 2000, 5000, 10000, 50000, 100000};
+
+/****************************************************************
+* Private Function
+****************************************************************/
+/*************************************************************************
+* @brief        Swaps two heap entries and keeps the position index in step.
+*
+* @param[in,out] sch        Scheduler.
+* @param[in]    a           Heap position.
+* @param[in]    b           Heap position.
+*
+* @return       void
+*************************************************************************/
+static void heapSwap(SCHED *sch, UINT32 a, UINT32 b)
+{
+    UINT16 tmp = sch->heap[a];
+
+    sch->heap[a] = sch->heap[b];
+    sch->heap[b] = tmp;
+    sch->pos[sch->heap[a]] = a;
+    sch->pos[sch->heap[b]] = b;
+}
+
+/*************************************************************************
+* @brief        Restores the heap order around one position.
+*
+* @param[in,out] sch        Scheduler.
+* @param[in]    i           Heap position whose key changed.
+*
+* @return       void
+*************************************************************************/
+static void heapFix(SCHED *sch, UINT32 i)
+{
+    UINT32 parent = 0, child = 0;
+
+    while(i > 0)
+    {
+        parent = (i - 1) / 2;
+        if(sch->key[sch->heap[parent]] <= sch->key[sch->heap[i]])
+            break;
+        heapSwap(sch, i, parent);
+        i = parent;
+    }
+
+    for(;;)
+    {
+        child = (2 * i) + 1;
+        if(child >= sch->size)
+            break;
+        if(child + 1 < sch->size && sch->key[sch->heap[child + 1]] < sch->key[sch->heap[child]])
+            child++;
+        if(sch->key[sch->heap[i]] <= sch->key[sch->heap[child]])
+            break;
+        heapSwap(sch, i, child);
+        i = child;
+    }
+}
+
+/****************************************************************
+* Public Function
+****************************************************************/
+/*************************************************************************
+* @brief        Creates the scheduler of count timers and its timerfd.
+*
+* @details      Every timer starts due immediately. The timerfd is armed
+*               on CLOCK_MONOTONIC with absolute deadlines so it can be
+*               waited on by epoll together with the sockets.
+*
+* @param[out]   sch         Scheduler.
+* @param[in]    count       Number of timers, one per sensor.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE schedInit(SCHED *sch, UINT16 count)
+{
+    UINT32 i = 0;
+
+    memset(sch, 0, sizeof(*sch));
+    sch->heap = calloc(count, sizeof(*sch->heap));
+    sch->pos = calloc(count, sizeof(*sch->pos));
+    sch->key = calloc(count, sizeof(*sch->key));
+    sch->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(!sch->heap || !sch->pos || !sch->key || sch->fd < 0)
+    {
+        schedFree(sch);
+        return RET_FAILURE;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        sch->heap[i] = (UINT16)i;
+        sch->pos[i] = i;
+    }
+    sch->size = count;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Frees the scheduler.
+*
+* @param[in,out] sch        Scheduler.
+*
+* @return       void
+*************************************************************************/
+void schedFree(SCHED *sch)
+{
+    if(sch->fd >= 0)
+        close(sch->fd);
+    free(sch->heap);
+    free(sch->pos);
+    free(sch->key);
+    memset(sch, 0, sizeof(*sch));
+    sch->fd = RET_FAILURE;
+}
+
+/*************************************************************************
+* @brief        Moves the timer of one sensor to a new deadline.
+*
+* @param[in,out] sch        Scheduler.
+* @param[in]    idx         Sensor index.
+* @param[in]    deadlineMs  Monotonic deadline in milliseconds.
+*
+* @return       void
+*************************************************************************/
+void schedSet(SCHED *sch, UINT16 idx, UINT64 deadlineMs)
+{
+    sch->key[idx] = deadlineMs;
+    heapFix(sch, sch->pos[idx]);
+}
+
+/*************************************************************************
+* @brief        Returns the sensor whose timer expires first.
+*
+* @param[in]    sch         Scheduler.
+* @param[out]   deadlineMs  Its deadline.
+*
+* @return       INT32       Sensor index, or RET_FAILURE if there is none.
+*************************************************************************/
+INT32 schedTop(const SCHED *sch, UINT64 *deadlineMs)
+{
+    if(!sch->size)
+        return RET_FAILURE;
+
+    *deadlineMs = sch->key[sch->heap[0]];
+    return sch->heap[0];
+}
+
+/*************************************************************************
+* @brief        Arms the timerfd on the earliest deadline.
+*
+* @param[in,out] sch        Scheduler.
+*
+* @return       void
+*************************************************************************/
+void schedArm(SCHED *sch)
+{
+    struct itimerspec its;
+    UINT64 deadlineMs = 0;
+
+    if(schedTop(sch, &deadlineMs) == RET_FAILURE || deadlineMs == sch->armedMs)
+        return;
+
+    memset(&its, 0, sizeof(its));
+    /* An all zero it_value disarms the timer, fire at 1 ns instead */
+    its.it_value.tv_sec = (time_t)(deadlineMs / MS_PER_SEC);
+    its.it_value.tv_nsec = (long)((deadlineMs % MS_PER_SEC) * 1000000) + 1;
+    timerfd_settime(sch->fd, TFD_TIMER_ABSTIME, &its, NULL);
+    sch->armedMs = deadlineMs;
+}
+
+/*************************************************************************
+* @brief        Clears the expiry count of the timerfd after it fired.
+*
+* @param[in,out] sch        Scheduler.
+*
+* @return       void
+*************************************************************************/
+void schedAck(SCHED *sch)
+{
+    UINT64 expirations = 0;
+
+    if(read(sch->fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        fprintf(stderr, "Failed to read timerfd: %s\n", strerror(errno));
+    sch->armedMs = 0;
+}
+
+/*************************************************************************
+* @brief        Adds one scheduling delay to a jitter histogram.
+*
+* @param[in,out] stats      Poll statistics of the sensor.
+* @param[in]    lateUs      Delay of the read behind its slot, microseconds.
+*
+* @return       void
+*************************************************************************/
+void jitterRecord(POLL_STATS *stats, UINT32 lateUs)
+{
+    UINT8 bucket = 0;
+
+    while(bucket < JITTER_BUCKETS - 1 && lateUs >= jitterBound[bucket])
+        bucket++;
+
+    stats->jitterHist[bucket]++;
+    stats->jitterTotalUs += lateUs;
+    if(lateUs > stats->jitterMaxUs)
+        stats->jitterMaxUs = lateUs;
+}
+
+/*************************************************************************
+* @brief        Prints the jitter histogram of one sensor on one line.
+*
+* @param[in]    fp          Output stream.
+* @param[in]    stats       Poll statistics of the sensor.
+*
+* @return       void
+*************************************************************************/
+void jitterPrint(FILE *fp, const POLL_STATS *stats)
+{
+    UINT8 bucket = 0;
+    UINT32 slots = 0;
+
+    for(bucket = 0; bucket < JITTER_BUCKETS; bucket++)
+        slots += stats->jitterHist[bucket];
+
+    fprintf(fp, "\tjitter avg %llu us, max %u us, missed slots %u |",
+                slots ? (stats->jitterTotalUs / slots) : 0, stats->jitterMaxUs, stats->missed);
+    for(bucket = 0; bucket < JITTER_BUCKETS - 1; bucket++)
+        fprintf(fp, " <%uus:%u", jitterBound[bucket], stats->jitterHist[bucket]);
+    fprintf(fp, " >=%uus:%u\n", jitterBound[JITTER_BUCKETS - 2], stats->jitterHist[JITTER_BUCKETS - 1]);
+}
+
+/* EOF */
@@ -0,0 +1,188 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		Modbus unit ID
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include "general.h"
+
+/****************************************************************
+* Private Function
+****************************************************************/
+/*************************************************************************
+* @brief        Grows one column of the sensor table.
+*
+* @param[in,out] column     Pointer to the column array.
+* @param[in]    elemSize    Size of one element.
+* @param[in]    oldCap      Current capacity.
+* @param[in]    newCap      New capacity.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE growColumn(void **column, size_t elemSize, UINT16 oldCap, UINT16 newCap)
+{
+    void *ptr = realloc(*column, elemSize * newCap);
+
+    if(ptr == NULL)
+        return RET_FAILURE;
+
+    memset((UINT8 *)ptr + (elemSize * oldCap), 0, elemSize * (newCap - oldCap));
+    *column = ptr;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Doubles the capacity of all columns of the sensor table.
+*
+* @param[in,out] tbl        Sensor table.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE growTable(SENSOR_TABLE *tbl)
+{
+    UINT16 oldCap = tbl->capacity;
+    UINT16 newCap = oldCap ? ((oldCap > MAX_SENSORS / 2) ? MAX_SENSORS : (UINT16)(oldCap * 2)) : SENSOR_TABLE_MIN_SIZE;
+
+    if(newCap == oldCap)
+        return RET_FAILURE;
+
+    if(growColumn((void **)&tbl->id, sizeof(*tbl->id), oldCap, newCap) != RET_OK ||
+       growColumn((void **)&tbl->ip, sizeof(*tbl->ip), oldCap, newCap) != RET_OK ||
+       growColumn((void **)&tbl->port, sizeof(*tbl->port), oldCap, newCap) != RET_OK ||
+       growColumn((void **)&tbl->unitId, sizeof(*tbl->unitId), oldCap, newCap) != RET_OK ||
+       growColumn((void **)&tbl->intervalMs, sizeof(*tbl->intervalMs), oldCap, newCap) != RET_OK ||
+       growColumn((void **)&tbl->regStart, sizeof(*tbl->regStart), oldCap, newCap) != RET_OK ||
+       growColumn((void **)&tbl->regCount, sizeof(*tbl->regCount), oldCap, newCap) != RET_OK ||
+       growColumn((void **)&tbl->depth, sizeof(*tbl->depth), oldCap, newCap) != RET_OK ||
+       growColumn((void **)&tbl->regs, sizeof(*tbl->regs) * MODBUS_BLOCK_MAX_REGS, oldCap, newCap) != RET_OK ||
+       growColumn((void **)&tbl->state, sizeof(*tbl->state), oldCap, newCap) != RET_OK ||
+       growColumn((void **)&tbl->nextMs, sizeof(*tbl->nextMs), oldCap, newCap) != RET_OK ||
+       growColumn((void **)&tbl->stats, sizeof(*tbl->stats), oldCap, newCap) != RET_OK ||
+       growColumn((void **)&tbl->link, sizeof(*tbl->link), oldCap, newCap) != RET_OK ||
+       growColumn((void **)&tbl->deadband, sizeof(*tbl->deadband), oldCap, newCap) != RET_OK)
+    {
+        /* Columns already grown keep their new size, capacity stays the old one */
+        return RET_FAILURE;
+    }
+
+    tbl->capacity = newCap;
+    return RET_OK;
+}
+
+/****************************************************************
+* Public Function
+****************************************************************/
+/*************************************************************************
+* @brief        Finds the row of a sensor ID.
+*
+* @param[in]    tbl         Sensor table.
+* @param[in]    id          Sensor ID.
+*
+* @return       INT32       Row index, or RET_FAILURE if not present.
+*************************************************************************/
+INT32 sensorTableFind(const SENSOR_TABLE *tbl, UINT16 id)
+{
+    INT32 idx = 0;
+
+    /* Config sections arrive grouped, so the last row is the usual hit */
+    for(idx = (INT32)tbl->count - 1; idx >= 0; idx--)
+    {
+        if(tbl->id[idx] == id)
+            return idx;
+    }
+    return RET_FAILURE;
+}
+
+/*************************************************************************
+* @brief        Returns the row of a sensor ID, appending it if new.
+*
+* @param[in,out] tbl        Sensor table.
+* @param[in]    id          Sensor ID.
+*
+* @return       INT32       Row index, or RET_FAILURE if out of memory.
+*************************************************************************/
+INT32 sensorTableAdd(SENSOR_TABLE *tbl, UINT16 id)
+{
+    INT32 idx = sensorTableFind(tbl, id);
+
+    if(idx != RET_FAILURE)
+        return idx;
+
+    if(tbl->count == tbl->capacity && growTable(tbl) != RET_OK)
+    {
+        fprintf(stderr, "Failed to grow sensor table beyond %d sensors\n", tbl->capacity);
+        return RET_FAILURE;
+    }
+
+    idx = tbl->count++;
+    tbl->id[idx] = id;
+    tbl->unitId[idx] = MODBUS_UNIT_ID;
+    tbl->regCount[idx] = 1;
+    tbl->depth[idx] = 1;
+    tbl->link[idx].fd = RET_FAILURE;
+    tbl->deadband[idx].heartbeatMs = DEADBAND_HEARTBEAT_DEFAULT * MS_PER_SEC;
+    return idx;
+}
+
+/*************************************************************************
+* @brief        Keeps only the first count rows of the table.
+*
+* @param[in,out] tbl        Sensor table.
+* @param[in]    count       Number of rows to keep.
+*
+* @return       void
+*************************************************************************/
+void sensorTableTruncate(SENSOR_TABLE *tbl, UINT16 count)
+{
+    UINT16 idx = 0;
+
+    for(idx = count; idx < tbl->count; idx++)
+    {
+        free(tbl->ip[idx]);
+        tbl->ip[idx] = NULL;
+    }
+    if(count < tbl->count)
+        tbl->count = count;
+}
+
+/*************************************************************************
+* @brief        Frees all columns of the sensor table.
+*
+* @param[in,out] tbl        Sensor table.
+*
+* @return       void
+*************************************************************************/
+void sensorTableFree(SENSOR_TABLE *tbl)
+{
+    sensorTableTruncate(tbl, 0);
+
+    free(tbl->id);
+    free(tbl->ip);
+    free(tbl->port);
+    free(tbl->unitId);
+    free(tbl->intervalMs);
+    free(tbl->regStart);
+    free(tbl->regCount);
+    free(tbl->depth);
+    free(tbl->regs);
+    free(tbl->state);
+    free(tbl->nextMs);
+    free(tbl->stats);
+    free(tbl->link);
+    free(tbl->deadband);
+    memset(tbl, 0, sizeof(*tbl));
+}
+
+/* EOF */
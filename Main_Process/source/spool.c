@@ -0,0 +1,408 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		Release replayed messages on acknowledgement
+*	17/10/2026		1.2			Ganesh		Replay again after a lost message
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include "general.h"
+
+/*** Globals ***/
+static INT32		spoolFd = RET_FAILURE;
+static UINT8		*spoolMap;
+static UINT64		spoolMapLen;
+static SPOOL_HEADER	*spoolHdr;
+static UINT8		*spoolData;
+static UINT32		spoolRate;
+static INT64		spoolTokens;
+static UINT64		spoolTokenMs;
+static UINT64		spoolSend;		/* Next record to replay, records before it are in flight */
+
+/* Counters since start, the header keeps what is in the file */
+static UINT32		spoolAppended;
+static UINT32		spoolReplayed;
+static UINT32		spoolDropped;
+static UINT64		spoolReplayedBytes;
+
+/****************************************************************
+* Private Function
+****************************************************************/
+/*************************************************************************
+* @brief        Returns the space a message takes in the spool.
+*
+* @param[in]    len         Message length.
+*
+* @return       UINT64      Record size, header included.
+*************************************************************************/
+static UINT64 recordSize(UINT32 len)
+{
+    return ((UINT64)sizeof(SPOOL_RECORD) + len + SPOOL_ALIGN - 1) & ~(UINT64)(SPOOL_ALIGN - 1);
+}
+
+/*************************************************************************
+* @brief        Finds the record at a position, skipping the unused end of
+*               the file the writer wrapped around.
+*
+* @param[in,out] pos        Byte counter, moved past the skipped bytes.
+*
+* @return       SPOOL_RECORD*   Record, NULL if pos reached the head.
+*************************************************************************/
+static SPOOL_RECORD *recordAt(UINT64 *pos)
+{
+    SPOOL_RECORD *rec = NULL;
+    UINT64 off = 0, rem = 0;
+
+    while(spoolHdr->head != *pos)
+    {
+        off = *pos % spoolHdr->capacity;
+        rem = spoolHdr->capacity - off;
+        rec = (SPOOL_RECORD*)(spoolData + off);
+        if(rem < sizeof(SPOOL_RECORD) || rec->flags == SPOOL_PAD)
+        {
+            *pos += rem;
+            continue;
+        }
+        return rec;
+    }
+    return NULL;
+}
+
+/*************************************************************************
+* @brief        Finds the oldest record, the tail then points at it.
+*
+* @return       SPOOL_RECORD*   Oldest record, NULL if the spool is empty.
+*************************************************************************/
+static SPOOL_RECORD *oldestRecord(void)
+{
+    return recordAt(&spoolHdr->tail);
+}
+
+/*************************************************************************
+* @brief        Releases the oldest record.
+*
+* @param[in]    rec         Record returned by oldestRecord().
+*
+* @return       void
+*************************************************************************/
+static void releaseRecord(const SPOOL_RECORD *rec)
+{
+    spoolHdr->tail += recordSize(rec->len);
+    spoolHdr->records--;
+    if(spoolSend < spoolHdr->tail)
+        spoolSend = spoolHdr->tail;
+}
+
+/*************************************************************************
+* @brief        Checks that a spool file left by an earlier run is usable.
+*
+* @param[in]    size        Size of the file.
+*
+* @return       BOOL        TRUE if the header and its offsets are valid.
+*************************************************************************/
+static BOOL headerValid(UINT64 size)
+{
+    return spoolHdr->magic == SPOOL_MAGIC && spoolHdr->version == SPOOL_VERSION &&
+           spoolHdr->capacity && !(spoolHdr->capacity % SPOOL_ALIGN) &&
+           size == SPOOL_DATA_OFFSET + spoolHdr->capacity &&
+           spoolHdr->head >= spoolHdr->tail && spoolHdr->head - spoolHdr->tail <= spoolHdr->capacity &&
+           !(spoolHdr->tail % SPOOL_ALIGN) && !(spoolHdr->head % SPOOL_ALIGN);
+}
+
+/*************************************************************************
+* @brief        Maps the spool file.
+*
+* @param[in]    len         Length of the file.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE mapSpool(UINT64 len)
+{
+    void *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, spoolFd, 0);
+
+    if(map == MAP_FAILED)
+        return RET_FAILURE;
+
+    spoolMap = map;
+    spoolMapLen = len;
+    spoolHdr = (SPOOL_HEADER*)spoolMap;
+    spoolData = spoolMap + SPOOL_DATA_OFFSET;
+    return RET_OK;
+}
+
+/****************************************************************
+* Public Function
+****************************************************************/
+/*************************************************************************
+* @brief        Opens the spool, keeping the messages of an earlier run.
+*
+* @details      A file that is not a valid spool is started afresh. A
+*               spool holding messages keeps its size until it drains,
+*               an empty one is resized to the configuration.
+*
+* @param[in]    cfg         [spool] configuration, sizeKb 0 disables it.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE spoolOpen(const SPOOL_CONFIG *cfg)
+{
+    struct stat st;
+    UINT64 capacity = (UINT64)cfg->sizeKb * 1024;
+
+    if(!cfg->sizeKb)
+        return RET_OK;
+
+    spoolRate = cfg->rate;
+    spoolTokens = cfg->rate;
+    spoolTokenMs = getMonotonicMs();
+
+    spoolFd = open(cfg->path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(spoolFd < 0 || fstat(spoolFd, &st) < 0)
+    {
+        fprintf(stderr, "Failed to open spool %s: %s\n", cfg->path, strerror(errno));
+        spoolClose();
+        return RET_FAILURE;
+    }
+
+    if((UINT64)st.st_size >= sizeof(SPOOL_HEADER) && mapSpool((UINT64)st.st_size) == RET_OK)
+    {
+        if(headerValid((UINT64)st.st_size) && (spoolHdr->head != spoolHdr->tail || spoolHdr->capacity == capacity))
+        {
+            spoolSend = spoolHdr->tail;
+            if(spoolHdr->records)
+                fprintf(stdout, "Spool %s holds %u messages, %llu bytes to replay\n", cfg->path,
+                            spoolHdr->records, (unsigned long long)(spoolHdr->head - spoolHdr->tail));
+            return RET_OK;
+        }
+        if(!headerValid((UINT64)st.st_size))
+            fprintf(stderr, "Spool %s is not valid, starting empty\n", cfg->path);
+        munmap(spoolMap, spoolMapLen);
+        spoolMap = NULL;
+    }
+
+    /* New, damaged or resized while empty */
+    if(ftruncate(spoolFd, 0) < 0 || ftruncate(spoolFd, (off_t)(SPOOL_DATA_OFFSET + capacity)) < 0 ||
+       mapSpool(SPOOL_DATA_OFFSET + capacity) != RET_OK)
+    {
+        fprintf(stderr, "Failed to create spool %s: %s\n", cfg->path, strerror(errno));
+        spoolClose();
+        return RET_FAILURE;
+    }
+
+    spoolHdr->version = SPOOL_VERSION;
+    spoolHdr->capacity = capacity;
+    spoolHdr->head = spoolHdr->tail = 0;
+    spoolHdr->records = 0;
+    spoolHdr->seq = 0;
+    spoolSend = 0;
+    spoolHdr->magic = SPOOL_MAGIC;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Writes the spool back to disk and closes it.
+*
+* @return       void
+*************************************************************************/
+void spoolClose(void)
+{
+    if(spoolMap)
+    {
+        msync(spoolMap, spoolMapLen, MS_SYNC);
+        munmap(spoolMap, spoolMapLen);
+    }
+    if(spoolFd >= 0)
+        close(spoolFd);
+
+    spoolMap = spoolData = NULL;
+    spoolHdr = NULL;
+    spoolFd = RET_FAILURE;
+}
+
+/*************************************************************************
+* @brief        Appends a message that could not be published.
+*
+* @details      The record is written before the head moves past it, a
+*               crash leaves either the whole record or none. A full spool
+*               drops its oldest messages, the newest data is kept.
+*
+* @param[in]    buf         Message.
+* @param[in]    len         Message length.
+* @param[in]    timeMs      Wall clock time, the replay lag is measured from it.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, RET_FAILURE if the spool
+*                           is disabled or the message is larger than it.
+*************************************************************************/
+ERROR_CODE spoolAppend(const CHAR *buf, UINT32 len, UINT64 timeMs)
+{
+    SPOOL_RECORD *rec = NULL;
+    UINT64 need = recordSize(len), off = 0, rem = 0, waste = 0;
+
+    if(!spoolHdr || need > spoolHdr->capacity)
+        return RET_FAILURE;
+
+    for(;;)
+    {
+        off = spoolHdr->head % spoolHdr->capacity;
+        rem = spoolHdr->capacity - off;
+        waste = (rem < need) ? rem : 0;
+        if(spoolHdr->head - spoolHdr->tail + waste + need <= spoolHdr->capacity)
+            break;
+
+        /* Empty, the record only needs the space the end of the file lacks */
+        if((rec = oldestRecord()) == NULL)
+        {
+            spoolHdr->head += waste;
+            spoolSend = spoolHdr->tail = spoolHdr->head;
+            continue;
+        }
+        releaseRecord(rec);
+        spoolDropped++;
+    }
+
+    /* Records never wrap, the end of the file is marked unused */
+    if(waste)
+    {
+        if(rem >= sizeof(SPOOL_RECORD))
+            ((SPOOL_RECORD*)(spoolData + off))->flags = SPOOL_PAD;
+        spoolHdr->head += waste;
+        off = 0;
+    }
+
+    rec = (SPOOL_RECORD*)(spoolData + off);
+    rec->len = len;
+    rec->flags = 0;
+    rec->timeMs = timeMs;
+    rec->seq = spoolHdr->seq++;
+    memcpy(rec + 1, buf, len);
+
+    atomic_thread_fence(memory_order_release);
+    spoolHdr->head += need;
+    spoolHdr->records++;
+    spoolAppended++;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Publishes spooled messages, oldest first.
+*
+* @details      A token bucket refilled at the configured rate, holding at
+*               most one second of it, bounds the replay so live messages
+*               keep their share of the uplink. A message larger than the
+*               bucket is sent when the bucket is full and leaves it in
+*               debt. Replay stops at the first failed publish or when the
+*               in-flight window is full. Messages stay in the spool until
+*               acknowledged, see spoolRelease().
+*
+* @param[in]    mosq        The Mosquitto instance.
+* @param[in]    nowMs       Monotonic time.
+*
+* @return       UINT32      Number of messages published.
+*************************************************************************/
+UINT32 spoolReplay(struct mosquitto *mosq, UINT64 nowMs)
+{
+    SPOOL_RECORD *rec = NULL;
+    UINT32 sent = 0;
+    INT32 rc = 0;
+
+    if(!spoolHdr)
+        return 0;
+
+    spoolTokens += (INT64)((nowMs - spoolTokenMs) * spoolRate / MS_PER_SEC);
+    if(spoolTokens > (INT64)spoolRate)
+        spoolTokens = spoolRate;
+    spoolTokenMs = nowMs;
+
+    while(spoolTokens > 0 && !inflightFull() && (rec = recordAt(&spoolSend)) != NULL)
+    {
+        if((rc = inflightPublish(mosq, (const CHAR*)(rec + 1), rec->len, NULL, NULL, NULL, rec->seq)) != MOSQ_ERR_SUCCESS)
+        {
+            if(DEBUG_LOG)
+                fprintf(stderr, "Spool replay paused: %s\n", mosquitto_strerror(rc));
+            break;
+        }
+
+        spoolSend += recordSize(rec->len);
+        spoolTokens -= rec->len;
+        spoolReplayedBytes += rec->len;
+        spoolReplayed++;
+        sent++;
+    }
+    return sent;
+}
+
+/*************************************************************************
+* @brief        Releases replayed messages once they are acknowledged, so
+*               they are never replayed again.
+*
+* @details      Acknowledgements are taken in publish order. A message the
+*               spool dropped meanwhile is simply gone already.
+*
+* @param[in]    seq         Sequence number of the acknowledged message.
+*
+* @return       void
+*************************************************************************/
+void spoolRelease(UINT64 seq)
+{
+    SPOOL_RECORD *rec = NULL;
+
+    if(!spoolHdr)
+        return;
+
+    while((rec = oldestRecord()) != NULL && rec->seq <= seq)
+        releaseRecord(rec);
+}
+
+/*************************************************************************
+* @brief        Replays again every message not released yet.
+*
+* @details      Used when a replayed message is lost with the connection,
+*               the ones replayed after it are sent once more as well.
+*
+* @return       void
+*************************************************************************/
+void spoolRewind(void)
+{
+    if(spoolHdr)
+        spoolSend = spoolHdr->tail;
+}
+
+/*************************************************************************
+* @brief        Prints the spool size and replay counters.
+*
+* @details      The replay lag is the age of the oldest message waiting.
+*
+* @param[in]    fp          Output stream.
+*
+* @return       void
+*************************************************************************/
+void printSpoolStats(FILE *fp)
+{
+    SPOOL_RECORD *rec = NULL;
+    UINT64 nowMs = getRealtimeMs(), lagMs = 0;
+
+    if(!spoolHdr)
+        return;
+
+    if((rec = oldestRecord()) != NULL && nowMs > rec->timeMs)
+        lagMs = nowMs - rec->timeMs;
+
+    fprintf(fp, "Spool : %u messages, %llu/%llu bytes, replay lag %llu ms\n", spoolHdr->records,
+                (unsigned long long)(spoolHdr->head - spoolHdr->tail), (unsigned long long)spoolHdr->capacity,
+                (unsigned long long)lagMs);
+    fprintf(fp, "\tspooled %u, replayed %u (%llu bytes, limit %u bytes/sec), dropped when full %u\n",
+                spoolAppended, spoolReplayed, (unsigned long long)spoolReplayedBytes, spoolRate, spoolDropped);
+}
+
+/* EOF */
@@ -0,0 +1,655 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		Integer ms timestamps
+*	17/10/2026		1.2			Ganesh		Native compressed store engine
+*	17/10/2026		1.3			Ganesh		Ring history engine, export of either engine
+*	17/10/2026		1.4			Ganesh		Samples not stored are counted, publishing has its own copy
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include "general.h"
+
+/*** Globals ***/
+static pthread_t		storeThread;
+static BOOL				storeStarted;
+static _Atomic BOOL		storeStop;
+static RING				storeQueue = {.efd = RET_FAILURE};
+static sqlite3			*storeDb;
+static sqlite3_stmt		*storeInsert;	/* Cached INSERT, bound per sample */
+static sqlite3_stmt		*storePurge;	/* Cached retention DELETE of one chunk */
+static SAMPLE			*storeBatch;	/* Samples of the open transaction */
+static DB_CONFIG		storeCfg;
+static UINT64			storePurgeMs;	/* Next retention check */
+static UINT64			storeCheckpointMs;	/* Next timed checkpoint */
+static _Atomic UINT32	storeRows;
+static _Atomic UINT32	storeErrors;
+static _Atomic UINT32	storeCommits;
+static _Atomic UINT32	storePurged;
+static _Atomic UINT32	storePurgeRuns;
+static _Atomic UINT32	storeCheckpoints;
+static _Atomic UINT32	storeCommitLastUs;	/* BEGIN to COMMIT done, of the last batch */
+static _Atomic UINT32	storeCommitMaxUs;
+static _Atomic UINT64	storeCommitTotalUs;
+
+/* PRAGMA synchronous levels, indexed by level */
+static const CHAR *syncName[] = {"OFF", "NORMAL", "FULL", "EXTRA"};
+static const CHAR *engineName[] = {"native", "sqlite", "ring"};
+
+/* Export in progress */
+typedef struct
+{
+    sqlite3_stmt	*stmt;
+    UINT32			errors;
+}STORE_EXPORT;
+
+/****************************************************************
+* Private Function
+****************************************************************/
+/*************************************************************************
+* @brief        Inserts a batch of samples into the SQLite database.
+*
+* @details      All samples go through the cached prepared INSERT inside
+*               one transaction, so the batch costs a single journal sync
+*               instead of one per sample. Samples that cannot be stored
+*               are only counted, the publisher gets every sample from
+*               its own ring.
+*
+* @param[in]    db          The SQLite database connection.
+* @param[in]    batch       Samples to insert.
+* @param[in]    n           Number of samples.
+*
+* @return       ERROR_CODE  Returns RET_OK if the batch is committed,
+*                           otherwise returns RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE insertBatch(sqlite3 *db, const SAMPLE *batch, UINT32 n)
+{
+    UINT32 i = 0, rows = 0, latencyUs = 0;
+    UINT64 startUs = getMonotonicUs();
+
+    if(sqlite3_exec(db, "BEGIN;", 0, 0, 0) != SQLITE_OK)
+    {
+        fprintf(stderr, "BEGIN SQL error: %s\n", sqlite3_errmsg(db));
+        storeErrors += n;
+        return RET_FAILURE;
+    }
+
+    for(i = 0; i < n; i++)
+    {
+        sqlite3_bind_int(storeInsert, 1, batch[i].id);
+        sqlite3_bind_int(storeInsert, 2, batch[i].power);
+        sqlite3_bind_int64(storeInsert, 3, (sqlite3_int64)batch[i].epochMs);
+        if(sqlite3_step(storeInsert) != SQLITE_DONE)
+        {
+            fprintf(stderr, "INSERT SQL error: %s\n", sqlite3_errmsg(db));
+            storeErrors++;
+        }
+        else
+            rows++;
+        sqlite3_reset(storeInsert);
+    }
+
+    if(sqlite3_exec(db, "COMMIT;", 0, 0, 0) != SQLITE_OK)
+    {
+        fprintf(stderr, "COMMIT SQL error: %s\n", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", 0, 0, 0);
+        storeErrors += rows;
+        return RET_FAILURE;
+    }
+
+    latencyUs = (UINT32)(getMonotonicUs() - startUs);
+    storeCommitLastUs = latencyUs;
+    storeCommitTotalUs += latencyUs;
+    if(latencyUs > storeCommitMaxUs)
+        storeCommitMaxUs = latencyUs;
+    storeRows += rows;
+    storeCommits++;
+    if(DEBUG_LOG)
+        fprintf(stdout, "Modbus data of %u samples inserted to DB\n", rows);
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Adds a batch of samples to the native store or the ring
+*               history.
+*
+* @details      Appending only encodes the samples into the open blocks,
+*               or stores them in their mapped slots, the disk is written
+*               when a block is sealed or the mappings are synced.
+*
+* @param[in]    batch       Samples to store.
+* @param[in]    n           Number of samples.
+*
+* @return       void
+*************************************************************************/
+static void appendBatch(const SAMPLE *batch, UINT32 n)
+{
+    UINT32 i = 0, rows = 0;
+
+    for(i = 0; i < n; i++)
+    {
+        if(((storeCfg.engine == DB_ENGINE_RING) ? histWrite(&batch[i]) : tsAppend(&batch[i])) != RET_OK)
+            storeErrors++;
+        else
+            rows++;
+    }
+
+    storeRows += rows;
+    storeCommits++;
+    if(DEBUG_LOG)
+        fprintf(stdout, "Modbus data of %u samples inserted to DB\n", rows);
+}
+
+/*************************************************************************
+* @brief        Deletes one chunk of rows older than the retention period.
+*
+* @details      The DELETE walks the TimeMs index from the oldest row,
+*               so a chunk costs O(rows deleted) whatever the table size.
+*               A full chunk means more rows have expired and the next
+*               chunk is run right after the pending samples are stored.
+*
+* @param[in]    db          The SQLite database connection.
+* @param[in]    nowMs       Current monotonic time.
+*
+* @return       void
+*************************************************************************/
+static void purgeExpired(sqlite3 *db, UINT64 nowMs)
+{
+    UINT64 cutoffMs = getRealtimeMs() - (UINT64)storeCfg.retentionHours * SEC_PER_HOUR * MS_PER_SEC;
+    INT32 deleted = 0;
+
+    /* The ring history overwrites its oldest slots, nothing to delete */
+    if(storeCfg.engine == DB_ENGINE_RING)
+    {
+        storePurgeMs = nowMs + DB_PURGE_INTERVAL_MS;
+        return;
+    }
+
+    /* The native store drops whole segment files, there is no next chunk */
+    if(storeCfg.engine == DB_ENGINE_NATIVE)
+    {
+        storePurged += tsPurge(cutoffMs);
+        storePurgeRuns++;
+        storePurgeMs = nowMs + DB_PURGE_INTERVAL_MS;
+        return;
+    }
+
+    sqlite3_bind_int64(storePurge, 1, (sqlite3_int64)cutoffMs);
+    sqlite3_bind_int(storePurge, 2, DB_PURGE_CHUNK);
+    if(sqlite3_step(storePurge) != SQLITE_DONE)
+        fprintf(stderr, "DELETE SQL error: %s\n", sqlite3_errmsg(db));
+    else
+        deleted = sqlite3_changes(db);
+    sqlite3_reset(storePurge);
+
+    storePurged += deleted;
+    storePurgeRuns++;
+    storePurgeMs = (deleted == DB_PURGE_CHUNK) ? nowMs : (nowMs + DB_PURGE_INTERVAL_MS);
+
+    if(DEBUG_LOG && deleted)
+        fprintf(stdout, "Deleted %d rows older than %d hours from DB\n", deleted, storeCfg.retentionHours);
+}
+
+/*************************************************************************
+* @brief        Runs a passive WAL checkpoint.
+*
+* @details      Passive mode copies what it can without waiting for the
+*               readers, so the publish path is never blocked by it.
+*
+* @param[in]    db          The SQLite database connection.
+* @param[in]    nowMs       Current monotonic time.
+*
+* @return       void
+*************************************************************************/
+static void checkpointWal(sqlite3 *db, UINT64 nowMs)
+{
+    INT32 logFrames = 0, copied = 0;
+
+    if(sqlite3_wal_checkpoint_v2(db, NULL, SQLITE_CHECKPOINT_PASSIVE, &logFrames, &copied) != SQLITE_OK)
+        fprintf(stderr, "Checkpoint error: %s\n", sqlite3_errmsg(db));
+    else if(DEBUG_LOG)
+        fprintf(stdout, "Checkpoint copied %d of %d WAL frames to DB\n", copied, logFrames);
+
+    storeCheckpoints++;
+    storeCheckpointMs = nowMs + ((UINT64)storeCfg.checkpointSec * MS_PER_SEC);
+}
+
+/*************************************************************************
+* @brief        Storage stage, drains the store ring into the native
+*               store, the ring history or SQLite.
+*
+* @details      Runs on its own thread so a slow SD card write or fsync
+*               only lets the ring fill up, it never delays a Modbus poll.
+*               Samples are committed once flushSize of them are queued or
+*               the oldest one has waited flushMs, whichever comes first.
+*               Retention and timed checkpoints run here too, between
+*               commits, on their own timers. The thread owns the writer
+*               connection, nothing else writes to the database.
+*
+* @param[in]    arg         Unused.
+*
+* @return       void*       Always NULL.
+*************************************************************************/
+static void *storeLoop(void *arg)
+{
+    UINT32 n = 0, got = 0;
+    UINT64 nowMs = 0, wakeMs = 0;
+
+    for(;;)
+    {
+        got = ringPop(&storeQueue, &storeBatch[n], storeCfg.flushSize - n);
+        n += got;
+
+        nowMs = getMonotonicMs();
+        if(n && (n == storeCfg.flushSize || nowMs >= storeBatch[0].timeMs + storeCfg.flushMs || storeStop))
+        {
+            if(storeCfg.engine == DB_ENGINE_SQLITE)
+                insertBatch(storeDb, storeBatch, n);
+            else
+                appendBatch(storeBatch, n);
+            n = 0;
+        }
+        if(storeStop)
+        {
+            if(!got && !n)
+                break;
+            continue;
+        }
+
+        if(nowMs >= storePurgeMs)
+            purgeExpired(storeDb, nowMs);
+        if(storeDb && storeCfg.checkpointSec && nowMs >= storeCheckpointMs)
+            checkpointWal(storeDb, nowMs);
+        if(storeCfg.engine == DB_ENGINE_NATIVE)
+            tsSealExpired(nowMs);
+        else if(storeCfg.engine == DB_ENGINE_RING)
+            histSync(nowMs);
+        if(got)
+            continue;
+
+        wakeMs = storePurgeMs;
+        if(storeDb && storeCfg.checkpointSec && storeCheckpointMs < wakeMs)
+            wakeMs = storeCheckpointMs;
+        if(storeCfg.engine == DB_ENGINE_NATIVE && tsSealDeadline() < wakeMs)
+            wakeMs = tsSealDeadline();
+        else if(storeCfg.engine == DB_ENGINE_RING && histSyncDeadline() < wakeMs)
+            wakeMs = histSyncDeadline();
+        if(n && storeBatch[0].timeMs + storeCfg.flushMs < wakeMs)
+            wakeMs = storeBatch[0].timeMs + storeCfg.flushMs;
+        nowMs = getMonotonicMs();
+        ringWait(&storeQueue, (wakeMs > nowMs) ? (INT32)(wakeMs - nowMs) : 0);
+    }
+
+    return NULL;
+}
+
+/*************************************************************************
+* @brief        Converts a database of the text Timestamp schema.
+*
+* @details      The read time is derived once from the stored text, the
+*               old column and its index are left unused.
+*
+* @param[in]    db          The SQLite database connection.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE migrateSchema(sqlite3 *db)
+{
+    sqlite3_stmt *stmt = NULL;
+    BOOL hasTimeMs = FALSE;
+
+    if(sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM pragma_table_info('SensorData') WHERE name = 'TimeMs';",
+                          -1, &stmt, NULL) != SQLITE_OK)
+        return RET_FAILURE;
+    if(sqlite3_step(stmt) == SQLITE_ROW)
+        hasTimeMs = (sqlite3_column_int(stmt, 0) != 0);
+    sqlite3_finalize(stmt);
+    if(hasTimeMs)
+        return RET_OK;
+
+    fprintf(stdout, "Converting SensorData timestamps to integer ms\n");
+    if(sqlite3_exec(db, "BEGIN;"
+                        "ALTER TABLE SensorData ADD COLUMN TimeMs INTEGER NOT NULL DEFAULT 0;"
+                        "UPDATE SensorData SET TimeMs = CAST((julianday(Timestamp) - 2440587.5) * 86400000 AS INTEGER);"
+                        "DROP INDEX IF EXISTS SensorData_Timestamp;"
+                        "COMMIT;", 0, 0, 0) != SQLITE_OK)
+    {
+        sqlite3_exec(db, "ROLLBACK;", 0, 0, 0);
+        return RET_FAILURE;
+    }
+    return RET_OK;
+}
+
+/* Inserts one SensorData row of an export */
+static void exportSample(void *ctx, UINT16 id, UINT16 power, UINT64 epochMs)
+{
+    STORE_EXPORT *exp = (STORE_EXPORT *)ctx;
+
+    sqlite3_bind_int(exp->stmt, 1, id);
+    sqlite3_bind_int(exp->stmt, 2, power);
+    sqlite3_bind_int64(exp->stmt, 3, (sqlite3_int64)epochMs);
+    if(sqlite3_step(exp->stmt) != SQLITE_DONE)
+        exp->errors++;
+    sqlite3_reset(exp->stmt);
+}
+
+/****************************************************************
+* Public Function
+****************************************************************/
+/*************************************************************************
+* @brief        Opens the SQLite database and creates the table if needed.
+*
+* @details      The database is switched to WAL mode, so the connections
+*               of readers never block the writer thread or the reverse.
+*               Samples are keyed by TimeMs, the UTC read time in ms, so
+*               range filters and retention compare integers.
+*
+* @param[in]    path        Database file.
+* @param[out]   db          SQLite database connection.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE
+*                           with the connection closed.
+*************************************************************************/
+ERROR_CODE openStoreDb(const CHAR *path, sqlite3 **db)
+{
+    const CHAR *sql = "CREATE TABLE IF NOT EXISTS SensorData ("
+                      "ID INTEGER PRIMARY KEY AUTOINCREMENT, "
+                      "Device_ID INTEGER, "
+                      "TimeMs INTEGER NOT NULL, "
+                      "Power_Consumption INTEGER);";
+
+    if(sqlite3_open(path, db) != SQLITE_OK)
+    {
+        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(*db));
+        sqlite3_close(*db);
+        *db = NULL;
+        return RET_FAILURE;
+    }
+
+    /* Only a checkpoint may still wait on a reader, give it time instead of SQLITE_BUSY */
+    sqlite3_busy_timeout(*db, DB_BUSY_TIMEOUT_MS);
+    if(sqlite3_exec(*db, "PRAGMA journal_mode=WAL;", 0, 0, 0) != SQLITE_OK ||
+       sqlite3_exec(*db, sql, 0, 0, 0) != SQLITE_OK ||
+       migrateSchema(*db) != RET_OK ||
+       sqlite3_exec(*db, "CREATE INDEX IF NOT EXISTS SensorData_TimeMs ON SensorData (TimeMs);", 0, 0, 0) != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(*db));
+        sqlite3_close(*db);
+        *db = NULL;
+        return RET_FAILURE;
+    }
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Returns the PRAGMA synchronous level of a name.
+*
+* @param[in]    name        OFF, NORMAL, FULL or EXTRA, any case.
+*
+* @return       INT32       Level, or RET_FAILURE if the name is unknown.
+*************************************************************************/
+INT32 storeSyncLevel(const CHAR *name)
+{
+    INT32 level = 0;
+
+    for(level = 0; level < (INT32)(sizeof(syncName) / sizeof(syncName[0])); level++)
+    {
+        if(strcasecmp(name, syncName[level]) == 0)
+            return level;
+    }
+    return RET_FAILURE;
+}
+
+/*************************************************************************
+* @brief        Returns the storage engine of a name.
+*
+* @param[in]    name        native or sqlite, any case.
+*
+* @return       INT32       DB_ENGINE, or RET_FAILURE if the name is unknown.
+*************************************************************************/
+INT32 storeEngine(const CHAR *name)
+{
+    INT32 engine = 0;
+
+    for(engine = 0; engine < (INT32)(sizeof(engineName) / sizeof(engineName[0])); engine++)
+    {
+        if(strcasecmp(name, engineName[engine]) == 0)
+            return engine;
+    }
+    return RET_FAILURE;
+}
+
+/*************************************************************************
+* @brief        Starts the storage stage.
+*
+* @details      Opens the native store, or the SQLite writer connection
+*               with its durability and cache settings, and hands it to
+*               the writer thread.
+*
+* @param[in]    path        SQLite database file.
+* @param[in]    tbl         Sensors, sizes the store ring and the history.
+* @param[in]    cfg         Flush, retention and durability settings.
+*
+* @return       ERROR_CODE  Returns RET_OK if the thread is started,
+*                           otherwise returns RET_FAILURE.
+*************************************************************************/
+ERROR_CODE startStore(const CHAR *path, const SENSOR_TABLE *tbl, const DB_CONFIG *cfg)
+{
+    UINT32 ringSize = (UINT32)tbl->count * RING_SLOTS_PER_SENSOR;
+    CHAR pragma[SIZE_256] = {0};
+
+    /* The ring must hold a full batch while the previous one commits */
+    if(ringSize < (UINT32)cfg->flushSize * 2)
+        ringSize = (UINT32)cfg->flushSize * 2;
+
+    storeBatch = calloc(cfg->flushSize, sizeof(*storeBatch));
+    if(!storeBatch || ringInit(&storeQueue, ringSize) != RET_OK)
+    {
+        fprintf(stderr, "Failed to create the store queue\n");
+        stopStore();
+        return RET_FAILURE;
+    }
+
+    if(cfg->engine == DB_ENGINE_NATIVE)
+    {
+        if(tsOpen(cfg, tbl->count) != RET_OK)
+        {
+            stopStore();
+            return RET_FAILURE;
+        }
+    }
+    else if(cfg->engine == DB_ENGINE_RING)
+    {
+        if(histOpen(cfg, tbl, TRUE) != RET_OK)
+        {
+            stopStore();
+            return RET_FAILURE;
+        }
+    }
+    else if(openStoreDb(path, &storeDb) != RET_OK)
+    {
+        stopStore();
+        return RET_FAILURE;
+    }
+
+    if(storeDb)
+    {
+        snprintf(pragma, sizeof(pragma), "PRAGMA synchronous=%s; PRAGMA cache_size=-%u; PRAGMA wal_autocheckpoint=%u;",
+                 syncName[cfg->synchronous], cfg->cacheKb, cfg->checkpointPages);
+        if(sqlite3_exec(storeDb, pragma, 0, 0, 0) != SQLITE_OK)
+        {
+            fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(storeDb));
+            stopStore();
+            return RET_FAILURE;
+        }
+
+        if(sqlite3_prepare_v2(storeDb, "INSERT INTO SensorData (Device_ID, Power_Consumption, TimeMs) VALUES (?, ?, ?);",
+                              -1, &storeInsert, NULL) != SQLITE_OK ||
+           sqlite3_prepare_v2(storeDb, "DELETE FROM SensorData WHERE ID IN (SELECT ID FROM SensorData "
+                                  "WHERE TimeMs < ?1 ORDER BY TimeMs LIMIT ?2);",
+                              -1, &storePurge, NULL) != SQLITE_OK)
+        {
+            fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(storeDb));
+            stopStore();
+            return RET_FAILURE;
+        }
+    }
+
+    storeCfg = *cfg;
+    storePurgeMs = getMonotonicMs();
+    storeCheckpointMs = storePurgeMs + ((UINT64)cfg->checkpointSec * MS_PER_SEC);
+    storeStop = FALSE;
+    if(pthread_create(&storeThread, NULL, storeLoop, NULL) != 0)
+    {
+        fprintf(stderr, "Failed to start the storage thread\n");
+        stopStore();
+        return RET_FAILURE;
+    }
+    storeStarted = TRUE;
+
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Copies the history of every configured sensor into a
+*               SQLite SensorData table.
+*
+* @details      Reads what the native store or the ring history holds on
+*               disk, so it can run while the main process is storing.
+*
+* @param[in]    path        SQLite database, created if needed.
+* @param[in]    tbl         Sensors to export.
+* @param[in]    cfg         Engine and its location.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE storeExport(const CHAR *path, const SENSOR_TABLE *tbl, const DB_CONFIG *cfg)
+{
+    STORE_EXPORT exp = {0};
+    sqlite3 *db = NULL;
+    UINT32 rows = 0;
+    UINT16 idx = 0;
+
+    if(cfg->engine == DB_ENGINE_SQLITE)
+    {
+        fprintf(stderr, "History is already stored in %s\n", DB_NAME);
+        return RET_FAILURE;
+    }
+
+    if(((cfg->engine == DB_ENGINE_RING) ? histOpen(cfg, tbl, FALSE) : tsOpen(cfg, 0)) != RET_OK)
+        return RET_FAILURE;
+
+    if(openStoreDb(path, &db) != RET_OK ||
+       sqlite3_prepare_v2(db, "INSERT INTO SensorData (Device_ID, Power_Consumption, TimeMs) VALUES (?, ?, ?);",
+                          -1, &exp.stmt, NULL) != SQLITE_OK ||
+       sqlite3_exec(db, "BEGIN;", 0, 0, 0) != SQLITE_OK)
+    {
+        if(db)
+            fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(db));
+        sqlite3_finalize(exp.stmt);
+        sqlite3_close(db);
+        tsClose();
+        histClose();
+        return RET_FAILURE;
+    }
+
+    for(idx = 0; idx < tbl->count; idx++)
+    {
+        if(cfg->engine == DB_ENGINE_RING)
+            rows += histScan(tbl->id[idx], 0, ~0ULL, exportSample, &exp);
+        else
+            rows += tsScan(tbl->id[idx], 0, ~0ULL, exportSample, &exp);
+    }
+    sqlite3_finalize(exp.stmt);
+    tsClose();
+    histClose();
+
+    if(exp.errors || sqlite3_exec(db, "COMMIT;", 0, 0, 0) != SQLITE_OK)
+    {
+        fprintf(stderr, "Export to %s failed: %s\n", path, sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", 0, 0, 0);
+        sqlite3_close(db);
+        return RET_FAILURE;
+    }
+    sqlite3_close(db);
+
+    fprintf(stdout, "Exported %u samples of %u sensors to %s\n", rows, tbl->count, path);
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Stops the storage stage once the ring is drained.
+*
+* @details      The poller must be stopped first, it is the ring producer.
+*
+* @return       void
+*************************************************************************/
+void stopStore(void)
+{
+    if(storeStarted)
+    {
+        storeStop = TRUE;
+        ringWake(&storeQueue);
+        pthread_join(storeThread, NULL);
+        storeStarted = FALSE;
+    }
+    sqlite3_finalize(storeInsert);
+    sqlite3_finalize(storePurge);
+    storeInsert = NULL;
+    storePurge = NULL;
+    if(storeDb)
+        sqlite3_close(storeDb);
+    storeDb = NULL;
+    tsClose();
+    histClose();
+    ringFree(&storeQueue);
+    free(storeBatch);
+    storeBatch = NULL;
+}
+
+/*************************************************************************
+* @brief        Returns the ring feeding the storage stage.
+*
+* @return       RING*       Store ring.
+*************************************************************************/
+RING *storeRing(void)
+{
+    return &storeQueue;
+}
+
+/*************************************************************************
+* @brief        Prints the store queue and row counters.
+*
+* @param[in]    fp          Output stream.
+*
+* @return       void
+*************************************************************************/
+void printStoreStats(FILE *fp)
+{
+    printRingStats(fp, "store", &storeQueue);
+    fprintf(fp, "\trows inserted %u, insert errors %u, commits %u, rows per commit %.1f\n", storeRows, storeErrors,
+                storeCommits, storeCommits ? ((DOUBLE)storeRows / storeCommits) : 0);
+    if(storeCfg.engine == DB_ENGINE_SQLITE)
+        fprintf(fp, "\tcommit latency last %u us, avg %llu us, max %u us, checkpoints %u\n", storeCommitLastUs,
+                    storeCommits ? (storeCommitTotalUs / storeCommits) : 0, storeCommitMaxUs, storeCheckpoints);
+    if(storeCfg.engine != DB_ENGINE_RING)
+        fprintf(fp, "\t%s purged %u in %u retention runs\n", (storeCfg.engine == DB_ENGINE_NATIVE) ? "files" : "rows",
+                    storePurged, storePurgeRuns);
+    if(storeCfg.engine == DB_ENGINE_NATIVE)
+        printTsStats(fp);
+    else if(storeCfg.engine == DB_ENGINE_RING)
+        printHistStats(fp);
+}
+
+/* EOF */
@@ -0,0 +1,703 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		SQLite export moved to store.c
+*
+**************************************************************************************/
+
+/*
+*	Native store, one directory of segment files named <sensor ID>_<UTC s>.ts,
+*	each holding TS_SEGMENT_SEC of one sensor as appended blocks:
+*
+*	TS_BLOCK_HEADER, first sample in the clear
+*	bytes of samples 2..count, bit packed most significant bit first:
+*		time, d = (t - previous t) - previous (t - previous t), the
+*		previous delta starts at 0
+*			'0'						d = 0
+*			'10'   +  7 bits		-63 .. 64
+*			'110'  +  9 bits		-255 .. 256
+*			'1110' + 12 bits		-2047 .. 2048
+*			'1111' + 32 bits		otherwise
+*		power, z = zz(power - previous power)
+*			'0'						z = 0
+*			'10'   +  6 bits		z < 64
+*			'110'  + 11 bits		z < 2048
+*			'111'  + 17 bits		otherwise
+*
+*	A block is written once, when it is full, its segment ends or it has
+*	been open sealSec. A torn last block is cut off when the segment is
+*	opened again.
+*/
+
+/*** Includes ***/
+#include "general.h"
+
+/*** Globals ***/
+static pthread_mutex_t	tsLock = PTHREAD_MUTEX_INITIALIZER;
+static TS_SERIES		*tsSeries;		/* Indexed by sensor table row */
+static UINT16			tsCount;
+static CHAR				*tsPath;
+static UINT64			tsSealMs;
+
+static UINT64			tsSamples;
+static UINT64			tsSealedSamples;
+static UINT32			tsBlocks;
+static UINT64			tsBytes;
+static UINT32			tsErrors;
+static UINT32			tsPurged;
+static UINT64			tsSealTotalUs;
+static UINT32			tsSealMaxUs;
+
+/* Decoder state of one block */
+typedef struct
+{
+    const UINT8	*buf;
+    UINT32		bytes;
+    UINT32		bit;
+}TS_READER;
+
+/****************************************************************
+* Private Function
+****************************************************************/
+/*************************************************************************
+* @brief        Appends bits to the open block.
+*
+* @param[in,out] s          Series.
+* @param[in]    value       Bits, right aligned.
+* @param[in]    n           Number of bits, up to 64.
+*
+* @return       void
+*************************************************************************/
+static void putBits(TS_SERIES *s, UINT64 value, UINT32 n)
+{
+    UINT32 used = 0, take = 0;
+
+    while(n)
+    {
+        used = s->bits & 7;
+        take = (n < 8 - used) ? n : (8 - used);
+        if(!used)
+            s->buf[s->bits >> 3] = 0;
+        s->buf[s->bits >> 3] |= (UINT8)(((value >> (n - take)) & ((1U << take) - 1)) << (8 - used - take));
+        s->bits += take;
+        n -= take;
+    }
+}
+
+/*************************************************************************
+* @brief        Reads bits of a block.
+*
+* @param[in,out] rd         Reader.
+* @param[in]    n           Number of bits, up to 64.
+*
+* @return       UINT64      Bits, right aligned, zeros past the end.
+*************************************************************************/
+static UINT64 getBits(TS_READER *rd, UINT32 n)
+{
+    UINT64 value = 0;
+    UINT32 used = 0, take = 0;
+    UINT8 byte = 0;
+
+    while(n)
+    {
+        used = rd->bit & 7;
+        take = (n < 8 - used) ? n : (8 - used);
+        byte = ((rd->bit >> 3) < rd->bytes) ? rd->buf[rd->bit >> 3] : 0;
+        value = (value << take) | ((byte >> (8 - used - take)) & ((1U << take) - 1));
+        rd->bit += take;
+        n -= take;
+    }
+    return value;
+}
+
+/*************************************************************************
+* @brief        Counts the leading one bits of a prefix, up to max.
+*
+* @param[in,out] rd         Reader.
+* @param[in]    max         Longest prefix.
+*
+* @return       UINT32      Number of ones.
+*************************************************************************/
+static UINT32 getPrefix(TS_READER *rd, UINT32 max)
+{
+    UINT32 ones = 0;
+
+    while(ones < max && getBits(rd, 1))
+        ones++;
+    return ones;
+}
+
+/*************************************************************************
+* @brief        Decodes a block and reports its samples within a range.
+*
+* @param[in]    hdr         Block header.
+* @param[in]    buf         Encoded samples.
+* @param[in]    id          Sensor ID.
+* @param[in]    fromMs      Range start, UTC ms, inclusive.
+* @param[in]    toMs        Range end, UTC ms, inclusive.
+* @param[in]    cb          Called per sample.
+* @param[in]    ctx         Passed to cb.
+*
+* @return       UINT32      Samples reported.
+*************************************************************************/
+static UINT32 decodeBlock(const TS_BLOCK_HEADER *hdr, const UINT8 *buf, UINT16 id, UINT64 fromMs, UINT64 toMs,
+                          TS_SCAN_CB cb, void *ctx)
+{
+    static const UINT8 dodBits[] = {0, 7, 9, 12, 32};
+    static const INT32 dodBias[] = {0, 63, 255, 2047, 0};
+    static const UINT8 valBits[] = {0, 6, 11, 17};
+    TS_READER rd = {.buf = buf, .bytes = hdr->bytes, .bit = 0};
+    UINT64 timeMs = hdr->firstMs, z = 0;
+    INT64 delta = 0, dod = 0;
+    UINT32 i = 0, sel = 0, found = 0;
+    UINT16 power = hdr->firstPower;
+
+    for(i = 0; i < hdr->count; i++)
+    {
+        if(i)
+        {
+            sel = getPrefix(&rd, 4);
+            if(sel == 4)
+                dod = (INT32)(UINT32)getBits(&rd, 32);
+            else
+                dod = sel ? ((INT64)getBits(&rd, dodBits[sel]) - dodBias[sel]) : 0;
+            delta += dod;
+            timeMs += (UINT64)delta;
+
+            sel = getPrefix(&rd, 3);
+            z = sel ? getBits(&rd, valBits[sel]) : 0;
+            power = (UINT16)(power + ((INT64)(z >> 1) ^ -(INT64)(z & 1)));
+        }
+
+        if(timeMs > toMs)
+            break;
+        if(timeMs >= fromMs)
+        {
+            cb(ctx, id, power, timeMs);
+            found++;
+        }
+    }
+    return found;
+}
+
+/*************************************************************************
+* @brief        Builds the file name of a segment.
+*
+* @param[out]   path        Output.
+* @param[in]    size        Size of path.
+* @param[in]    id          Sensor ID.
+* @param[in]    segment     Segment start, UTC s.
+*
+* @return       void
+*************************************************************************/
+static void segmentPath(CHAR *path, UINT32 size, UINT16 id, UINT64 segment)
+{
+    snprintf(path, size, "%s/%u_%llu.ts", tsPath, id, (unsigned long long)segment);
+}
+
+/*************************************************************************
+* @brief        Returns the length of the whole blocks at the start of a
+*               segment file.
+*
+* @param[in]    fd          Segment file.
+*
+* @return       off_t       Offset past the last whole block.
+*************************************************************************/
+static off_t validLength(INT32 fd)
+{
+    TS_BLOCK_HEADER hdr;
+    struct stat st;
+    off_t off = 0;
+
+    if(fstat(fd, &st) != 0)
+        return 0;
+
+    while(pread(fd, &hdr, sizeof(hdr), off) == (ssize_t)sizeof(hdr) && hdr.magic == TS_BLOCK_MAGIC &&
+          hdr.count && off + (off_t)sizeof(hdr) + hdr.bytes <= st.st_size)
+        off += (off_t)sizeof(hdr) + hdr.bytes;
+    return off;
+}
+
+/*************************************************************************
+* @brief        Opens the segment file of the open block for appending.
+*
+* @param[in,out] s          Series.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE openSegment(TS_SERIES *s)
+{
+    CHAR path[SIZE_256] = {0};
+    off_t len = 0;
+
+    if(s->fd >= 0 && s->fdSegment == s->segment)
+        return RET_OK;
+
+    if(s->fd >= 0)
+        close(s->fd);
+    segmentPath(path, sizeof(path), s->id, s->segment);
+    if((s->fd = open(path, O_RDWR | O_CREAT, 0644)) < 0)
+    {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return RET_FAILURE;
+    }
+
+    /* A block torn by a crash would hide every block appended after it */
+    len = validLength(s->fd);
+    if(ftruncate(s->fd, len) != 0 || lseek(s->fd, len, SEEK_SET) < 0)
+    {
+        close(s->fd);
+        s->fd = RET_FAILURE;
+        return RET_FAILURE;
+    }
+    s->fdSegment = s->segment;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Writes the open block to its segment file.
+*
+* @details      One write and one fdatasync per block, so the card sees
+*               a few KiB at a time instead of a page per row.
+*
+* @param[in,out] s          Series.
+*
+* @return       void
+*************************************************************************/
+static void sealBlock(TS_SERIES *s)
+{
+    struct iovec iov[2];
+    UINT64 startUs = getMonotonicUs();
+    UINT32 latencyUs = 0;
+
+    if(!s->hdr.count)
+        return;
+
+    s->hdr.magic = TS_BLOCK_MAGIC;
+    s->hdr.bytes = (UINT16)((s->bits + 7) >> 3);
+    iov[0].iov_base = &s->hdr;
+    iov[0].iov_len = sizeof(s->hdr);
+    iov[1].iov_base = s->buf;
+    iov[1].iov_len = s->hdr.bytes;
+
+    if(openSegment(s) != RET_OK ||
+       writev(s->fd, iov, 2) != (ssize_t)(sizeof(s->hdr) + s->hdr.bytes) || fdatasync(s->fd) != 0)
+    {
+        fprintf(stderr, "Failed to store %u samples of sensor ID %u: %s\n", s->hdr.count, s->id, strerror(errno));
+        tsErrors += s->hdr.count;
+        if(s->fd >= 0)
+        {
+            close(s->fd);
+            s->fd = RET_FAILURE;
+        }
+    }
+    else
+    {
+        tsBlocks++;
+        tsBytes += sizeof(s->hdr) + s->hdr.bytes;
+        tsSealedSamples += s->hdr.count;
+    }
+
+    latencyUs = (UINT32)(getMonotonicUs() - startUs);
+    tsSealTotalUs += latencyUs;
+    if(latencyUs > tsSealMaxUs)
+        tsSealMaxUs = latencyUs;
+    s->hdr.count = 0;
+}
+
+/*************************************************************************
+* @brief        Decodes the blocks of one segment file within a range.
+*
+* @param[in]    id          Sensor ID.
+* @param[in]    segment     Segment start, UTC s.
+* @param[in]    fromMs      Range start.
+* @param[in]    toMs        Range end.
+* @param[in]    cb          Called per sample.
+* @param[in]    ctx         Passed to cb.
+*
+* @return       UINT32      Samples reported.
+*************************************************************************/
+static UINT32 scanSegment(UINT16 id, UINT64 segment, UINT64 fromMs, UINT64 toMs, TS_SCAN_CB cb, void *ctx)
+{
+    CHAR path[SIZE_256] = {0};
+    const TS_BLOCK_HEADER *hdr = NULL;
+    struct stat st;
+    UINT8 *map = NULL;
+    UINT64 off = 0;
+    UINT32 found = 0;
+    INT32 fd = 0;
+
+    segmentPath(path, sizeof(path), id, segment);
+    if((fd = open(path, O_RDONLY)) < 0)
+        return 0;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(*hdr) ||
+       (map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        return 0;
+    }
+    close(fd);
+
+    /* Headers carry the time span, blocks outside the range are skipped undecoded.
+       A clock step back starts a new block, so blocks are not always in order */
+    while(off + sizeof(*hdr) <= (UINT64)st.st_size)
+    {
+        hdr = (const TS_BLOCK_HEADER *)(map + off);
+        if(hdr->magic != TS_BLOCK_MAGIC || !hdr->count || off + sizeof(*hdr) + hdr->bytes > (UINT64)st.st_size)
+            break;
+        if(hdr->firstMs <= toMs && hdr->lastMs >= fromMs)
+            found += decodeBlock(hdr, (const UINT8 *)(hdr + 1), id, fromMs, toMs, cb, ctx);
+        off += sizeof(*hdr) + hdr->bytes;
+    }
+
+    munmap(map, (size_t)st.st_size);
+    return found;
+}
+
+/* qsort order of segment start times */
+static INT32 cmpSegment(const void *a, const void *b)
+{
+    UINT64 x = *(const UINT64 *)a, y = *(const UINT64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+/****************************************************************
+* Public Function
+****************************************************************/
+/*************************************************************************
+* @brief        Opens the native store.
+*
+* @param[in]    cfg         tsPath and sealSec are used.
+* @param[in]    sensorCount Number of series written, 0 to only scan.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE tsOpen(const DB_CONFIG *cfg, UINT16 sensorCount)
+{
+    struct stat st;
+    UINT16 idx = 0;
+
+    if((mkdir(cfg->tsPath, 0755) != 0 && errno != EEXIST) || stat(cfg->tsPath, &st) != 0 || !S_ISDIR(st.st_mode))
+    {
+        fprintf(stderr, "Failed to create %s: %s\n", cfg->tsPath, strerror(errno));
+        return RET_FAILURE;
+    }
+
+    tsPath = strdup(cfg->tsPath);
+    tsSeries = sensorCount ? calloc(sensorCount, sizeof(*tsSeries)) : NULL;
+    if(!tsPath || (sensorCount && !tsSeries))
+    {
+        tsClose();
+        return RET_FAILURE;
+    }
+
+    for(idx = 0; idx < sensorCount; idx++)
+        tsSeries[idx].fd = RET_FAILURE;
+    tsCount = sensorCount;
+    tsSealMs = (UINT64)cfg->sealSec * MS_PER_SEC;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Writes the open blocks and closes the store.
+*
+* @return       void
+*************************************************************************/
+void tsClose(void)
+{
+    UINT16 idx = 0;
+
+    pthread_mutex_lock(&tsLock);
+    for(idx = 0; idx < tsCount; idx++)
+    {
+        sealBlock(&tsSeries[idx]);
+        if(tsSeries[idx].fd >= 0)
+            close(tsSeries[idx].fd);
+    }
+    free(tsSeries);
+    free(tsPath);
+    tsSeries = NULL;
+    tsPath = NULL;
+    tsCount = 0;
+    pthread_mutex_unlock(&tsLock);
+}
+
+/*************************************************************************
+* @brief        Adds a sample to the open block of its sensor.
+*
+* @details      O(1), a few bit operations. The block is written first if
+*               the sample does not fit, starts a new segment or goes back
+*               in time, so every block stays in time order.
+*
+* @param[in]    sample      Sample, idx must be below sensorCount.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE tsAppend(const SAMPLE *sample)
+{
+    TS_SERIES *s = NULL;
+    UINT64 segment = 0, z = 0;
+    INT64 delta = 0, dod = 0;
+
+    if(sample->idx >= tsCount)
+        return RET_FAILURE;
+
+    s = &tsSeries[sample->idx];
+    segment = sample->epochMs / MS_PER_SEC / TS_SEGMENT_SEC * TS_SEGMENT_SEC;
+
+    pthread_mutex_lock(&tsLock);
+    tsSamples++;
+    if(s->hdr.count && (segment != s->segment || sample->epochMs < s->hdr.lastMs || s->hdr.count == 0xFFFF ||
+                        (s->bits >> 3) + TS_SAMPLE_BYTES_MAX > TS_BLOCK_BYTES))
+        sealBlock(s);
+
+    if(!s->hdr.count)
+    {
+        s->id = sample->id;
+        s->segment = segment;
+        s->openMs = sample->timeMs;
+        s->prevDelta = 0;
+        s->prevPower = sample->power;
+        s->bits = 0;
+        s->hdr.firstMs = s->hdr.lastMs = sample->epochMs;
+        s->hdr.firstPower = sample->power;
+        s->hdr.count = 1;
+        pthread_mutex_unlock(&tsLock);
+        return RET_OK;
+    }
+
+    delta = (INT64)(sample->epochMs - s->hdr.lastMs);
+    dod = delta - s->prevDelta;
+    if(dod == 0)
+        putBits(s, 0x0, 1);
+    else if(dod >= -63 && dod <= 64)
+        putBits(s, (0x2ULL << 7) | (UINT64)(dod + 63), 9);
+    else if(dod >= -255 && dod <= 256)
+        putBits(s, (0x6ULL << 9) | (UINT64)(dod + 255), 12);
+    else if(dod >= -2047 && dod <= 2048)
+        putBits(s, (0xEULL << 12) | (UINT64)(dod + 2047), 16);
+    else
+    {
+        putBits(s, 0xF, 4);
+        putBits(s, (UINT32)(INT32)dod, 32);
+    }
+
+    delta = (INT64)sample->power - s->prevPower;
+    z = ((UINT64)delta << 1) ^ (UINT64)(delta >> 63);
+    if(z == 0)
+        putBits(s, 0x0, 1);
+    else if(z < 64)
+        putBits(s, (0x2ULL << 6) | z, 8);
+    else if(z < 2048)
+        putBits(s, (0x6ULL << 11) | z, 14);
+    else
+        putBits(s, (0x7ULL << 17) | z, 20);
+
+    s->prevDelta = (INT64)(sample->epochMs - s->hdr.lastMs);
+    s->prevPower = sample->power;
+    s->hdr.lastMs = sample->epochMs;
+    s->hdr.count++;
+    pthread_mutex_unlock(&tsLock);
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Writes the blocks that have been open for sealSec.
+*
+* @details      Bounds what a crash can lose, also for a sensor whose
+*               reads stopped or stay within its deadband.
+*
+* @param[in]    nowMs       Current monotonic time.
+*
+* @return       void
+*************************************************************************/
+void tsSealExpired(UINT64 nowMs)
+{
+    UINT16 idx = 0;
+
+    pthread_mutex_lock(&tsLock);
+    for(idx = 0; idx < tsCount; idx++)
+    {
+        if(tsSeries[idx].hdr.count && nowMs >= tsSeries[idx].openMs + tsSealMs)
+            sealBlock(&tsSeries[idx]);
+    }
+    pthread_mutex_unlock(&tsLock);
+}
+
+/*************************************************************************
+* @brief        Returns when the oldest open block is due to be written.
+*
+* @return       UINT64      Monotonic time, ~0 if no block is open.
+*************************************************************************/
+UINT64 tsSealDeadline(void)
+{
+    UINT64 deadline = ~0ULL;
+    UINT16 idx = 0;
+
+    pthread_mutex_lock(&tsLock);
+    for(idx = 0; idx < tsCount; idx++)
+    {
+        if(tsSeries[idx].hdr.count && tsSeries[idx].openMs + tsSealMs < deadline)
+            deadline = tsSeries[idx].openMs + tsSealMs;
+    }
+    pthread_mutex_unlock(&tsLock);
+    return deadline;
+}
+
+/*************************************************************************
+* @brief        Deletes the segment files that end before a cutoff.
+*
+* @param[in]    cutoffMs    UTC ms, older samples have expired.
+*
+* @return       UINT32      Number of files deleted.
+*************************************************************************/
+UINT32 tsPurge(UINT64 cutoffMs)
+{
+    CHAR path[SIZE_256] = {0};
+    struct dirent *ent = NULL;
+    unsigned long long segment = 0;
+    UINT32 deleted = 0;
+    UINT16 id = 0;
+    DIR *dir = NULL;
+
+    pthread_mutex_lock(&tsLock);
+    if(tsPath && (dir = opendir(tsPath)) != NULL)
+    {
+        while((ent = readdir(dir)) != NULL)
+        {
+            if(sscanf(ent->d_name, "%hu_%llu.ts", &id, &segment) != 2 ||
+               (segment + TS_SEGMENT_SEC) * MS_PER_SEC > cutoffMs)
+                continue;
+
+            segmentPath(path, sizeof(path), id, segment);
+            if(unlink(path) == 0)
+                deleted++;
+        }
+        closedir(dir);
+    }
+    tsPurged += deleted;
+    pthread_mutex_unlock(&tsLock);
+    return deleted;
+}
+
+/*************************************************************************
+* @brief        Reports the samples of a sensor within a time range, in
+*               time order unless the clock stepped back.
+*
+* @details      Only the segment files overlapping the range are opened,
+*               and in them only the blocks overlapping it are decoded.
+*               The open block is included, so the latest samples are
+*               seen before they are written.
+*
+* @param[in]    id          Sensor ID.
+* @param[in]    fromMs      Range start, UTC ms, inclusive.
+* @param[in]    toMs        Range end, UTC ms, inclusive.
+* @param[in]    cb          Called per sample.
+* @param[in]    ctx         Passed to cb.
+*
+* @return       UINT32      Samples reported.
+*************************************************************************/
+UINT32 tsScan(UINT16 id, UINT64 fromMs, UINT64 toMs, TS_SCAN_CB cb, void *ctx)
+{
+    struct dirent *ent = NULL;
+    unsigned long long segment = 0;
+    UINT64 *list = NULL, *grown = NULL;
+    UINT32 count = 0, cap = 0, i = 0, found = 0;
+    UINT16 fileId = 0, idx = 0;
+    DIR *dir = NULL;
+
+    pthread_mutex_lock(&tsLock);
+    if(tsPath && (dir = opendir(tsPath)) != NULL)
+    {
+        while((ent = readdir(dir)) != NULL)
+        {
+            if(sscanf(ent->d_name, "%hu_%llu.ts", &fileId, &segment) != 2 || fileId != id ||
+               segment * MS_PER_SEC > toMs || (segment + TS_SEGMENT_SEC) * MS_PER_SEC <= fromMs)
+                continue;
+
+            if(count == cap)
+            {
+                cap = cap ? cap * 2 : 32;
+                if((grown = realloc(list, cap * sizeof(*list))) == NULL)
+                    break;
+                list = grown;
+            }
+            list[count++] = segment;
+        }
+        closedir(dir);
+    }
+
+    qsort(list, count, sizeof(*list), cmpSegment);
+    for(i = 0; i < count; i++)
+        found += scanSegment(id, list[i], fromMs, toMs, cb, ctx);
+    free(list);
+
+    for(idx = 0; idx < tsCount; idx++)
+    {
+        if(tsSeries[idx].id == id && tsSeries[idx].hdr.count &&
+           tsSeries[idx].hdr.firstMs <= toMs && tsSeries[idx].hdr.lastMs >= fromMs)
+        {
+            tsSeries[idx].hdr.bytes = (UINT16)((tsSeries[idx].bits + 7) >> 3);
+            found += decodeBlock(&tsSeries[idx].hdr, tsSeries[idx].buf, id, fromMs, toMs, cb, ctx);
+        }
+    }
+    pthread_mutex_unlock(&tsLock);
+    return found;
+}
+
+/*************************************************************************
+* @brief        Returns the size of every segment file.
+*
+* @return       UINT64      Bytes on disk.
+*************************************************************************/
+UINT64 tsDiskBytes(void)
+{
+    struct dirent *ent = NULL;
+    struct stat st;
+    UINT64 total = 0;
+    DIR *dir = NULL;
+
+    pthread_mutex_lock(&tsLock);
+    if(tsPath && (dir = opendir(tsPath)) != NULL)
+    {
+        while((ent = readdir(dir)) != NULL)
+        {
+            if(strstr(ent->d_name, ".ts") && fstatat(dirfd(dir), ent->d_name, &st, 0) == 0)
+                total += (UINT64)st.st_size;
+        }
+        closedir(dir);
+    }
+    pthread_mutex_unlock(&tsLock);
+    return total;
+}
+
+/*************************************************************************
+* @brief        Prints the native store counters.
+*
+* @param[in]    fp          Output stream.
+*
+* @return       void
+*************************************************************************/
+void printTsStats(FILE *fp)
+{
+    pthread_mutex_lock(&tsLock);
+    fprintf(fp, "\tsamples %llu, written %llu in %u blocks, %llu bytes, %.2f bytes/sample, write errors %u\n",
+                (unsigned long long)tsSamples, (unsigned long long)tsSealedSamples, tsBlocks,
+                (unsigned long long)tsBytes, tsSealedSamples ? ((DOUBLE)tsBytes / tsSealedSamples) : 0, tsErrors);
+    fprintf(fp, "\tblock write latency avg %llu us, max %u us, segments purged %u\n",
+                tsBlocks ? (unsigned long long)(tsSealTotalUs / tsBlocks) : 0ULL, tsSealMaxUs, tsPurged);
+    pthread_mutex_unlock(&tsLock);
+}
+
+/* EOF */
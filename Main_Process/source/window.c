@@ -0,0 +1,165 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		Reads within the deadband left out
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include "general.h"
+
+/****************************************************************
+* Public Function
+****************************************************************/
+/*************************************************************************
+* @brief        Creates the per sensor rolling windows.
+*
+* @details      Each sensor gets room for twice the samples it produces in
+*               one publish interval, rounded up to a power of two, so a
+*               late publish still finds every sample not yet sent.
+*
+* @param[out]   win         Windows.
+* @param[in]    tbl         Sensor table, gives the read intervals.
+* @param[in]    publishSec  MQTT publish interval in seconds.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE windowInit(SAMPLE_WINDOW *win, const SENSOR_TABLE *tbl, UINT16 publishSec)
+{
+    UINT16 idx = 0;
+    UINT32 need = 0, cap = 0, total = 0;
+
+    memset(win, 0, sizeof(*win));
+    win->count = tbl->count;
+    win->base = calloc(tbl->count, sizeof(*win->base));
+    win->mask = calloc(tbl->count, sizeof(*win->mask));
+    win->head = calloc(tbl->count, sizeof(*win->head));
+    win->sent = calloc(tbl->count, sizeof(*win->sent));
+    win->delivered = calloc(tbl->count, sizeof(*win->delivered));
+    win->overruns = calloc(tbl->count, sizeof(*win->overruns));
+    if(!win->base || !win->mask || !win->head || !win->sent || !win->delivered || !win->overruns)
+    {
+        windowFree(win);
+        return RET_FAILURE;
+    }
+
+    for(idx = 0; idx < tbl->count; idx++)
+    {
+        need = (UINT32)(((UINT64)publishSec * MS_PER_SEC / tbl->intervalMs[idx]) + 1) * 2;
+        for(cap = WINDOW_MIN_SIZE; cap < need; cap <<= 1)
+            ;
+        win->base[idx] = total;
+        win->mask[idx] = cap - 1;
+        total += cap;
+    }
+
+    win->power = calloc(total, sizeof(*win->power));
+    win->epochMs = calloc(total, sizeof(*win->epochMs));
+    if(!win->power || !win->epochMs)
+    {
+        windowFree(win);
+        return RET_FAILURE;
+    }
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Frees the rolling windows.
+*
+* @param[in,out] win        Windows.
+*
+* @return       void
+*************************************************************************/
+void windowFree(SAMPLE_WINDOW *win)
+{
+    free(win->base);
+    free(win->mask);
+    free(win->head);
+    free(win->sent);
+    free(win->delivered);
+    free(win->overruns);
+    free(win->power);
+    free(win->epochMs);
+    memset(win, 0, sizeof(*win));
+}
+
+/*************************************************************************
+* @brief        Moves samples popped from acquisition into the windows.
+*
+* @details      Reads within the deadband are left out, they are only
+*               aggregated. A sensor whose oldest unsent sample gets
+*               overwritten counts an overrun, its send position moves to
+*               the oldest sample still held.
+*
+* @param[in,out] win        Windows.
+* @param[in]    batch       Samples, in the order they were read.
+* @param[in]    count       Number of samples.
+*
+* @return       UINT32      Number of samples added.
+*************************************************************************/
+UINT32 windowFeed(SAMPLE_WINDOW *win, const SAMPLE *batch, UINT32 count)
+{
+    UINT32 i = 0, total = 0, slot = 0;
+    UINT16 idx = 0;
+
+    for(i = 0; i < count; i++)
+    {
+        if(batch[i].suppressed)
+            continue;
+
+        idx = batch[i].idx;
+        slot = win->base[idx] + (win->head[idx] & win->mask[idx]);
+        win->power[slot] = batch[i].power;
+        win->epochMs[slot] = batch[i].epochMs;
+        win->head[idx]++;
+        total++;
+
+        if(win->head[idx] - win->sent[idx] > win->mask[idx] + 1)
+        {
+            /* Samples never published are not waiting for an acknowledgement */
+            if(win->delivered[idx] == win->sent[idx])
+                win->delivered[idx]++;
+            win->sent[idx] = win->head[idx] - (win->mask[idx] + 1);
+            win->overruns[idx]++;
+        }
+    }
+    return total;
+}
+
+/*************************************************************************
+* @brief        Prints the publish queue and window counters.
+*
+* @param[in]    fp          Output stream.
+* @param[in]    win         Windows.
+* @param[in]    ring        Ring feeding the windows.
+*
+* @return       void
+*************************************************************************/
+void printWindowStats(FILE *fp, const SAMPLE_WINDOW *win, RING *ring)
+{
+    UINT16 idx = 0;
+    UINT32 pending = 0, unacked = 0, overruns = 0;
+
+    for(idx = 0; idx < win->count; idx++)
+    {
+        pending += win->head[idx] - win->sent[idx];
+        unacked += win->sent[idx] - win->delivered[idx];
+        overruns += win->overruns[idx];
+    }
+
+    printRingStats(fp, "publish", ring);
+    fprintf(fp, "\twindow samples unsent %u, not acknowledged %u, overwritten before publish %u\n",
+                pending, unacked, overruns);
+}
+
+/* EOF */
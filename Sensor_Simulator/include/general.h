@@ -11,6 +11,11 @@
 *	Date			Version		Name		Description
 ***************************************************************************************
 *	11/02/2025		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		Concurrent Modbus TCP server
+*	17/10/2026		1.2			Ganesh		Device fleet
+*	17/10/2026		1.3			Ganesh		Seeded per-device generator, one device is a fleet of one
+*	17/10/2026		1.4			Ganesh		Trace replay
+*	17/10/2026		1.5			Ganesh		Latency and fault injection
 *
 **************************************************************************************/
 
@@ -19,10 +24,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include <errno.h>
+#include <math.h>
+#include <fcntl.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <modbus/modbus.h>
 #include "common.h"
 
@@ -40,9 +55,53 @@
 #define FRIDGE_MIN_POWER            300
 #define FRIDGE_MAX_POWER            800
 
-/* Define Modbus register address */
-#define MODBUS_REGISTER_ADDRESS     0
-#define MODBUS_REGISTER_COUNT       1
+/* Define Modbus register map of the simulated meter */
+#define MODBUS_REGISTER_ADDRESS     0   /* Active power, W */
+#define MODBUS_REG_VOLTAGE          1   /* Voltage, 0.1 V */
+#define MODBUS_REG_CURRENT          2   /* Current, 0.01 A */
+#define MODBUS_REG_POWER_FACTOR     3   /* Power factor, 0.001 */
+#define MODBUS_REG_ENERGY_HI        4   /* Energy counter, Wh, high word */
+#define MODBUS_REG_ENERGY_LO        5   /* Energy counter, Wh, low word */
+#define MODBUS_REGISTER_COUNT       6
+
+#define NOMINAL_VOLTAGE_DV          2300
+#define NOMINAL_POWER_FACTOR        950
+
+/* Modbus TCP server */
+#define SIM_TICK_MS                 1000    /* Power is simulated once per tick */
+#define SIM_CLIENTS_DEFAULT         64
+#define SIM_CLIENTS_MAX             65535
+#define SIM_RESERVED_FDS            64      /* Files besides clients and listening sockets */
+#define SIM_LISTENERS_MAX           65535
+#define SIM_LISTEN_BACKLOG          128
+#define SIM_RX_BYTES                (4 * MODBUS_TCP_MAX_ADU_LENGTH)    /* Pipelined requests of one client */
+#define SIM_TX_BYTES                (16 * MODBUS_TCP_MAX_ADU_LENGTH)   /* Replies the client has not read yet */
+#define SIM_EPOLL_EVENTS            64
+#define SIM_LISTEN_FLAG             0x80000000U /* epoll data of a listening socket, or'ed with its index */
+#define SIM_ACCEPT_RETRY_MS         1000    /* Listeners unwatched this long when out of files, unless a client closes */
+/* Device fleet, -f */
+#define FLEET_DEVICES_MAX           65535
+#define FLEET_PROFILES_MAX          255
+#define FLEET_UNITS_MAX             247     /* Modbus unit IDs 1..247 */
+#define FLEET_STEP_MAX              5       /* Largest power change per tick, W */
+
+/* Trace replay, -t */
+#define TRACE_MAGIC                 0x54534D45  /* "EMST" */
+#define TRACE_VERSION               1
+#define TRACE_COLUMNS_MAX           FLEET_DEVICES_MAX
+#define TRACE_TICK_MIN_MS           10      /* Fastest power update when accelerated */
+#define TRACE_SPEED_MAX             100000
+#define TRACE_END                   0xFFFFFFFFFFFFFFFFULL
+
+/* Fault injection, -F and fleet profiles */
+#define SIM_DELAYED_MAX             16      /* Replies of a client waiting for their delay */
+#define SIM_DELAY_MAX_MS            60000
+#define SIM_HEAP_NONE               0xFFFFFFFFU
+#define FAULT_Z_P99                 2.3263  /* Standard normal 99th percentile */
+#define FAULT_SPEC_LEN              256
+
+#define MBAP_HEADER_LEN             7       /* Transaction, protocol, length, unit */
+#define MS_PER_SEC                  1000
 
 /*************************************************************************
 * @brief        Enumeration for the state machine states.
@@ -53,15 +112,15 @@
 typedef enum {
     STATE_INIT,            /**< Initial state */
     STATE_READ_SENSOR,     /**< State for reading sensor data */
-    STATE_SIMULATE_ACCEPT, /**< State for accept the socket */
     STATE_SIMULATE_POWER,  /**< State for simulating power consumption */
     STATE_OUTPUT_POWER,    /**< State for outputting power consumption */
-    STATE_RESPOND_MODBUS,  /**< State for responding to Modbus queries */
+    STATE_RESPOND_MODBUS,  /**< State for serving every client until the next tick */
     STATE_ERROR            /**< Error state */
 } STATE_TYPE;
 
 //for Flags use only
 extern UINT64 flag1;
+extern BOOL debug, modDebug;
 
 #define	POWER_ON				0
 
@@ -79,8 +138,8 @@ extern UINT64 flag1;
 *
 * @details      This structure contains all the necessary data for a simulation instance,
 *               including the state of the state machine, Modbus TCP port, sensor ID,
-*               power consumption range, power value, server socket, and Modbus context
-*               and mapping.
+*               power consumption range, server options and the Modbus context. Power
+*               and energy live in the fleet, a single sensor is a fleet of one.
 *************************************************************************/
 typedef struct
 {
@@ -89,17 +148,266 @@ typedef struct
     UINT16              sensorID;       /**< The ID of the sensor */
     UINT16              minPower;       /**< The minimum power consumption value */
     UINT16              maxPower;       /**< The maximum power consumption value */
-    UINT16              power;          /**< The current power consumption value */
-    INT32               serverSocket;   /**< The server socket for Modbus TCP */
-    modbus_t            *ctx;           /**< The Modbus context */
-    modbus_mapping_t    *mbMapping;     /**< The Modbus mapping */
+    UINT16              maxClients;     /**< Concurrent Modbus TCP clients */
+    UINT16              statsInterval;  /**< Seconds between server statistics, 0 for none */
+    CHAR                *fleetPath;     /**< Fleet file, NULL to simulate one device */
+    UINT16              unitsPerPort;   /**< Fleet devices behind each port */
+    UINT32              seed;           /**< Seed of the power generators */
+    CHAR                *tracePath;     /**< Trace to replay, NULL for generated power */
+    CHAR                *traceOut;      /**< Convert the trace to this binary file and exit */
+    CHAR                *faultSpec;     /**< Fault keys applied to every profile, NULL for none */
+    DOUBLE              traceSpeed;     /**< Trace seconds replayed per second */
+    UINT32              tickMs;         /**< Power update interval */
+    UINT64              nextTickMs;     /**< Next power update */
+    UINT64              nextStatsMs;    /**< Next server statistics */
+    modbus_t            *ctx;           /**< The Modbus context, used to listen */
 } SIM_INSTANCE;
 
 #pragma pack(pop)
 
+/*************************************************************************
+* @brief        Reads registers for a Modbus request.
+*
+* @details      listener is the index of the listening socket the client
+*               connected to. Returns 0 and fills out, or a Modbus
+*               exception code.
+*************************************************************************/
+typedef UINT8 (*SIM_READ_FN)(void *ctx, UINT16 listener, UINT8 unit, UINT16 addr, UINT16 count, UINT16 *out);
+
+/*************************************************************************
+* @brief        What the server does with a request.
+*************************************************************************/
+typedef enum
+{
+    FATE_REPLY,                         /**< Reply after delayMs */
+    FATE_DROP,                          /**< Read the request, never reply */
+    FATE_RESET                          /**< Close the connection with a RST */
+} SIM_FATE;
+
+typedef struct
+{
+    UINT8               fate;           /**< SIM_FATE */
+    UINT8               exception;      /**< Reply this exception instead of reading, 0 for none */
+    UINT32              delayMs;
+} SIM_FAULT;
+
+/*************************************************************************
+* @brief        Decides the fault of a request, same arguments as read.
+*************************************************************************/
+typedef void (*SIM_FAULT_FN)(void *ctx, UINT16 listener, UINT8 unit, SIM_FAULT *fault);
+
+/*************************************************************************
+* @brief        One Modbus TCP connection.
+*
+* @details      Requests are framed out of rx, so a client may pipeline
+*               them. Replies queue in tx while the client is not reading.
+*               A delayed reply stays past txReady until it is due, the
+*               ones after it wait too so replies keep their order.
+*************************************************************************/
+typedef struct
+{
+    INT32               fd;             /**< Socket, RET_FAILURE if the slot is free */
+    UINT16              listener;       /**< Listening socket it was accepted on */
+    UINT16              rxLen;
+    UINT16              txLen;
+    UINT16              txOff;          /**< Bytes of tx already sent */
+    UINT16              txReady;        /**< Bytes of tx that are due */
+    UINT8               delayed;        /**< Replies waiting for their delay */
+    UINT8               delayHead;
+    UINT32              heapPos;        /**< Place in the delay heap, SIM_HEAP_NONE if none waits */
+    UINT16              dueEnd[SIM_DELAYED_MAX];   /**< End in tx of each waiting reply */
+    UINT64              dueMs[SIM_DELAYED_MAX];
+    UINT64              requests;
+    UINT8               rx[SIM_RX_BYTES];
+    UINT8               tx[SIM_TX_BYTES];
+} SIM_CLIENT;
+
+/*************************************************************************
+* @brief        Modbus TCP server, one epoll loop for every client.
+*************************************************************************/
+typedef struct
+{
+    INT32               *listenFd;
+    UINT16              listeners;
+    INT32               epfd;
+    UINT16              maxClients;
+    UINT16              clients;        /**< Connected now */
+    UINT16              peakClients;
+    SIM_CLIENT          *client;        /**< maxClients slots */
+    UINT32              *freeSlot;      /**< Client slots not in use, taken from the end */
+    UINT32              freeCount;
+    BOOL                acceptPaused;   /**< Listeners unwatched, out of files */
+    UINT64              acceptPausedMs;
+    SIM_READ_FN         read;
+    SIM_FAULT_FN        fault;          /**< NULL to reply at once */
+    void                *ctx;           /**< Passed to read and fault */
+    UINT32              *heap;          /**< Client slots by due time of their next delayed reply */
+    UINT32              heapLen;
+    UINT64              accepted;
+    UINT64              rejected;       /**< Refused, every slot was taken */
+    UINT64              acceptPauses;   /**< Times accept ran out of files */
+    UINT64              requests;
+    UINT64              exceptions;
+    UINT64              protocolErrors; /**< Connections closed on a bad frame */
+    UINT64              bytesIn;
+    UINT64              bytesOut;
+    UINT64              delayedReplies;
+    UINT64              delayMsTotal;
+    UINT32              delayMsMax;
+    UINT64              dropped;        /**< Requests never answered */
+    UINT64              resets;
+    UINT64              injected;       /**< Exceptions replied by the fault */
+    UINT64              statsRequests;  /**< requests at the last statistics */
+    UINT64              statsMs;
+} SIM_SERVER;
+
+/*************************************************************************
+* @brief        Header of a binary trace.
+*
+* @details      Followed by rows of `columns` UINT16 powers in host byte
+*               order, row r holds the powers at r * intervalMs.
+*************************************************************************/
+typedef struct
+{
+    UINT32              magic;          /**< TRACE_MAGIC */
+    UINT16              version;
+    UINT16              columns;
+    UINT32              intervalMs;
+    UINT32              rows;
+} TRACE_HEADER;
+
+/*************************************************************************
+* @brief        Recorded load curve replayed through the fleet.
+*
+* @details      The file is mapped and read at a cursor, never loaded.
+*               A CSV line is `seconds,power[,power...]`, each value held
+*               until the next line. Column d % columns drives device d.
+*               The trace loops once its period is over.
+*************************************************************************/
+typedef struct
+{
+    INT32               fd;
+    const CHAR          *map;
+    size_t              size;
+    BOOL                binary;
+    UINT16              columns;
+    UINT32              intervalMs;     /**< Row interval, for a CSV its first spacing */
+    UINT64              periodMs;       /**< Trace time of one pass */
+    DOUBLE              speed;          /**< Trace seconds per second */
+    UINT64              startMs;        /**< Monotonic start of the replay */
+    const UINT16        *value;         /**< Powers at the cursor, columns of them */
+    UINT64              curMs;          /**< Trace time of value */
+    size_t              firstPos;       /**< CSV: first data line */
+    size_t              pos;            /**< CSV: line after the pending row */
+    UINT16              *row;           /**< CSV: current powers */
+    UINT16              *pend;          /**< CSV: powers of the next line */
+    UINT64              pendMs;         /**< CSV: trace time of pend, TRACE_END past the last line */
+    UINT64              firstMs;        /**< CSV: time of the first line */
+    UINT64              loops;
+    UINT64              rowsRead;
+    UINT64              badLines;
+} SIM_TRACE;
+
+typedef enum
+{
+    DELAY_NONE,
+    DELAY_FIXED,                        /**< delayA ms */
+    DELAY_UNIFORM,                      /**< delayA to delayB ms */
+    DELAY_TAIL                          /**< Log-normal, median delayA, 99th percentile delayB */
+} DELAY_TYPE;
+
+/*************************************************************************
+* @brief        Faults of a profile, probabilities scaled to 2^32.
+*************************************************************************/
+typedef struct
+{
+    BOOL                enabled;
+    UINT8               delayType;      /**< DELAY_TYPE */
+    UINT8               exceptionCode;
+    UINT32              delayA;
+    UINT32              delayB;
+    DOUBLE              sigma;          /**< DELAY_TAIL spread */
+    UINT32              dropP;
+    UINT32              exceptionP;
+    UINT32              resetP;
+} FAULT_CONFIG;
+
+/*************************************************************************
+* @brief        Power profile of a [section] of the fleet file.
+*************************************************************************/
+typedef struct
+{
+    CHAR                name[SIZE_32];
+    UINT16              minPower;
+    UINT16              maxPower;
+    UINT32              devices;
+    FAULT_CONFIG        fault;
+} FLEET_PROFILE;
+
+/*************************************************************************
+* @brief        Simulated devices of one process.
+*
+* @details      Device d is served on port firstPort + d / unitsPerPort.
+*               Each device draws its power steps from its own generator.
+*               With one device per port any unit ID is answered,
+*               otherwise unit ID d % unitsPerPort + 1 selects it. Each
+*               column is its own array, about 20 bytes per device, so a
+*               tick walks them in one pass.
+*************************************************************************/
+typedef struct
+{
+    UINT32              count;
+    UINT16              firstPort;
+    UINT16              unitsPerPort;
+    UINT16              ports;
+    UINT16              profiles;
+    FLEET_PROFILE       profile[FLEET_PROFILES_MAX];
+    UINT8               *profileIdx;
+    UINT16              *minPower;
+    UINT16              *maxPower;
+    UINT16              *power;
+    UINT8               *rising;        /**< 1 while power ramps up to maxPower */
+    UINT32              *rng;           /**< xorshift32 state */
+    DOUBLE              *energyWs;      /**< Energy consumed since start, watt seconds */
+    UINT32              seed;
+    UINT32              faultRng;       /**< xorshift32 state of the fault draws */
+    BOOL                faults;         /**< A profile injects delays or faults */
+    UINT64              lastTickMs;
+    UINT64              ticks;
+    UINT64              tickNs;         /**< Time spent in ticks */
+} SIM_FLEET;
+
 /*
 *Function declarations
 */
+/* fleet.c */
+ERROR_CODE fleetLoad(SIM_FLEET *fleet, const CHAR *path);
+ERROR_CODE fleetAddProfile(SIM_FLEET *fleet, const CHAR *name, UINT16 minPower, UINT16 maxPower, UINT32 devices);
+ERROR_CODE fleetStart(SIM_FLEET *fleet, UINT16 firstPort, UINT16 unitsPerPort, UINT32 seed);
+void fleetClose(SIM_FLEET *fleet);
+void fleetTick(SIM_FLEET *fleet, UINT64 nowMs, const SIM_TRACE *trace);
+UINT8 fleetRead(void *ctx, UINT16 listener, UINT8 unit, UINT16 addr, UINT16 count, UINT16 *out);
+ERROR_CODE fleetSetFaults(SIM_FLEET *fleet, const CHAR *spec);
+void fleetFault(void *ctx, UINT16 listener, UINT8 unit, SIM_FAULT *fault);
+void printFleetStats(FILE *fp, const SIM_FLEET *fleet);
+
+/* trace.c */
+ERROR_CODE traceOpen(SIM_TRACE *trace, const CHAR *path, DOUBLE speed);
+void traceClose(SIM_TRACE *trace);
+void traceStart(SIM_TRACE *trace, UINT64 nowMs);
+void traceAdvance(SIM_TRACE *trace, UINT64 nowMs);
+UINT32 traceTickMs(const SIM_TRACE *trace);
+ERROR_CODE traceConvert(SIM_TRACE *trace, const CHAR *path);
+void printTraceStats(FILE *fp, const SIM_TRACE *trace);
+
+/* server.c */
+UINT64 getMonotonicMs(void);
+ERROR_CODE serverOpen(SIM_SERVER *srv, UINT16 maxClients, SIM_READ_FN read, SIM_FAULT_FN fault, void *ctx);
+INT32 serverAddListener(SIM_SERVER *srv, INT32 listenFd);
+INT32 serverListen(SIM_SERVER *srv, UINT16 port, INT32 backlog);
+void serverRun(SIM_SERVER *srv, INT32 timeoutMs);
+void serverClose(SIM_SERVER *srv);
+void printServerStats(FILE *fp, SIM_SERVER *srv);
 
 #endif
 
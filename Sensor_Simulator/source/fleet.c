@@ -0,0 +1,683 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		Seeded per-device xorshift generator
+*	17/10/2026		1.2			Ganesh		Powers from a replayed trace
+*	17/10/2026		1.3			Ganesh		Per profile response delays and faults
+*	17/10/2026		1.4			Ganesh		Fleet file errors fail the load
+*	17/10/2026		1.5			Ganesh		Current register computed in 64 bit
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include "general.h"
+#include "ini.h"
+
+/****************************************************************
+* Private Functions
+****************************************************************/
+/*************************************************************************
+* @brief        Parses a percentage into a probability scaled to 2^32.
+*
+* @param[in]    value       0 to 100.
+* @param[out]   prob        Probability.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE parsePercent(const CHAR *value, UINT32 *prob)
+{
+    CHAR *end = NULL;
+    DOUBLE pct = strtod(value, &end);
+
+    if(end == value || pct < 0 || pct > 100)
+        return RET_FAILURE;
+    *prob = (UINT32)(pct / 100 * 4294967295.0);
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Reads one fault key of a profile.
+*
+* @details      delay = none | fixed <ms> | uniform <min ms> <max ms> |
+*               tail <median ms> <99th percentile ms>, the tail is
+*               log-normal. dropPct, exceptionPct and resetPct are the
+*               share of requests never answered, answered with
+*               exceptionCode, or answered by a connection reset.
+*
+* @param[in,out] fault      Faults of the profile.
+* @param[in]    name        Key.
+* @param[in]    value       Value.
+*
+* @return       ERROR_CODE  RET_FAILURE for an unknown key or a bad value.
+*************************************************************************/
+static ERROR_CODE parseFaultKey(FAULT_CONFIG *fault, const CHAR *name, const CHAR *value)
+{
+    CHAR type[16] = {0};
+    UINT32 a = 0, b = 0, code = 0;
+    INT32 n = 0;
+    ERROR_CODE ret = RET_OK;
+
+    if(strcmp(name, "delay") == 0)
+    {
+        n = sscanf(value, "%15s %u %u", type, &a, &b);
+        if(n >= 1 && strcmp(type, "none") == 0)
+            fault->delayType = DELAY_NONE;
+        else if(n >= 2 && strcmp(type, "fixed") == 0 && a <= SIM_DELAY_MAX_MS)
+            fault->delayType = DELAY_FIXED;
+        else if(n == 3 && strcmp(type, "uniform") == 0 && a <= b && b <= SIM_DELAY_MAX_MS)
+            fault->delayType = DELAY_UNIFORM;
+        else if(n == 3 && strcmp(type, "tail") == 0 && a && a <= b && b <= SIM_DELAY_MAX_MS)
+        {
+            fault->delayType = DELAY_TAIL;
+            fault->sigma = log((DOUBLE)b / a) / FAULT_Z_P99;
+        }
+        else
+            return RET_FAILURE;
+        fault->delayA = a;
+        fault->delayB = b;
+    }
+    else if(strcmp(name, "dropPct") == 0)
+        ret = parsePercent(value, &fault->dropP);
+    else if(strcmp(name, "exceptionPct") == 0)
+        ret = parsePercent(value, &fault->exceptionP);
+    else if(strcmp(name, "resetPct") == 0)
+        ret = parsePercent(value, &fault->resetP);
+    else if(strcmp(name, "exceptionCode") == 0)
+    {
+        code = (UINT32)strtoul(value, NULL, 0);
+        if(code < 1 || code > 0xFF)
+            return RET_FAILURE;
+        fault->exceptionCode = (UINT8)code;
+    }
+    else
+        return RET_FAILURE;
+
+    if(!fault->exceptionCode)
+        fault->exceptionCode = MODBUS_EXCEPTION_SLAVE_OR_SERVER_BUSY;
+    fault->enabled = (fault->delayType != DELAY_NONE || fault->dropP || fault->exceptionP || fault->resetP);
+    return ret;
+}
+
+/*************************************************************************
+* @brief        Parses a decimal number of the fleet file.
+*
+* @param[in]    value       Text of the value.
+* @param[in]    max         Largest value allowed.
+* @param[out]   out         Number.
+*
+* @return       ERROR_CODE  Returns RET_OK if value is a number up to max,
+*                           otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE parseNumber(const CHAR *value, UINT32 max, UINT32 *out)
+{
+    CHAR *end = NULL;
+    unsigned long n = 0;
+
+    if(*value < '0' || *value > '9')
+        return RET_FAILURE;
+    errno = 0;
+    n = strtoul(value, &end, 10);
+    if(errno || *end || n > max)
+        return RET_FAILURE;
+    *out = (UINT32)n;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Reads one key of the fleet file.
+*
+* @details      Every [section] is a power profile, consecutive keys of
+*               the same section fill the same profile. An unknown key or
+*               a bad value fails the whole file, like a bad -F.
+*
+* @param[in]    user        The fleet.
+* @param[in]    section     Section name, the profile name.
+* @param[in]    name        Key.
+* @param[in]    value       Value.
+*
+* @return       int         Non zero to continue, 0 reports a parse error.
+*************************************************************************/
+static int fleetIniHandler(void *user, const char *section, const char *name, const char *value)
+{
+    SIM_FLEET *fleet = (SIM_FLEET *)user;
+    FLEET_PROFILE *prof = fleet->profiles ? &fleet->profile[fleet->profiles - 1] : NULL;
+    UINT32 n = 0;
+
+    if(!prof || strncmp(prof->name, section, sizeof(prof->name) - 1) != 0)
+    {
+        if(fleet->profiles == FLEET_PROFILES_MAX)
+        {
+            fprintf(stderr, "More than %d profiles, [%s] ignored\n", FLEET_PROFILES_MAX, section);
+            return 0;
+        }
+        prof = &fleet->profile[fleet->profiles++];
+        strncpy(prof->name, section, sizeof(prof->name) - 1);
+    }
+
+    if(strcmp(name, "minPower") == 0 || strcmp(name, "maxPower") == 0)
+    {
+        if(parseNumber(value, 0xFFFF, &n) != RET_OK)
+        {
+            fprintf(stderr, "Bad %s = %s in [%s], 0 to 65535 W\n", name, value, section);
+            return 0;
+        }
+        if(strcmp(name, "minPower") == 0)
+            prof->minPower = (UINT16)n;
+        else
+            prof->maxPower = (UINT16)n;
+    }
+    else if(strcmp(name, "devices") == 0)
+    {
+        if(parseNumber(value, FLEET_DEVICES_MAX, &n) != RET_OK)
+        {
+            fprintf(stderr, "Bad devices = %s in [%s], up to %d\n", value, section, FLEET_DEVICES_MAX);
+            return 0;
+        }
+        prof->devices = n;
+    }
+    else if(parseFaultKey(&prof->fault, name, value) != RET_OK)
+    {
+        fprintf(stderr, "Unknown key or bad value %s = %s in [%s]\n", name, value, section);
+        return 0;
+    }
+    return RET_SUCCESS;
+}
+
+/*************************************************************************
+* @brief        Fills the meter register block of one device.
+*
+* @param[out]   regs        MODBUS_REGISTER_COUNT registers.
+* @param[in]    power       Active power, W.
+* @param[in]    energyWs    Energy consumed, watt seconds.
+*
+* @return       None
+*************************************************************************/
+static void fillMeterRegisters(UINT16 *regs, UINT16 power, DOUBLE energyWs)
+{
+    UINT32 energyWh = (UINT32)(energyWs / 3600);
+
+    regs[MODBUS_REGISTER_ADDRESS] = power;
+    regs[MODBUS_REG_VOLTAGE] = NOMINAL_VOLTAGE_DV;
+    /* 64 bit, unsigned long is 32 bit on the Raspberry Pi */
+    regs[MODBUS_REG_CURRENT] = (UINT16)(((UINT64)power * 100000) / ((UINT32)NOMINAL_VOLTAGE_DV * NOMINAL_POWER_FACTOR / 10));
+    regs[MODBUS_REG_POWER_FACTOR] = NOMINAL_POWER_FACTOR;
+    regs[MODBUS_REG_ENERGY_HI] = (UINT16)(energyWh >> 16);
+    regs[MODBUS_REG_ENERGY_LO] = (UINT16)(energyWh & 0xFFFF);
+}
+
+/*************************************************************************
+* @brief        Derives the generator state of a device from the seed.
+*
+* @details      The murmur3 finaliser spreads consecutive devices apart,
+*               xorshift needs a non zero state.
+*
+* @param[in]    seed        Seed of the run.
+* @param[in]    dev         Device index.
+*
+* @return       UINT32      Initial state.
+*************************************************************************/
+static UINT32 seedDevice(UINT32 seed, UINT32 dev)
+{
+    UINT32 x = seed + dev * 0x9E3779B9U;
+
+    x ^= x >> 16;
+    x *= 0x85EBCA6BU;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35U;
+    x ^= x >> 16;
+    return x ? x : 0x6D2B79F5U;
+}
+
+/*************************************************************************
+* @brief        Steps a xorshift32 generator.
+*
+* @param[in,out] x          State, never 0.
+*
+* @return       UINT32      Next value.
+*************************************************************************/
+static UINT32 nextRandom(UINT32 *x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+/*************************************************************************
+* @brief        Finds the device a request is for.
+*
+* @details      Listening sockets are added in port order, so listener is
+*               the port offset from firstPort.
+*
+* @param[in]    fleet       Fleet.
+* @param[in]    listener    Index of the listening socket.
+* @param[in]    unit        Unit ID of the request.
+*
+* @return       UINT32      Device index, fleet->count if there is none.
+*************************************************************************/
+static UINT32 findDevice(const SIM_FLEET *fleet, UINT16 listener, UINT8 unit)
+{
+    UINT32 dev = (UINT32)listener * fleet->unitsPerPort;
+
+    if(fleet->unitsPerPort > 1)
+    {
+        if(unit < 1 || unit > fleet->unitsPerPort)
+            return fleet->count;
+        dev += unit - 1U;
+    }
+    return (dev < fleet->count) ? dev : fleet->count;
+}
+
+/*************************************************************************
+* @brief        Draws a response delay.
+*
+* @param[in]    fault       Faults of the profile.
+* @param[in,out] rng        Generator state.
+*
+* @return       UINT32      Delay, ms.
+*************************************************************************/
+static UINT32 drawDelay(const FAULT_CONFIG *fault, UINT32 *rng)
+{
+    DOUBLE u1 = 0, u2 = 0, ms = 0;
+
+    switch(fault->delayType)
+    {
+        case DELAY_FIXED:
+            return fault->delayA;
+        case DELAY_UNIFORM:
+            return fault->delayA + (UINT32)(((UINT64)nextRandom(rng) * (fault->delayB - fault->delayA + 1)) >> 32);
+        case DELAY_TAIL:
+            /* Box-Muller, u1 is in (0, 1] so the log is finite */
+            u1 = (nextRandom(rng) + 1.0) / 4294967296.0;
+            u2 = nextRandom(rng) / 4294967296.0;
+            ms = fault->delayA * exp(fault->sigma * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2));
+            return (ms < SIM_DELAY_MAX_MS) ? (UINT32)ms : SIM_DELAY_MAX_MS;
+        default:
+            return 0;
+    }
+}
+
+/*************************************************************************
+* @brief        Advances the generator and power of n devices.
+*
+* @details      Each device steps its xorshift32 state, draws a step of
+*               0..FLEET_STEP_MAX W from the high bits and moves towards
+*               the end of its range, turning around there. The body has
+*               no branches or calls so the compiler vectorises it.
+*
+* @param[in]    n           Devices.
+* @param[in,out] rng        Generator states.
+* @param[in,out] power      Power, W.
+* @param[in,out] rising     1 while ramping up.
+* @param[in]    minPower    Lower ends.
+* @param[in]    maxPower    Upper ends.
+*
+* @return       None
+*************************************************************************/
+static void advancePower(UINT32 n, UINT32 *restrict rng, UINT16 *restrict power, UINT8 *restrict rising,
+                         const UINT16 *restrict minPower, const UINT16 *restrict maxPower)
+{
+    UINT32 i = 0, x = 0, step = 0, p = 0, up = 0, rise = 0, fall = 0;
+
+    for(i = 0; i < n; i++)
+    {
+        x = nextRandom(&rng[i]);
+
+        /* Multiply and shift instead of a modulo, same spread */
+        step = ((x >> 16) * (FLEET_STEP_MAX + 1)) >> 16;
+        p = power[i];
+        up = rising[i];
+        rise = (maxPower[i] - p > step) ? p + step : maxPower[i];
+        fall = (p - minPower[i] > step) ? p - step : minPower[i];
+        p = up ? rise : fall;
+        power[i] = (UINT16)p;
+        rising[i] = (UINT8)(up ? (p != maxPower[i]) : (p == minPower[i]));
+    }
+}
+
+/****************************************************************
+* Public Functions
+****************************************************************/
+/*************************************************************************
+* @brief        Reads the power profiles of a fleet file.
+*
+* @details      Each [profile] section adds `devices` devices ramping
+*               between minPower and maxPower, numbered in file order.
+*
+* @param[out]   fleet       Fleet, devices are created by fleetStart.
+* @param[in]    path        Fleet file.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE fleetLoad(SIM_FLEET *fleet, const CHAR *path)
+{
+    memset(fleet, 0, sizeof(*fleet));
+    if(ini_parse(path, fleetIniHandler, fleet) != 0)
+    {
+        fprintf(stderr, "Failed to read fleet file %s\n", path);
+        return RET_FAILURE;
+    }
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Adds a power profile to the fleet.
+*
+* @param[in,out] fleet      Fleet, devices are created by fleetStart.
+* @param[in]    name        Profile name.
+* @param[in]    minPower    Lower end, W.
+* @param[in]    maxPower    Upper end, W.
+* @param[in]    devices     Devices of the profile.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE fleetAddProfile(SIM_FLEET *fleet, const CHAR *name, UINT16 minPower, UINT16 maxPower, UINT32 devices)
+{
+    FLEET_PROFILE *prof = NULL;
+
+    if(fleet->profiles == FLEET_PROFILES_MAX)
+        return RET_FAILURE;
+
+    prof = &fleet->profile[fleet->profiles++];
+    strncpy(prof->name, name, sizeof(prof->name) - 1);
+    prof->minPower = minPower;
+    prof->maxPower = maxPower;
+    prof->devices = devices;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Sets fault keys on every profile.
+*
+* @details      Same keys as the fleet file, keys not given keep the
+*               value of the profile.
+*
+* @param[in,out] fleet      Fleet with its profiles.
+* @param[in]    spec        Comma separated key=value list, e.g.
+*                           "delay=tail 20 500,dropPct=1".
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE fleetSetFaults(SIM_FLEET *fleet, const CHAR *spec)
+{
+    CHAR buf[FAULT_SPEC_LEN] = {0};
+    CHAR *save = NULL, *key = NULL, *value = NULL;
+    UINT16 p = 0;
+
+    strncpy(buf, spec, sizeof(buf) - 1);
+    for(key = strtok_r(buf, ",", &save); key; key = strtok_r(NULL, ",", &save))
+    {
+        while(*key == ' ')
+            key++;
+        value = strchr(key, '=');
+        if(!value)
+        {
+            fprintf(stderr, "Fault %s is not key=value\n", key);
+            return RET_FAILURE;
+        }
+        *value++ = '\0';
+        for(p = 0; p < fleet->profiles; p++)
+        {
+            if(parseFaultKey(&fleet->profile[p].fault, key, value) != RET_OK)
+            {
+                fprintf(stderr, "Unknown fault key or bad value %s = %s\n", key, value);
+                return RET_FAILURE;
+            }
+        }
+    }
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Creates the devices of every profile.
+*
+* @details      Each device gets its own generator derived from the seed,
+*               which also picks its starting power and direction, so a
+*               run with the same seed produces the same readings.
+*
+* @param[in,out] fleet      Fleet with its profiles.
+* @param[in]    firstPort   Port of the first device.
+* @param[in]    unitsPerPort Devices behind each port, 1 to FLEET_UNITS_MAX.
+* @param[in]    seed        Seed of the run.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE fleetStart(SIM_FLEET *fleet, UINT16 firstPort, UINT16 unitsPerPort, UINT32 seed)
+{
+    UINT32 total = 0, dev = 0, i = 0, x = 0;
+    UINT16 p = 0;
+    FLEET_PROFILE *prof = NULL;
+
+    for(p = 0; p < fleet->profiles; p++)
+    {
+        prof = &fleet->profile[p];
+        if(!prof->devices || prof->minPower > prof->maxPower)
+        {
+            fprintf(stderr, "Profile [%s] needs devices > 0 and minPower <= maxPower\n", prof->name);
+            return RET_FAILURE;
+        }
+        total += prof->devices;
+        if(total > FLEET_DEVICES_MAX)
+        {
+            fprintf(stderr, "More than %d devices\n", FLEET_DEVICES_MAX);
+            return RET_FAILURE;
+        }
+    }
+    if(!total)
+    {
+        fprintf(stderr, "No devices to simulate\n");
+        return RET_FAILURE;
+    }
+
+    fleet->count = total;
+    fleet->firstPort = firstPort;
+    fleet->unitsPerPort = unitsPerPort;
+    fleet->seed = seed;
+    fleet->ports = (UINT16)((total + unitsPerPort - 1) / unitsPerPort);
+    if((UINT32)firstPort + fleet->ports - 1 > 0xFFFF)
+    {
+        fprintf(stderr, "%u ports from %u do not fit, raise the devices per port\n", fleet->ports, firstPort);
+        return RET_FAILURE;
+    }
+
+    fleet->profileIdx = malloc(total * sizeof(*fleet->profileIdx));
+    fleet->minPower = malloc(total * sizeof(*fleet->minPower));
+    fleet->maxPower = malloc(total * sizeof(*fleet->maxPower));
+    fleet->power = malloc(total * sizeof(*fleet->power));
+    fleet->rising = malloc(total * sizeof(*fleet->rising));
+    fleet->rng = malloc(total * sizeof(*fleet->rng));
+    fleet->energyWs = calloc(total, sizeof(*fleet->energyWs));
+    if(!fleet->profileIdx || !fleet->minPower || !fleet->maxPower || !fleet->power || !fleet->rising ||
+       !fleet->rng || !fleet->energyWs)
+    {
+        fprintf(stderr, "Failed to allocate %u devices\n", total);
+        fleetClose(fleet);
+        return RET_FAILURE;
+    }
+
+    for(p = 0; p < fleet->profiles; p++)
+    {
+        prof = &fleet->profile[p];
+        for(i = 0; i < prof->devices; i++, dev++)
+        {
+            x = seedDevice(seed, dev);
+            fleet->rng[dev] = x;
+            fleet->profileIdx[dev] = (UINT8)p;
+            fleet->minPower[dev] = prof->minPower;
+            fleet->maxPower[dev] = prof->maxPower;
+            fleet->power[dev] = (UINT16)(prof->minPower + (x >> 16) % ((UINT32)prof->maxPower - prof->minPower + 1));
+            fleet->rising[dev] = (UINT8)(x & 1);
+        }
+        fleet->faults |= prof->fault.enabled;
+    }
+    fleet->faultRng = seedDevice(seed, FLEET_DEVICES_MAX);
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Frees the device columns.
+*
+* @param[in,out] fleet      Fleet.
+*
+* @return       None
+*************************************************************************/
+void fleetClose(SIM_FLEET *fleet)
+{
+    free(fleet->profileIdx);
+    free(fleet->minPower);
+    free(fleet->maxPower);
+    free(fleet->power);
+    free(fleet->rising);
+    free(fleet->rng);
+    free(fleet->energyWs);
+    memset(fleet, 0, sizeof(*fleet));
+}
+
+/*************************************************************************
+* @brief        Advances every device by one tick.
+*
+* @details      Energy is integrated at the power of the tick that ends,
+*               in trace time when replaying. Then every power takes its
+*               random step, or the trace value of its column.
+*
+* @param[in,out] fleet      Fleet.
+* @param[in]    nowMs       Monotonic time.
+* @param[in]    trace       Trace at nowMs, NULL for generated power.
+*
+* @return       None
+*************************************************************************/
+void fleetTick(SIM_FLEET *fleet, UINT64 nowMs, const SIM_TRACE *trace)
+{
+    struct timespec t0, t1;
+    DOUBLE elapsed = fleet->lastTickMs ? (DOUBLE)(nowMs - fleet->lastTickMs) / MS_PER_SEC : 0;
+    UINT32 dev = 0, col = 0;
+
+    if(trace)
+        elapsed *= trace->speed;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(dev = 0; dev < fleet->count; dev++)
+        fleet->energyWs[dev] += elapsed * fleet->power[dev];
+    if(!trace)
+        advancePower(fleet->count, fleet->rng, fleet->power, fleet->rising, fleet->minPower, fleet->maxPower);
+    else
+    {
+        /* Column d % columns drives device d */
+        for(dev = 0, col = 0; dev < fleet->count; dev++)
+        {
+            fleet->power[dev] = trace->value[col];
+            if(++col == trace->columns)
+                col = 0;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    fleet->lastTickMs = nowMs;
+    fleet->ticks++;
+    fleet->tickNs += (UINT64)((t1.tv_sec - t0.tv_sec) * 1000000000LL + (t1.tv_nsec - t0.tv_nsec));
+}
+
+/*************************************************************************
+* @brief        Reads the meter registers of the device a request is for.
+*
+* @param[in]    ctx         The fleet.
+* @param[in]    listener    Index of the listening socket.
+* @param[in]    unit        Unit ID of the request.
+* @param[in]    addr        First register.
+* @param[in]    count       Number of registers.
+* @param[out]   out         Register values.
+*
+* @return       UINT8       0, MODBUS_EXCEPTION_GATEWAY_TARGET for a unit ID
+*                           without a device, or
+*                           MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS outside the map.
+*************************************************************************/
+UINT8 fleetRead(void *ctx, UINT16 listener, UINT8 unit, UINT16 addr, UINT16 count, UINT16 *out)
+{
+    SIM_FLEET *fleet = ctx;
+    UINT16 regs[MODBUS_REGISTER_COUNT];
+    UINT32 dev = findDevice(fleet, listener, unit);
+
+    if(dev == fleet->count)
+        return MODBUS_EXCEPTION_GATEWAY_TARGET;
+    if((UINT32)addr + count > MODBUS_REGISTER_COUNT)
+        return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+    fillMeterRegisters(regs, fleet->power[dev], fleet->energyWs[dev]);
+    memcpy(out, &regs[addr], count * sizeof(*out));
+    return 0;
+}
+
+/*************************************************************************
+* @brief        Decides the delay or fault of a request from the profile
+*               of its device.
+*
+* @details      A reset wins over a drop, a drop over an exception. The
+*               draws share one generator seeded from the run seed.
+*
+* @param[in]    ctx         The fleet.
+* @param[in]    listener    Index of the listening socket.
+* @param[in]    unit        Unit ID of the request.
+* @param[out]   fault       What the server does with the request.
+*
+* @return       None
+*************************************************************************/
+void fleetFault(void *ctx, UINT16 listener, UINT8 unit, SIM_FAULT *fault)
+{
+    SIM_FLEET *fleet = ctx;
+    const FAULT_CONFIG *cfg = NULL;
+    UINT32 dev = findDevice(fleet, listener, unit);
+
+    fault->fate = FATE_REPLY;
+    fault->exception = 0;
+    fault->delayMs = 0;
+    if(dev == fleet->count || !(cfg = &fleet->profile[fleet->profileIdx[dev]].fault)->enabled)
+        return;
+
+    if(cfg->resetP && nextRandom(&fleet->faultRng) <= cfg->resetP)
+        fault->fate = FATE_RESET;
+    else if(cfg->dropP && nextRandom(&fleet->faultRng) <= cfg->dropP)
+        fault->fate = FATE_DROP;
+    else
+    {
+        if(cfg->exceptionP && nextRandom(&fleet->faultRng) <= cfg->exceptionP)
+            fault->exception = cfg->exceptionCode;
+        fault->delayMs = drawDelay(cfg, &fleet->faultRng);
+    }
+}
+
+/*************************************************************************
+* @brief        Prints the devices and total power of each profile, and
+*               the cost of a tick.
+*
+* @param[in]    fp          Output stream.
+* @param[in]    fleet       Fleet.
+*
+* @return       None
+*************************************************************************/
+void printFleetStats(FILE *fp, const SIM_FLEET *fleet)
+{
+    UINT64 total[FLEET_PROFILES_MAX] = {0};
+    UINT32 dev = 0;
+    UINT16 p = 0;
+
+    for(dev = 0; dev < fleet->count; dev++)
+        total[fleet->profileIdx[dev]] += fleet->power[dev];
+
+    fprintf(fp, "Fleet : %u devices on ports %u-%u, %u per port, seed %u, tick avg %.1f us\n",
+                fleet->count, fleet->firstPort, fleet->firstPort + fleet->ports - 1, fleet->unitsPerPort, fleet->seed,
+                fleet->ticks ? (DOUBLE)fleet->tickNs / fleet->ticks / 1000 : 0);
+    for(p = 0; p < fleet->profiles; p++)
+        fprintf(fp, "\t[%s] %u devices, %llu W\n", fleet->profile[p].name, fleet->profile[p].devices, total[p]);
+}
+
+/* EOF */
@@ -11,6 +11,11 @@
 *	Date			Version		Name		Description
 ***************************************************************************************
 *	11/02/2025		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		Serve concurrent clients, power updated once per tick
+*	17/10/2026		1.2			Ganesh		Device fleet from a file
+*	17/10/2026		1.3			Ganesh		Seeded per-device generator, one sensor is a fleet of one
+*	17/10/2026		1.4			Ganesh		Trace replay
+*	17/10/2026		1.5			Ganesh		Response delays and faults
 *
 **************************************************************************************/
 
@@ -24,6 +29,9 @@ UINT64	flag1;
 BOOL	debug,modDebug;
 
 SIM_INSTANCE	simInst;
+static SIM_SERVER	simServer;
+static SIM_FLEET	simFleet;
+static SIM_TRACE	simTrace;
 
 /****************************************************************
 * Private Functions
@@ -46,7 +54,18 @@ static void printUsage(void)
     fprintf(stdout,"  -s <sensorID>    Sensor ID (1 for Fan, 2 for AC, 3 for Fridge)\n");
     fprintf(stdout,"  -m <minPower>    Minimum power consumption,Should be positive value\n");
     fprintf(stdout,"  -M <maxPower>    Maximum power consumption,Should be positive value\n");
-    fprintf(stdout,"  -p <modbusPort>  Modbus TCP port\n");
+    fprintf(stdout,"  -p <modbusPort>  Modbus TCP port, first port of a fleet\n");
+    fprintf(stdout,"  -f <fleet file>  Simulate the devices of the file instead of -s, -m, -M\n");
+    fprintf(stdout,"  -u <devices>     Fleet devices per port, selected by unit ID 1..n (default 1, max %d)\n", FLEET_UNITS_MAX);
+    fprintf(stdout,"  -t <trace>       Replay powers from a CSV (seconds,power[,power...]) or binary trace\n");
+    fprintf(stdout,"  -a <factor>      Trace seconds replayed per second (default 1, e.g. 60)\n");
+    fprintf(stdout,"  -w <file>        Convert the CSV trace of -t to a binary trace and exit\n");
+    fprintf(stdout,"  -F <faults>      Delays and faults of every profile, e.g. \"delay=tail 20 500,dropPct=1\"\n");
+    fprintf(stdout,"                   delay=none|fixed ms|uniform min max|tail median p99, dropPct, exceptionPct,\n");
+    fprintf(stdout,"                   exceptionCode (default 6), resetPct\n");
+    fprintf(stdout,"  -S <seed>        Seed of the power generators, the same seed repeats a run\n");
+    fprintf(stdout,"  -c <clients>     Concurrent Modbus TCP clients (default %d, max %d)\n", SIM_CLIENTS_DEFAULT, SIM_CLIENTS_MAX);
+    fprintf(stdout,"  -r <seconds>     Print client and request statistics every interval\n");
     fprintf(stdout,"  -d		   Enable debug\n");
     fprintf(stdout,"  -h, --help       Show this help message and exit\n");
 }
@@ -56,7 +75,8 @@ static void printUsage(void)
 *
 * @details      This function reads and parses the command line arguments provided
 *               to the sensor simulator program. It extracts the sensor ID, minimum
-*               power, maximum power, and Modbus TCP port from the arguments.
+*               power, maximum power, Modbus TCP port, client limit, statistics
+*               interval and the fleet, trace, fault and generator options.
 *
 * @param[in]    argc        The number of command line arguments.
 * @param[in]    argv        The array of command line arguments.
@@ -70,9 +90,9 @@ static void printUsage(void)
 *************************************************************************/
 static ERROR_CODE readArguments(INT32 argc, CHAR *argv[], UINT16 *sensorID, UINT16 *minPower, UINT16 *maxPower, UINT16 *modbusPort)
 {
-    INT32 opt=0;
+    INT32 opt=0,clients=SIM_CLIENTS_DEFAULT;
 
-	while ((opt = getopt(argc, argv, "s:m:M:p:h:d")) != RET_FAILURE)
+	while ((opt = getopt(argc, argv, "s:m:M:p:f:u:t:a:w:F:S:c:r:h:d")) != RET_FAILURE)
     {
         switch (opt)
         {
@@ -88,6 +108,33 @@ static ERROR_CODE readArguments(INT32 argc, CHAR *argv[], UINT16 *sensorID, UINT
             case 'p':
                 *modbusPort = (UINT16)atoi(optarg);
             break;
+            case 'f':
+                simInst.fleetPath = optarg;
+            break;
+            case 'u':
+                simInst.unitsPerPort = (UINT16)atoi(optarg);
+            break;
+            case 't':
+                simInst.tracePath = optarg;
+            break;
+            case 'a':
+                simInst.traceSpeed = atof(optarg);
+            break;
+            case 'w':
+                simInst.traceOut = optarg;
+            break;
+            case 'F':
+                simInst.faultSpec = optarg;
+            break;
+            case 'S':
+                simInst.seed = (UINT32)strtoul(optarg, NULL, 0);
+            break;
+            case 'c':
+                clients = atoi(optarg);
+            break;
+            case 'r':
+                simInst.statsInterval = (UINT16)atoi(optarg);
+            break;
             case 'd':
 				modDebug = debug = TRUE;
             break;
@@ -102,54 +149,29 @@ static ERROR_CODE readArguments(INT32 argc, CHAR *argv[], UINT16 *sensorID, UINT
         }
     }
 
-    if ((*sensorID < 0 && *sensorID > MAX_SENS_SIMULATOR) || (*minPower > *maxPower) || (*modbusPort == 0))
+    /* Converting a trace needs nothing else */
+    if (simInst.traceOut)
+    {
+        if (simInst.tracePath)
+            return RET_OK;
+        fprintf(stderr, "-w needs the CSV trace given by -t\n");
+        return RET_FAILURE;
+    }
+
+    if ((!simInst.fleetPath && ((*sensorID < 1) || (*sensorID > MAX_SENS_SIMULATOR) || (*minPower > *maxPower))) ||
+        (*modbusPort == 0) || (clients < 1) || (clients > SIM_CLIENTS_MAX) ||
+        (simInst.unitsPerPort == 0) || (simInst.unitsPerPort > FLEET_UNITS_MAX) ||
+        !(simInst.traceSpeed > 0) || (simInst.traceSpeed > TRACE_SPEED_MAX))
 	{
 		fprintf(stderr, "Invalid inputs\n");
 		printUsage();
         return RET_FAILURE;
 	}
 
+    simInst.maxClients = (UINT16)clients;
     return RET_OK;
 }
 
-/*************************************************************************
-* @brief        Simulates power consumption within a specified range.
-*
-* @details      This function generates a gradual power consumption value within
-*               the specified minimum and maximum power range.
-*
-* @param[in]    minPower    The minimum power consumption value.
-* @param[in]    maxPower    The maximum power consumption value.
-*
-* @return       UINT16      Returns a gradual power consumption value within the specified range.
-*************************************************************************/
-static UINT16 simulatePowerConsumption(UINT16 minPower, UINT16 maxPower)
-{
-    static UINT16 currentPower = 0;
-    static BOOL increasing = TRUE;
-	UINT16 num = 0;
-
-    if (currentPower == maxPower) {
-        currentPower = minPower;
-    }
-
-	srand((UINT32)time(NULL) ^ getpid());
-	num = (UINT16)(rand() % 6);
-    if (increasing) {
-        currentPower += num;
-        if (currentPower >= maxPower) {
-            increasing = FALSE;
-        }
-    } else {
-        currentPower -= num;
-        if (currentPower <= minPower) {
-            increasing = TRUE;
-        }
-    }
-
-    return currentPower;
-}
-
 /*************************************************************************
 * @brief        Outputs the power consumption for a given sensor.
 *
@@ -184,21 +206,46 @@ static void outputPowerConsumption(UINT16 sensorID, UINT16 power)
 ****************************************************************/
 INT32 main(INT32 argc, CHAR **argv, CHAR **envp)
 {
-	struct sockaddr_in clientAddr;
-	socklen_t addrLen = 0;
-	CHAR clientIp[INET_ADDRSTRLEN]={0};
-    INT32 rc=0,clientSocket=0;
+	INT32 listenSocket=0,timeoutMs=0;
+	UINT64 nowMs=0,wakeMs=0;
+	UINT16 port=0;
 	const CHAR *sensorName[MAX_SENS_SIMULATOR] = {"Fan","Air Conditioner","Refrigerator"};
 
+	simInst.unitsPerPort = 1;
+	simInst.seed = (UINT32)time(NULL) ^ (UINT32)getpid();
+	simInst.traceSpeed = 1;
+	simInst.tickMs = SIM_TICK_MS;
     if(readArguments(argc, argv, &simInst.sensorID, &simInst.minPower, &simInst.maxPower, &simInst.modbusPort) != RET_OK)
 	{
         return RET_FAILURE;
 	}
 
-	if(DEBUG_LOG)
+	if (simInst.tracePath)
+	{
+		if (traceOpen(&simTrace, simInst.tracePath, simInst.traceSpeed) != RET_OK)
+			return RET_FAILURE;
+
+		if (simInst.traceOut)
+		{
+			if (traceConvert(&simTrace, simInst.traceOut) != RET_OK)
+			{
+				traceClose(&simTrace);
+				return RET_FAILURE;
+			}
+			traceClose(&simTrace);
+			return RET_OK;
+		}
+
+		/* One trace row per power update */
+		simInst.tickMs = traceTickMs(&simTrace);
+		if(DEBUG_LOG)
+			printTraceStats(stdout, &simTrace);
+	}
+
+	if(DEBUG_LOG && !simInst.fleetPath)
 	{
 		fprintf(stdout,"\n<< EMS - Sensor Simulator (%s) v%s >>\n\n",sensorName[simInst.sensorID-1],APP_VERSION);
-		fprintf(stdout,"Sensor ID :%d\n\tRange of power %d to %d watts\n\tModbus Port : %d\n",simInst.sensorID, simInst.minPower, simInst.maxPower, simInst.modbusPort);
+		fprintf(stdout,"Sensor ID :%d\n\tRange of power %d to %d watts\n\tModbus Port : %d, up to %d clients\n\tSeed : %u\n",simInst.sensorID, simInst.minPower, simInst.maxPower, simInst.modbusPort, simInst.maxClients, simInst.seed);
 	}
 
 	while (simInst.state != STATE_ERROR)
@@ -207,101 +254,134 @@ INT32 main(INT32 argc, CHAR **argv, CHAR **envp)
         {
             case STATE_INIT:
 			{
-				simInst.ctx = modbus_new_tcp("0.0.0.0", simInst.modbusPort);
-				if (simInst.ctx == NULL)
+				/* A single sensor is a fleet of one device on its own port */
+				if (simInst.fleetPath)
 				{
-					fprintf(stderr, "Unable to allocate libmodbus context\n");
-					return RET_FAILURE;
+					if (fleetLoad(&simFleet, simInst.fleetPath) != RET_OK)
+						return RET_FAILURE;
+				}
+				else
+				{
+					simInst.unitsPerPort = 1;
+					fleetAddProfile(&simFleet, sensorName[simInst.sensorID-1], simInst.minPower, simInst.maxPower, 1);
 				}
 
-				simInst.mbMapping = modbus_mapping_new(0, 0, MODBUS_REGISTER_COUNT, 0);
-				if (simInst.mbMapping == NULL)
+				if (simInst.faultSpec && fleetSetFaults(&simFleet, simInst.faultSpec) != RET_OK)
 				{
-					fprintf(stderr, "Failed to allocate the mapping: %s\n", modbus_strerror(errno));
-					modbus_close(simInst.ctx);
-					modbus_free(simInst.ctx);
+					traceClose(&simTrace);
 					return RET_FAILURE;
 				}
 
-				simInst.serverSocket = modbus_tcp_listen(simInst.ctx, 1);
-				if (simInst.serverSocket == RET_FAILURE)
+				if (fleetStart(&simFleet, simInst.modbusPort, simInst.unitsPerPort, simInst.seed) != RET_OK)
 				{
-					fprintf(stderr, "Unable to listen TCP connection: %s\n", modbus_strerror(errno));
-					modbus_mapping_free(simInst.mbMapping);
-					modbus_close(simInst.ctx);
-					modbus_free(simInst.ctx);
+					fleetClose(&simFleet);
+					traceClose(&simTrace);
 					return RET_FAILURE;
 				}
-                simInst.state = STATE_SIMULATE_ACCEPT;
-			}
-            break;
-            case STATE_SIMULATE_ACCEPT:
-			{
-                if(DEBUG_LOG)
-					fprintf(stdout,"Waiting for server request from Main Process..\n");
 
-				clientSocket = modbus_tcp_accept(simInst.ctx, &simInst.serverSocket);
-				if(clientSocket == RET_FAILURE)
+				/* Requests are framed and answered by the server, faults only cost when a profile has them */
+				if (serverOpen(&simServer, simInst.maxClients, fleetRead, simFleet.faults ? fleetFault : NULL, &simFleet) != RET_OK)
 				{
-					fprintf(stderr,"Failed accept request from Main Process..\n");
-					break;
+					fleetClose(&simFleet);
+					return RET_FAILURE;
 				}
-				else
+
+				if (simInst.fleetPath)
 				{
-					if(DEBUG_LOG)
+					/* One listening socket per port, in port order */
+					for (port = 0; port < simFleet.ports; port++)
 					{
-						fprintf(stdout,"Accepted request from Main Process..\n");
-
-						// Get the IP address of the client
-						addrLen = sizeof(clientAddr);
-						if (getpeername(clientSocket, (struct sockaddr *)&clientAddr, &addrLen) == RET_FAILURE)
+						if (serverListen(&simServer, (UINT16)(simInst.modbusPort + port), SIM_LISTEN_BACKLOG) == RET_FAILURE)
 						{
-							perror("Get Peer Name of MP");
-							break;
+							serverClose(&simServer);
+							fleetClose(&simFleet);
+							return RET_FAILURE;
 						}
+					}
 
-						inet_ntop(AF_INET, &clientAddr.sin_addr, clientIp, INET_ADDRSTRLEN);
-						fprintf(stdout,"Client connected from IP: %s\n", clientIp);
+					if(DEBUG_LOG)
+					{
+						fprintf(stdout,"\n<< EMS - Sensor Simulator (fleet) v%s >>\n\n",APP_VERSION);
+						printFleetStats(stdout, &simFleet);
+					}
+				}
+				else
+				{
+					simInst.ctx = modbus_new_tcp("0.0.0.0", simInst.modbusPort);
+					if (simInst.ctx == NULL)
+					{
+						fprintf(stderr, "Unable to allocate libmodbus context\n");
+						serverClose(&simServer);
+						fleetClose(&simFleet);
+						return RET_FAILURE;
+					}
+
+					listenSocket = modbus_tcp_listen(simInst.ctx, SIM_LISTEN_BACKLOG);
+					if (listenSocket == RET_FAILURE || serverAddListener(&simServer, listenSocket) == RET_FAILURE)
+					{
+						fprintf(stderr, "Unable to listen TCP connection: %s\n", modbus_strerror(errno));
+						serverClose(&simServer);
+						fleetClose(&simFleet);
+						modbus_close(simInst.ctx);
+						modbus_free(simInst.ctx);
+						return RET_FAILURE;
 					}
 				}
-				// Enable debug mode for the Modbus context
-				if(MODBUS_DEBUG)
-					modbus_set_debug(simInst.ctx, TRUE);
 
+				if(DEBUG_LOG)
+					fprintf(stdout,"Waiting for server requests..\n");
+
+				simInst.nextTickMs = getMonotonicMs();
+				if (simInst.tracePath)
+					traceStart(&simTrace, simInst.nextTickMs);
+				simInst.nextStatsMs = simInst.nextTickMs + (UINT64)simInst.statsInterval * MS_PER_SEC;
                 simInst.state = STATE_SIMULATE_POWER;
 			}
-			break;
+            break;
             case STATE_SIMULATE_POWER:
 			{
-                simInst.power = simulatePowerConsumption(simInst.minPower, simInst.maxPower);
+				if (simInst.tracePath)
+					traceAdvance(&simTrace, simInst.nextTickMs);
+				fleetTick(&simFleet, simInst.nextTickMs, simInst.tracePath ? &simTrace : NULL);
+				simInst.nextTickMs += simInst.tickMs;
                 simInst.state = STATE_OUTPUT_POWER;
 			}
             break;
             case STATE_OUTPUT_POWER:
 			{
-				if(DEBUG_LOG)
-					outputPowerConsumption(simInst.sensorID, simInst.power);
+				if(DEBUG_LOG && !simInst.fleetPath)
+					outputPowerConsumption(simInst.sensorID, simFleet.power[0]);
 
                 simInst.state = STATE_RESPOND_MODBUS;
 			}
             break;
 			case STATE_RESPOND_MODBUS:
 			{
-				rc = modbus_receive(simInst.ctx, (UINT8 *)simInst.mbMapping->tab_registers);
-				if (rc > 0)
+				/* Every client reads the same registers until the next tick */
+				nowMs = getMonotonicMs();
+				if(simInst.statsInterval && nowMs >= simInst.nextStatsMs)
 				{
-					simInst.mbMapping->tab_registers[MODBUS_REGISTER_ADDRESS] = (UINT16)simInst.power;
-					modbus_reply(simInst.ctx, (UINT8 *)simInst.mbMapping->tab_registers, rc, simInst.mbMapping);
-					simInst.state = STATE_SIMULATE_POWER;
+					printServerStats(stdout, &simServer);
+					if(simInst.fleetPath)
+						printFleetStats(stdout, &simFleet);
+					if(simInst.tracePath)
+						printTraceStats(stdout, &simTrace);
+					simInst.nextStatsMs += (UINT64)simInst.statsInterval * MS_PER_SEC;
 				}
-				else
+				if(nowMs >= simInst.nextTickMs)
 				{
-					if(errno == ECONNRESET)
-					{
-						fprintf(stderr, "Socket disconnected: %s\n", modbus_strerror(errno));
-						simInst.state = STATE_SIMULATE_ACCEPT;
-					}
+					/* Skip the ticks missed while suspended rather than replaying them */
+					if(nowMs - simInst.nextTickMs > simInst.tickMs)
+						simInst.nextTickMs = nowMs;
+					simInst.state = STATE_SIMULATE_POWER;
+					break;
 				}
+
+				wakeMs = simInst.nextTickMs;
+				if(simInst.statsInterval && simInst.nextStatsMs < wakeMs)
+					wakeMs = simInst.nextStatsMs;
+				timeoutMs = (wakeMs > nowMs) ? (INT32)(wakeMs - nowMs) : 0;
+				serverRun(&simServer, timeoutMs);
 			}
 			break;
             default:
@@ -310,9 +390,12 @@ INT32 main(INT32 argc, CHAR **argv, CHAR **envp)
         }
     }
 
-    modbus_mapping_free(simInst.mbMapping);
-    modbus_close(simInst.ctx);
-    modbus_free(simInst.ctx);
+	/* The server closes the listening socket of libmodbus too */
+	serverClose(&simServer);
+	fleetClose(&simFleet);
+	traceClose(&simTrace);
+	if (simInst.ctx)
+		modbus_free(simInst.ctx);
 
     return RET_OK;
 }
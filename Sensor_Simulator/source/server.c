@@ -0,0 +1,889 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*	17/10/2026		1.1			Ganesh		Several listening ports
+*	17/10/2026		1.2			Ganesh		Delayed, dropped and reset replies
+*	17/10/2026		1.3			Ganesh		Out of files handling, free slot list
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include "general.h"
+
+#define MODBUS_DEBUG			modDebug
+#define DEBUG_LOG				debug
+
+/****************************************************************
+* Private Functions
+****************************************************************/
+/*************************************************************************
+* @brief        Prints a Modbus frame in hex.
+*
+* @param[in]    dir         '<' received, '>' sent.
+* @param[in]    buf         Frame.
+* @param[in]    len         Frame length.
+*
+* @return       None
+*************************************************************************/
+static void printFrame(CHAR dir, const UINT8 *buf, UINT16 len)
+{
+    UINT16 i = 0;
+
+    fprintf(stdout, "%c", dir);
+    for(i = 0; i < len; i++)
+        fprintf(stdout, "%s%02X", i ? " " : "", buf[i]);
+    fprintf(stdout, "\n");
+}
+
+/*************************************************************************
+* @brief        Raises the open file limit so every client and listening
+*               socket fits.
+*
+* @param[in]    srv         Server.
+* @param[in]    listeners   Listening sockets to fit.
+*
+* @return       ERROR_CODE  Returns RET_OK if they fit, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE raiseFileLimit(const SIM_SERVER *srv, UINT32 listeners)
+{
+    struct rlimit lim;
+    rlim_t need = (rlim_t)srv->maxClients + listeners + SIM_RESERVED_FDS;
+
+    if(getrlimit(RLIMIT_NOFILE, &lim) != 0 || lim.rlim_cur >= need)
+        return RET_OK;
+    if(lim.rlim_max < need)
+    {
+        fprintf(stderr, "%u clients and %u listening sockets need %llu open files, the hard limit is %llu, lower -c\n",
+                srv->maxClients, listeners, (unsigned long long)need, (unsigned long long)lim.rlim_max);
+        return RET_FAILURE;
+    }
+    lim.rlim_cur = need;
+    if(setrlimit(RLIMIT_NOFILE, &lim) != 0)
+    {
+        fprintf(stderr, "Failed to raise the open file limit to %llu: %s\n", (unsigned long long)need, strerror(errno));
+        return RET_FAILURE;
+    }
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Stops or resumes watching the listening sockets.
+*
+* @details      A listening socket stays readable while accept fails for
+*               want of files, so it is left out of epoll until a client
+*               closes or SIM_ACCEPT_RETRY_MS has passed.
+*
+* @param[in]    srv         Server.
+* @param[in]    paused      TRUE to stop watching them.
+*
+* @return       None
+*************************************************************************/
+static void pauseAccept(SIM_SERVER *srv, BOOL paused)
+{
+    struct epoll_event ev = {0};
+    UINT32 idx = 0;
+
+    if(srv->acceptPaused == paused)
+        return;
+    srv->acceptPaused = paused;
+    srv->acceptPausedMs = getMonotonicMs();
+    if(paused)
+        srv->acceptPauses++;
+
+    for(idx = 0; idx < srv->listeners; idx++)
+    {
+        ev.events = paused ? 0 : EPOLLIN;
+        ev.data.u32 = SIM_LISTEN_FLAG | idx;
+        epoll_ctl(srv->epfd, EPOLL_CTL_MOD, srv->listenFd[idx], &ev);
+    }
+}
+
+/*************************************************************************
+* @brief        Due time of the next delayed reply of a heap entry.
+*
+* @param[in]    srv         Server.
+* @param[in]    i           Heap index.
+*
+* @return       UINT64      Monotonic milliseconds.
+*************************************************************************/
+static UINT64 heapDue(const SIM_SERVER *srv, UINT32 i)
+{
+    const SIM_CLIENT *cl = &srv->client[srv->heap[i]];
+
+    return cl->dueMs[cl->delayHead];
+}
+
+/*************************************************************************
+* @brief        Places a client at a heap index.
+*
+* @param[in]    srv         Server.
+* @param[in]    i           Heap index.
+* @param[in]    slot        Client slot.
+*
+* @return       None
+*************************************************************************/
+static void heapSet(SIM_SERVER *srv, UINT32 i, UINT32 slot)
+{
+    srv->heap[i] = slot;
+    srv->client[slot].heapPos = i;
+}
+
+/*************************************************************************
+* @brief        Restores the heap order around an entry whose due time
+*               changed.
+*
+* @param[in]    srv         Server.
+* @param[in]    i           Heap index.
+*
+* @return       None
+*************************************************************************/
+static void heapFix(SIM_SERVER *srv, UINT32 i)
+{
+    UINT32 slot = srv->heap[i], child = 0;
+
+    while(i && heapDue(srv, (i - 1) / 2) > heapDue(srv, i))
+    {
+        heapSet(srv, i, srv->heap[(i - 1) / 2]);
+        heapSet(srv, (i - 1) / 2, slot);
+        i = (i - 1) / 2;
+    }
+    while((child = 2 * i + 1) < srv->heapLen)
+    {
+        if(child + 1 < srv->heapLen && heapDue(srv, child + 1) < heapDue(srv, child))
+            child++;
+        if(heapDue(srv, i) <= heapDue(srv, child))
+            break;
+        heapSet(srv, i, srv->heap[child]);
+        heapSet(srv, child, slot);
+        i = child;
+    }
+}
+
+/*************************************************************************
+* @brief        Takes a client out of the delay heap.
+*
+* @param[in]    srv         Server.
+* @param[in]    slot        Client slot.
+*
+* @return       None
+*************************************************************************/
+static void heapRemove(SIM_SERVER *srv, UINT32 slot)
+{
+    UINT32 i = srv->client[slot].heapPos;
+
+    if(i == SIM_HEAP_NONE)
+        return;
+    srv->client[slot].heapPos = SIM_HEAP_NONE;
+    if(i == --srv->heapLen)
+        return;
+    heapSet(srv, i, srv->heap[srv->heapLen]);
+    heapFix(srv, i);
+}
+
+/*************************************************************************
+* @brief        Watches a client for requests while rx has room, and for
+*               room to send while replies are queued.
+*
+* @param[in]    srv         Server.
+* @param[in]    slot        Client slot.
+*
+* @return       None
+*************************************************************************/
+static void watchClient(SIM_SERVER *srv, UINT32 slot)
+{
+    struct epoll_event ev = {0};
+    SIM_CLIENT *cl = &srv->client[slot];
+
+    ev.events = ((cl->rxLen < SIM_RX_BYTES) ? (EPOLLIN | EPOLLRDHUP) : 0) | ((cl->txReady > cl->txOff) ? EPOLLOUT : 0);
+    ev.data.u32 = slot;
+    epoll_ctl(srv->epfd, EPOLL_CTL_MOD, cl->fd, &ev);
+}
+
+/*************************************************************************
+* @brief        Closes a client and frees its slot.
+*
+* @param[in]    srv         Server.
+* @param[in]    slot        Client slot.
+*
+* @return       None
+*************************************************************************/
+static void dropClient(SIM_SERVER *srv, UINT32 slot)
+{
+    SIM_CLIENT *cl = &srv->client[slot];
+
+    if(cl->fd < 0)
+        return;
+
+    if(DEBUG_LOG)
+        fprintf(stdout, "Client %u disconnected after %llu requests\n", slot, cl->requests);
+    heapRemove(srv, slot);
+    epoll_ctl(srv->epfd, EPOLL_CTL_DEL, cl->fd, NULL);
+    close(cl->fd);
+    cl->fd = RET_FAILURE;
+    srv->freeSlot[srv->freeCount++] = slot;
+    srv->clients--;
+    pauseAccept(srv, FALSE);
+}
+
+/*************************************************************************
+* @brief        Accepts every pending connection of a listening socket.
+*
+* @details      Running out of files stops watching the listening sockets,
+*               which would otherwise wake epoll_wait at once forever.
+*
+* @param[in]    srv         Server.
+* @param[in]    listener    Index of the listening socket.
+*
+* @return       None
+*************************************************************************/
+static void acceptClients(SIM_SERVER *srv, UINT16 listener)
+{
+    struct epoll_event ev = {0};
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    CHAR ip[INET_ADDRSTRLEN] = {0};
+    INT32 fd = 0, one = 1;
+    UINT32 slot = 0;
+
+    while((fd = accept(srv->listenFd[listener], (struct sockaddr *)&addr, &addrLen)) >= 0)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        if(!srv->freeCount)
+        {
+            close(fd);
+            srv->rejected++;
+            addrLen = sizeof(addr);
+            continue;
+        }
+
+        /* Replies are small and must not wait for the next request */
+        slot = srv->freeSlot[--srv->freeCount];
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        memset(&srv->client[slot], 0, offsetof(SIM_CLIENT, rx));    /* The buffers are indexed by the lengths */
+        srv->client[slot].fd = fd;
+        srv->client[slot].listener = listener;
+        srv->client[slot].heapPos = SIM_HEAP_NONE;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.u32 = slot;
+        if(epoll_ctl(srv->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            close(fd);
+            srv->client[slot].fd = RET_FAILURE;
+            srv->freeSlot[srv->freeCount++] = slot;
+            srv->rejected++;
+            addrLen = sizeof(addr);
+            continue;
+        }
+
+        srv->accepted++;
+        if(++srv->clients > srv->peakClients)
+            srv->peakClients = srv->clients;
+        if(DEBUG_LOG)
+        {
+            inet_ntop(AF_INET, &addr.sin_addr, ip, INET_ADDRSTRLEN);
+            fprintf(stdout, "Client %u connected from IP: %s, %u connected\n", slot, ip, srv->clients);
+        }
+        addrLen = sizeof(addr);
+    }
+
+    if(errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+    {
+        if(DEBUG_LOG)
+            fprintf(stdout, "Not accepting clients for now: %s\n", strerror(errno));
+        pauseAccept(srv, TRUE);
+    }
+}
+
+/*************************************************************************
+* @brief        Queues the reply to one request.
+*
+* @details      Read Holding Registers and Read Input Registers are served
+*               from the same register block, any other function gets an
+*               Illegal Function exception.
+*
+* @param[in]    srv         Server.
+* @param[in,out] cl         Client, the reply is appended to tx.
+* @param[in]    req         Request frame, MBAP header first.
+* @param[in]    len         Request length.
+* @param[in]    injected    Exception to reply instead of reading, 0 for none.
+*
+* @return       None
+*************************************************************************/
+static void replyRequest(SIM_SERVER *srv, SIM_CLIENT *cl, const UINT8 *req, UINT16 len, UINT8 injected)
+{
+    UINT8 *rsp = &cl->tx[cl->txLen];
+    UINT16 regs[MODBUS_MAX_READ_REGISTERS];
+    UINT16 addr = 0, count = 0, i = 0, pdu = 0;
+    UINT8 fn = req[MBAP_HEADER_LEN], exception = 0;
+
+    if(injected)
+    {
+        exception = injected;
+        srv->injected++;
+    }
+    else if(fn != MODBUS_FC_READ_HOLDING_REGISTERS && fn != MODBUS_FC_READ_INPUT_REGISTERS)
+        exception = MODBUS_EXCEPTION_ILLEGAL_FUNCTION;
+    else if(len != MBAP_HEADER_LEN + 5)
+        exception = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+    else
+    {
+        addr = (UINT16)((req[MBAP_HEADER_LEN + 1] << 8) | req[MBAP_HEADER_LEN + 2]);
+        count = (UINT16)((req[MBAP_HEADER_LEN + 3] << 8) | req[MBAP_HEADER_LEN + 4]);
+        if(!count || count > MODBUS_MAX_READ_REGISTERS)
+            exception = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+        else
+            exception = srv->read(srv->ctx, cl->listener, req[6], addr, count, regs);
+    }
+
+    /* Transaction, protocol and unit are echoed */
+    memcpy(rsp, req, MBAP_HEADER_LEN);
+    if(exception)
+    {
+        rsp[MBAP_HEADER_LEN] = (UINT8)(fn | 0x80);
+        rsp[MBAP_HEADER_LEN + 1] = exception;
+        pdu = 2;
+        srv->exceptions++;
+    }
+    else
+    {
+        rsp[MBAP_HEADER_LEN] = fn;
+        rsp[MBAP_HEADER_LEN + 1] = (UINT8)(count * 2);
+        for(i = 0; i < count; i++)
+        {
+            rsp[MBAP_HEADER_LEN + 2 + 2 * i] = (UINT8)(regs[i] >> 8);
+            rsp[MBAP_HEADER_LEN + 3 + 2 * i] = (UINT8)(regs[i] & 0xFF);
+        }
+        pdu = (UINT16)(2 + count * 2);
+    }
+    rsp[4] = (UINT8)((pdu + 1) >> 8);
+    rsp[5] = (UINT8)((pdu + 1) & 0xFF);
+
+    if(MODBUS_DEBUG)
+        printFrame('>', rsp, (UINT16)(MBAP_HEADER_LEN + pdu));
+    cl->txLen += (UINT16)(MBAP_HEADER_LEN + pdu);
+    cl->requests++;
+    srv->requests++;
+}
+
+/*************************************************************************
+* @brief        Holds the reply just appended to tx until its delay ends.
+*
+* @details      A reply is never due before the one ahead of it, so a
+*               pipelining client still gets its replies in order. Replies
+*               due together share one entry.
+*
+* @param[in]    srv         Server.
+* @param[in]    slot        Client slot.
+* @param[in]    nowMs       Monotonic milliseconds.
+* @param[in]    delayMs     Delay of the reply.
+*
+* @return       None
+*************************************************************************/
+static void queueReply(SIM_SERVER *srv, UINT32 slot, UINT64 nowMs, UINT32 delayMs)
+{
+    SIM_CLIENT *cl = &srv->client[slot];
+    UINT32 last = (cl->delayHead + cl->delayed + SIM_DELAYED_MAX - 1) % SIM_DELAYED_MAX;
+    UINT64 dueMs = nowMs + delayMs;
+
+    if(delayMs)
+    {
+        srv->delayedReplies++;
+        srv->delayMsTotal += delayMs;
+        if(delayMs > srv->delayMsMax)
+            srv->delayMsMax = delayMs;
+    }
+    if(!cl->delayed)
+    {
+        if(!delayMs)
+        {
+            cl->txReady = cl->txLen;
+            return;
+        }
+    }
+    else if(dueMs <= cl->dueMs[last])
+    {
+        cl->dueEnd[last] = cl->txLen;
+        return;
+    }
+
+    last = (cl->delayHead + cl->delayed) % SIM_DELAYED_MAX;
+    cl->dueEnd[last] = cl->txLen;
+    cl->dueMs[last] = dueMs;
+    if(cl->delayed++)
+        return;
+    heapSet(srv, srv->heapLen++, slot);
+    heapFix(srv, cl->heapPos);
+}
+
+/*************************************************************************
+* @brief        Sends the queued replies of a client.
+*
+* @param[in]    srv         Server.
+* @param[in]    slot        Client slot.
+*
+* @return       ERROR_CODE  RET_FAILURE if the connection is lost.
+*************************************************************************/
+static ERROR_CODE flushClient(SIM_SERVER *srv, UINT32 slot)
+{
+    SIM_CLIENT *cl = &srv->client[slot];
+    ssize_t sent = 0;
+
+    while(cl->txOff < cl->txReady)
+    {
+        sent = send(cl->fd, &cl->tx[cl->txOff], cl->txReady - cl->txOff, MSG_NOSIGNAL);
+        if(sent < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if(DEBUG_LOG)
+                fprintf(stderr, "Client %u: %s\n", slot, strerror(errno));
+            return RET_FAILURE;
+        }
+        cl->txOff += (UINT16)sent;
+        srv->bytesOut += (UINT64)sent;
+    }
+
+    if(cl->txOff == cl->txLen)
+        cl->txOff = cl->txLen = cl->txReady = 0;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Replies to every whole request in rx.
+*
+* @details      Stops while the queued replies could not take one more,
+*               the rest waits in rx until the client reads or the
+*               delayed replies go out.
+*
+* @param[in]    srv         Server.
+* @param[in]    slot        Client slot.
+*
+* @return       ERROR_CODE  RET_FAILURE on a frame that is not Modbus TCP,
+*                           or when the fault resets the connection.
+*************************************************************************/
+static ERROR_CODE parseRequests(SIM_SERVER *srv, UINT32 slot)
+{
+    SIM_CLIENT *cl = &srv->client[slot];
+    SIM_FAULT fault = {FATE_REPLY, 0, 0};
+    struct linger rst = {1, 0};
+    UINT64 nowMs = 0;
+    UINT16 off = 0, len = 0, i = 0;
+
+    while(cl->rxLen - off >= MBAP_HEADER_LEN + 1)
+    {
+        len = (UINT16)(6 + ((cl->rx[off + 4] << 8) | cl->rx[off + 5]));
+        if(cl->rx[off + 2] || cl->rx[off + 3] || len < MBAP_HEADER_LEN + 1 || len > MODBUS_TCP_MAX_ADU_LENGTH)
+        {
+            srv->protocolErrors++;
+            if(DEBUG_LOG)
+                fprintf(stderr, "Client %u: invalid Modbus TCP frame\n", slot);
+            return RET_FAILURE;
+        }
+        if(cl->rxLen - off < len || cl->delayed == SIM_DELAYED_MAX)
+            break;
+
+        /* Compact the sent part before the reply may not fit */
+        if(SIM_TX_BYTES - cl->txLen < MODBUS_TCP_MAX_ADU_LENGTH && cl->txOff)
+        {
+            memmove(cl->tx, &cl->tx[cl->txOff], cl->txLen - cl->txOff);
+            cl->txLen -= cl->txOff;
+            cl->txReady -= cl->txOff;
+            for(i = 0; i < cl->delayed; i++)
+                cl->dueEnd[(cl->delayHead + i) % SIM_DELAYED_MAX] -= cl->txOff;
+            cl->txOff = 0;
+        }
+        if(SIM_TX_BYTES - cl->txLen < MODBUS_TCP_MAX_ADU_LENGTH)
+            break;
+
+        if(MODBUS_DEBUG)
+            printFrame('<', &cl->rx[off], len);
+        if(srv->fault)
+        {
+            srv->fault(srv->ctx, cl->listener, cl->rx[off + 6], &fault);
+            if(!nowMs)
+                nowMs = getMonotonicMs();
+        }
+        if(fault.fate == FATE_RESET)
+        {
+            /* Closing with a zero linger sends a RST, the peer reads ECONNRESET */
+            setsockopt(cl->fd, SOL_SOCKET, SO_LINGER, &rst, sizeof(rst));
+            srv->resets++;
+            if(DEBUG_LOG)
+                fprintf(stderr, "Client %u: reset by fault injection\n", slot);
+            return RET_FAILURE;
+        }
+        if(fault.fate == FATE_DROP)
+        {
+            cl->requests++;
+            srv->requests++;
+            srv->dropped++;
+        }
+        else
+        {
+            replyRequest(srv, cl, &cl->rx[off], len, fault.exception);
+            queueReply(srv, slot, nowMs, fault.delayMs);
+        }
+        off += len;
+    }
+
+    if(off)
+    {
+        memmove(cl->rx, &cl->rx[off], cl->rxLen - off);
+        cl->rxLen -= off;
+    }
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Replies to the requests in rx and sends what is due.
+*
+* @param[in]    srv         Server.
+* @param[in]    slot        Client slot.
+*
+* @return       ERROR_CODE  RET_FAILURE if the client must be dropped.
+*************************************************************************/
+static ERROR_CODE pumpClient(SIM_SERVER *srv, UINT32 slot)
+{
+    if(parseRequests(srv, slot) != RET_OK || flushClient(srv, slot) != RET_OK)
+        return RET_FAILURE;
+
+    /* Requests held back by a full tx go out now there is room */
+    if(srv->client[slot].rxLen && (parseRequests(srv, slot) != RET_OK || flushClient(srv, slot) != RET_OK))
+        return RET_FAILURE;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Serves one epoll event of a client.
+*
+* @param[in]    srv         Server.
+* @param[in]    slot        Client slot.
+* @param[in]    events      epoll events.
+*
+* @return       None
+*************************************************************************/
+static void serveClient(SIM_SERVER *srv, UINT32 slot, UINT32 events)
+{
+    SIM_CLIENT *cl = &srv->client[slot];
+    ssize_t got = 0;
+    BOOL closed = FALSE;
+
+    if(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+    {
+        /* A full rx means the client is not reading its replies, wait for EPOLLOUT */
+        while(cl->rxLen < SIM_RX_BYTES)
+        {
+            got = recv(cl->fd, &cl->rx[cl->rxLen], SIM_RX_BYTES - cl->rxLen, 0);
+            if(got > 0)
+            {
+                cl->rxLen += (UINT16)got;
+                srv->bytesIn += (UINT64)got;
+                continue;
+            }
+            if(got < 0 && errno == EINTR)
+                continue;
+            if(got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                closed = TRUE;
+            break;
+        }
+    }
+
+    if(closed || pumpClient(srv, slot) != RET_OK)
+    {
+        dropClient(srv, slot);
+        return;
+    }
+    watchClient(srv, slot);
+}
+
+/*************************************************************************
+* @brief        Sends every delayed reply that is due, then serves the
+*               requests those replies held back.
+*
+* @param[in]    srv         Server.
+* @param[in]    nowMs       Monotonic milliseconds.
+*
+* @return       None
+*************************************************************************/
+static void releaseReplies(SIM_SERVER *srv, UINT64 nowMs)
+{
+    SIM_CLIENT *cl = NULL;
+    UINT32 slot = 0;
+
+    while(srv->heapLen && heapDue(srv, 0) <= nowMs)
+    {
+        slot = srv->heap[0];
+        cl = &srv->client[slot];
+        while(cl->delayed && cl->dueMs[cl->delayHead] <= nowMs)
+        {
+            cl->txReady = cl->dueEnd[cl->delayHead];
+            cl->delayHead = (UINT8)((cl->delayHead + 1) % SIM_DELAYED_MAX);
+            cl->delayed--;
+        }
+        if(cl->delayed)
+            heapFix(srv, 0);
+        else
+            heapRemove(srv, slot);
+
+        if(pumpClient(srv, slot) != RET_OK)
+            dropClient(srv, slot);
+        else
+            watchClient(srv, slot);
+    }
+}
+
+/****************************************************************
+* Public Functions
+****************************************************************/
+/*************************************************************************
+* @brief        Returns the monotonic clock in milliseconds.
+*
+* @return       UINT64      Milliseconds.
+*************************************************************************/
+UINT64 getMonotonicMs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (UINT64)ts.tv_sec * MS_PER_SEC + (UINT64)ts.tv_nsec / 1000000;
+}
+
+/*************************************************************************
+* @brief        Creates the server, listening sockets are added after.
+*
+* @param[out]   srv         Server.
+* @param[in]    maxClients  Concurrent clients, more are refused.
+* @param[in]    read        Reads registers for a request.
+* @param[in]    fault       Decides the delay or fault of a request, NULL
+*                           to reply at once.
+* @param[in]    ctx         Passed to read and fault.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE serverOpen(SIM_SERVER *srv, UINT16 maxClients, SIM_READ_FN read, SIM_FAULT_FN fault, void *ctx)
+{
+    UINT32 slot = 0;
+
+    memset(srv, 0, sizeof(*srv));
+    srv->maxClients = maxClients;
+    srv->read = read;
+    srv->fault = fault;
+    srv->ctx = ctx;
+    srv->statsMs = getMonotonicMs();
+
+    if(raiseFileLimit(srv, 1) != RET_OK)
+        return RET_FAILURE;
+
+    srv->client = calloc(maxClients, sizeof(*srv->client));
+    srv->heap = calloc(maxClients, sizeof(*srv->heap));
+    srv->freeSlot = calloc(maxClients, sizeof(*srv->freeSlot));
+    if(!srv->client || !srv->heap || !srv->freeSlot || (srv->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+    {
+        fprintf(stderr, "Failed to create the server: %s\n", strerror(errno));
+        free(srv->client);
+        free(srv->heap);
+        free(srv->freeSlot);
+        srv->client = NULL;
+        srv->heap = NULL;
+        srv->freeSlot = NULL;
+        return RET_FAILURE;
+    }
+    for(slot = 0; slot < maxClients; slot++)
+    {
+        srv->client[slot].fd = RET_FAILURE;
+        srv->client[slot].heapPos = SIM_HEAP_NONE;
+        srv->freeSlot[maxClients - 1 - slot] = slot;   /* Lowest slot taken first */
+    }
+    srv->freeCount = maxClients;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Hands a listening socket to the server.
+*
+* @details      The socket is made non-blocking and closed by serverClose.
+*               Clients remember the index, which is passed to read.
+*
+* @param[in,out] srv        Server.
+* @param[in]    listenFd    Listening socket.
+*
+* @return       INT32       Index of the listening socket, or RET_FAILURE.
+*************************************************************************/
+INT32 serverAddListener(SIM_SERVER *srv, INT32 listenFd)
+{
+    struct epoll_event ev = {0};
+    INT32 *fds = NULL;
+
+    if(srv->listeners == SIM_LISTENERS_MAX || raiseFileLimit(srv, srv->listeners + 1U) != RET_OK)
+        return RET_FAILURE;
+    fds = realloc(srv->listenFd, (srv->listeners + 1) * sizeof(*fds));
+    if(!fds)
+        return RET_FAILURE;
+    srv->listenFd = fds;
+
+    fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL, 0) | O_NONBLOCK);
+    ev.events = EPOLLIN;
+    ev.data.u32 = SIM_LISTEN_FLAG | srv->listeners;
+    if(epoll_ctl(srv->epfd, EPOLL_CTL_ADD, listenFd, &ev) != 0)
+    {
+        fprintf(stderr, "Failed to watch the listening socket: %s\n", strerror(errno));
+        return RET_FAILURE;
+    }
+    srv->listenFd[srv->listeners] = listenFd;
+    return srv->listeners++;
+}
+
+/*************************************************************************
+* @brief        Listens on a TCP port of every interface.
+*
+* @param[in,out] srv        Server.
+* @param[in]    port        TCP port.
+* @param[in]    backlog     Pending connections of the socket.
+*
+* @return       INT32       Index of the listening socket, or RET_FAILURE.
+*************************************************************************/
+INT32 serverListen(SIM_SERVER *srv, UINT16 port, INT32 backlog)
+{
+    struct sockaddr_in addr = {0};
+    INT32 fd = 0, one = 1, idx = 0;
+
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+    {
+        fprintf(stderr, "Unable to create socket for port %u: %s\n", port, strerror(errno));
+        return RET_FAILURE;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, backlog) != 0)
+    {
+        fprintf(stderr, "Unable to listen on port %u: %s\n", port, strerror(errno));
+        close(fd);
+        return RET_FAILURE;
+    }
+
+    if((idx = serverAddListener(srv, fd)) == RET_FAILURE)
+        close(fd);
+    return idx;
+}
+
+/*************************************************************************
+* @brief        Serves every ready client once, waiting up to timeoutMs.
+*
+* @details      The wait ends early when a delayed reply falls due.
+*
+* @param[in]    srv         Server.
+* @param[in]    timeoutMs   Longest wait for an event.
+*
+* @return       None
+*************************************************************************/
+void serverRun(SIM_SERVER *srv, INT32 timeoutMs)
+{
+    struct epoll_event events[SIM_EPOLL_EVENTS];
+    INT32 n = 0, i = 0;
+    UINT64 nowMs = getMonotonicMs();
+
+    if(srv->acceptPaused)
+    {
+        if(nowMs - srv->acceptPausedMs >= SIM_ACCEPT_RETRY_MS)
+            pauseAccept(srv, FALSE);
+        else if(srv->acceptPausedMs + SIM_ACCEPT_RETRY_MS - nowMs < (UINT64)timeoutMs)
+            timeoutMs = (INT32)(srv->acceptPausedMs + SIM_ACCEPT_RETRY_MS - nowMs);
+    }
+
+    if(srv->heapLen)
+    {
+        if(heapDue(srv, 0) <= nowMs)
+            timeoutMs = 0;
+        else if(heapDue(srv, 0) - nowMs < (UINT64)timeoutMs)
+            timeoutMs = (INT32)(heapDue(srv, 0) - nowMs);
+    }
+
+    n = epoll_wait(srv->epfd, events, SIM_EPOLL_EVENTS, timeoutMs);
+    for(i = 0; i < n; i++)
+    {
+        if(events[i].data.u32 & SIM_LISTEN_FLAG)
+            acceptClients(srv, (UINT16)(events[i].data.u32 & ~SIM_LISTEN_FLAG));
+        else
+            serveClient(srv, events[i].data.u32, events[i].events);
+    }
+    if(srv->heapLen)
+        releaseReplies(srv, getMonotonicMs());
+}
+
+/*************************************************************************
+* @brief        Closes every client, the listening sockets and the epoll
+*               instance.
+*
+* @param[in]    srv         Server.
+*
+* @return       None
+*************************************************************************/
+void serverClose(SIM_SERVER *srv)
+{
+    UINT32 slot = 0;
+
+    for(slot = 0; srv->client && slot < srv->maxClients; slot++)
+        dropClient(srv, slot);
+    for(slot = 0; slot < srv->listeners; slot++)
+        close(srv->listenFd[slot]);
+    free(srv->listenFd);
+    srv->listenFd = NULL;
+    srv->listeners = 0;
+    if(srv->epfd > 0)
+        close(srv->epfd);
+    free(srv->client);
+    free(srv->heap);
+    free(srv->freeSlot);
+    srv->client = NULL;
+    srv->heap = NULL;
+    srv->freeSlot = NULL;
+    srv->freeCount = 0;
+    srv->heapLen = 0;
+    srv->epfd = RET_FAILURE;
+}
+
+/*************************************************************************
+* @brief        Prints the client and request counters, with the request
+*               rate since the previous call.
+*
+* @param[in]    fp          Output stream.
+* @param[in]    srv         Server.
+*
+* @return       None
+*************************************************************************/
+void printServerStats(FILE *fp, SIM_SERVER *srv)
+{
+    UINT64 nowMs = getMonotonicMs();
+    DOUBLE rate = (nowMs > srv->statsMs) ?
+                  ((DOUBLE)(srv->requests - srv->statsRequests) * MS_PER_SEC / (nowMs - srv->statsMs)) : 0;
+
+    fprintf(fp, "Clients : %u connected, peak %u, accepted %llu, refused %llu, out of files %llu, protocol errors %llu\n",
+                srv->clients, srv->peakClients, srv->accepted, srv->rejected, srv->acceptPauses, srv->protocolErrors);
+    fprintf(fp, "Requests : %llu, %.1f req/s, exceptions %llu, bytes in %llu, out %llu\n",
+                srv->requests, rate, srv->exceptions, srv->bytesIn, srv->bytesOut);
+    if(srv->fault)
+        fprintf(fp, "Faults : delayed %llu, avg %.1f ms, max %u ms, dropped %llu, exceptions %llu, resets %llu\n",
+                    srv->delayedReplies, srv->delayedReplies ? ((DOUBLE)srv->delayMsTotal / srv->delayedReplies) : 0,
+                    srv->delayMsMax, srv->dropped, srv->injected, srv->resets);
+    srv->statsRequests = srv->requests;
+    srv->statsMs = nowMs;
+}
+
+/* EOF */
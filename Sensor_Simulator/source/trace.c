@@ -0,0 +1,451 @@
+/**************************************************************************************
+*
+*	BITS Pilani - Copyright (c) 2025
+*	All rights reserved.
+*
+*	Project 		: Assignment - Energy Monitoring System - Semester 1 - SES
+*	Author			: Ganesh
+*
+*	Revision History
+***************************************************************************************
+*	Date			Version		Name		Description
+***************************************************************************************
+*	17/10/2026		1.0			Ganesh		Initial Development
+*
+**************************************************************************************/
+
+/*** Includes ***/
+#include "general.h"
+
+/****************************************************************
+* Private Functions
+****************************************************************/
+/*************************************************************************
+* @brief        Parses a decimal number, the map is not NUL terminated.
+*
+* @param[in,out] p          Cursor, moved past the number.
+* @param[in]    end         End of the line.
+* @param[out]   out         Value.
+*
+* @return       BOOL        TRUE if a number was found.
+*************************************************************************/
+static BOOL parseNumber(const CHAR **p, const CHAR *end, DOUBLE *out)
+{
+    const CHAR *c = *p;
+    DOUBLE value = 0, scale = 1;
+    BOOL digits = FALSE, negative = FALSE;
+
+    while(c < end && (*c == ' ' || *c == '\t'))
+        c++;
+    if(c < end && (*c == '-' || *c == '+'))
+        negative = (*c++ == '-');
+    for(; c < end && *c >= '0' && *c <= '9'; c++, digits = TRUE)
+        value = value * 10 + (*c - '0');
+    if(c < end && *c == '.')
+    {
+        for(c++; c < end && *c >= '0' && *c <= '9'; c++, digits = TRUE)
+            value += (*c - '0') * (scale /= 10);
+    }
+    while(c < end && (*c == ' ' || *c == '\t' || *c == '\r'))
+        c++;
+
+    *p = c;
+    *out = negative ? -value : value;
+    return digits;
+}
+
+/*************************************************************************
+* @brief        Parses a CSV line into a time and powers.
+*
+* @details      Lines that do not start with a number, such as a header,
+*               are not rows. Missing columns keep their value, powers
+*               are clamped to 0..65535 W.
+*
+* @param[in,out] trace      Trace, columns 0 counts the columns of the line.
+* @param[in]    pos         Start of the line.
+* @param[in]    end         End of the line, before the newline.
+* @param[out]   timeMs      Time of the row.
+* @param[in,out] values     Powers.
+*
+* @return       BOOL        TRUE for a row.
+*************************************************************************/
+static BOOL parseRow(SIM_TRACE *trace, const CHAR *pos, const CHAR *end, UINT64 *timeMs, UINT16 *values)
+{
+    DOUBLE v = 0;
+    UINT32 col = 0;
+
+    if(!parseNumber(&pos, end, &v) || v < 0)
+        return FALSE;
+    *timeMs = (UINT64)(v * MS_PER_SEC + 0.5);
+
+    while(pos < end && *pos == ',')
+    {
+        pos++;
+        if(!parseNumber(&pos, end, &v))
+        {
+            trace->badLines++;
+            break;
+        }
+        if(!trace->columns)
+        {
+            /* Sizing pass of the first row */
+            if(col < TRACE_COLUMNS_MAX)
+                col++;
+            continue;
+        }
+        if(col < trace->columns)
+            values[col] = (UINT16)((v < 0) ? 0 : (v > 0xFFFF) ? 0xFFFF : v + 0.5);
+        col++;
+    }
+    if(!trace->columns)
+        trace->columns = (UINT16)col;
+    return TRUE;
+}
+
+/*************************************************************************
+* @brief        Reads the next CSV row at the cursor into pend.
+*
+* @param[in,out] trace      Trace.
+*
+* @return       None
+*************************************************************************/
+static void readPending(SIM_TRACE *trace)
+{
+    const CHAR *line = NULL, *nl = NULL;
+    UINT64 timeMs = 0;
+
+    while(trace->pos < trace->size)
+    {
+        line = trace->map + trace->pos;
+        nl = memchr(line, '\n', trace->size - trace->pos);
+        if(!nl)
+            nl = trace->map + trace->size;
+        trace->pos = (size_t)(nl - trace->map) + 1;
+
+        if(parseRow(trace, line, nl, &timeMs, trace->pend))
+        {
+            trace->pendMs = (timeMs > trace->firstMs) ? timeMs - trace->firstMs : 0;
+            trace->rowsRead++;
+            return;
+        }
+    }
+    trace->pendMs = TRACE_END;
+}
+
+/*************************************************************************
+* @brief        Finds the columns, first spacing and period of a CSV.
+*
+* @details      Only the first rows and the last line are parsed, the
+*               rest is read while replaying.
+*
+* @param[in,out] trace      Trace, mapped.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+static ERROR_CODE scanCsv(SIM_TRACE *trace)
+{
+    const CHAR *line = NULL, *nl = NULL;
+    UINT64 timeMs = 0, secondMs = 0, lastMs = 0;
+    size_t pos = 0;
+    BOOL found = FALSE;
+
+    /* First row, sizes the columns */
+    for(pos = 0; pos < trace->size && !found; pos = (size_t)(nl - trace->map) + 1)
+    {
+        line = trace->map + pos;
+        nl = memchr(line, '\n', trace->size - pos);
+        if(!nl)
+            nl = trace->map + trace->size;
+        if(parseRow(trace, line, nl, &timeMs, NULL))
+        {
+            found = TRUE;
+            trace->firstPos = pos;
+        }
+    }
+    if(!found || !trace->columns)
+    {
+        fprintf(stderr, "Trace has no `seconds,power` rows\n");
+        return RET_FAILURE;
+    }
+    trace->firstMs = timeMs;
+
+    trace->row = calloc(trace->columns, sizeof(*trace->row));
+    trace->pend = calloc(trace->columns, sizeof(*trace->pend));
+    if(!trace->row || !trace->pend)
+        return RET_FAILURE;
+
+    /* Second row gives the spacing, the last line the period */
+    trace->pos = trace->firstPos;
+    readPending(trace);
+    readPending(trace);
+    secondMs = trace->pendMs;
+
+    /* Walk back over trailing blank or malformed lines to the last row */
+    lastMs = trace->firstMs;
+    pos = trace->size;
+    while(pos > trace->firstPos)
+    {
+        nl = trace->map + pos;
+        if(nl[-1] == '\n')
+            nl--;
+        for(line = nl; line > trace->map && line[-1] != '\n'; line--)
+            ;
+        if(parseRow(trace, line, nl, &lastMs, trace->pend))
+            break;
+        pos = (size_t)(line - trace->map);
+    }
+
+    trace->intervalMs = (secondMs != TRACE_END && secondMs) ? (UINT32)secondMs : MS_PER_SEC;
+    trace->periodMs = ((lastMs > trace->firstMs) ? lastMs - trace->firstMs : 0) + trace->intervalMs;
+    trace->rowsRead = trace->badLines = 0;
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Moves the cursor to a trace time within one period.
+*
+* @param[in,out] trace      Trace.
+* @param[in]    relMs       Trace time from the first row.
+*
+* @return       None
+*************************************************************************/
+static void seekTrace(SIM_TRACE *trace, UINT64 relMs)
+{
+    if(trace->binary)
+    {
+        UINT32 idx = (UINT32)(relMs / trace->intervalMs);
+
+        trace->value = (const UINT16 *)(trace->map + sizeof(TRACE_HEADER)) + (size_t)idx * trace->columns;
+        if(trace->curMs != (UINT64)idx * trace->intervalMs)
+            trace->rowsRead++;
+        trace->curMs = (UINT64)idx * trace->intervalMs;
+        return;
+    }
+
+    /* Rewind on a new pass, otherwise stream forward */
+    if(relMs < trace->curMs || !trace->value)
+    {
+        trace->pos = trace->firstPos;
+        readPending(trace);
+        memcpy(trace->row, trace->pend, trace->columns * sizeof(*trace->row));
+        trace->curMs = 0;
+        trace->value = trace->row;
+        readPending(trace);
+    }
+    while(trace->pendMs <= relMs)
+    {
+        memcpy(trace->row, trace->pend, trace->columns * sizeof(*trace->row));
+        trace->curMs = trace->pendMs;
+        readPending(trace);
+    }
+}
+
+/****************************************************************
+* Public Functions
+****************************************************************/
+/*************************************************************************
+* @brief        Maps a CSV or binary trace.
+*
+* @param[out]   trace       Trace.
+* @param[in]    path        Trace file, binary if it starts with TRACE_MAGIC.
+* @param[in]    speed       Trace seconds replayed per second.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE traceOpen(SIM_TRACE *trace, const CHAR *path, DOUBLE speed)
+{
+    struct stat st;
+    const TRACE_HEADER *hdr = NULL;
+    void *map = NULL;
+
+    memset(trace, 0, sizeof(*trace));
+    trace->speed = speed;
+    trace->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(trace->fd < 0 || fstat(trace->fd, &st) != 0)
+    {
+        fprintf(stderr, "Unable to open trace %s: %s\n", path, strerror(errno));
+        traceClose(trace);
+        return RET_FAILURE;
+    }
+    if(st.st_size == 0)
+    {
+        fprintf(stderr, "Trace %s is empty\n", path);
+        traceClose(trace);
+        return RET_FAILURE;
+    }
+    trace->size = (size_t)st.st_size;
+    map = mmap(NULL, trace->size, PROT_READ, MAP_SHARED, trace->fd, 0);
+    if(map == MAP_FAILED)
+    {
+        fprintf(stderr, "Unable to map trace %s: %s\n", path, strerror(errno));
+        traceClose(trace);
+        return RET_FAILURE;
+    }
+    trace->map = map;
+    madvise(map, trace->size, MADV_SEQUENTIAL);
+
+    hdr = (const TRACE_HEADER *)trace->map;
+    if(trace->size >= sizeof(*hdr) && hdr->magic == TRACE_MAGIC)
+    {
+        if(hdr->version != TRACE_VERSION || !hdr->columns || !hdr->intervalMs || !hdr->rows ||
+           trace->size < sizeof(*hdr) + (UINT64)hdr->rows * hdr->columns * sizeof(UINT16))
+        {
+            fprintf(stderr, "Trace %s has a bad header or is truncated\n", path);
+            traceClose(trace);
+            return RET_FAILURE;
+        }
+        trace->binary = TRUE;
+        trace->columns = hdr->columns;
+        trace->intervalMs = hdr->intervalMs;
+        trace->periodMs = (UINT64)hdr->rows * hdr->intervalMs;
+    }
+    else if(scanCsv(trace) != RET_OK)
+    {
+        traceClose(trace);
+        return RET_FAILURE;
+    }
+
+    seekTrace(trace, 0);
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Unmaps the trace.
+*
+* @param[in,out] trace      Trace.
+*
+* @return       None
+*************************************************************************/
+void traceClose(SIM_TRACE *trace)
+{
+    if(trace->map)
+        munmap((void *)trace->map, trace->size);
+    if(trace->fd > 0)
+        close(trace->fd);
+    free(trace->row);
+    free(trace->pend);
+    memset(trace, 0, sizeof(*trace));
+    trace->fd = RET_FAILURE;
+}
+
+/*************************************************************************
+* @brief        Starts the replay at the first row.
+*
+* @param[in,out] trace      Trace.
+* @param[in]    nowMs       Monotonic time of the first row.
+*
+* @return       None
+*************************************************************************/
+void traceStart(SIM_TRACE *trace, UINT64 nowMs)
+{
+    trace->startMs = nowMs;
+    trace->loops = 0;
+    seekTrace(trace, 0);
+}
+
+/*************************************************************************
+* @brief        Moves the cursor to the trace time of nowMs.
+*
+* @param[in,out] trace      Trace.
+* @param[in]    nowMs       Monotonic time.
+*
+* @return       None
+*************************************************************************/
+void traceAdvance(SIM_TRACE *trace, UINT64 nowMs)
+{
+    UINT64 traceMs = (UINT64)((DOUBLE)(nowMs - trace->startMs) * trace->speed);
+
+    trace->loops = traceMs / trace->periodMs;
+    seekTrace(trace, traceMs % trace->periodMs);
+}
+
+/*************************************************************************
+* @brief        Returns the power update interval of the replay.
+*
+* @details      One row per update, but no faster than TRACE_TICK_MIN_MS.
+*
+* @param[in]    trace       Trace.
+*
+* @return       UINT32      Milliseconds.
+*************************************************************************/
+UINT32 traceTickMs(const SIM_TRACE *trace)
+{
+    DOUBLE tickMs = trace->intervalMs / trace->speed;
+
+    return (tickMs < TRACE_TICK_MIN_MS) ? TRACE_TICK_MIN_MS : (UINT32)tickMs;
+}
+
+/*************************************************************************
+* @brief        Writes a CSV trace as a binary trace.
+*
+* @details      The CSV is sampled every intervalMs, its first spacing, so
+*               the binary trace can be seeked by time.
+*
+* @param[in,out] trace      CSV trace.
+* @param[in]    path        Binary trace to write.
+*
+* @return       ERROR_CODE  Returns RET_OK on success, otherwise RET_FAILURE.
+*************************************************************************/
+ERROR_CODE traceConvert(SIM_TRACE *trace, const CHAR *path)
+{
+    TRACE_HEADER hdr = {0};
+    FILE *fp = NULL;
+    UINT64 relMs = 0;
+
+    if(trace->binary)
+    {
+        fprintf(stderr, "Trace is binary already\n");
+        return RET_FAILURE;
+    }
+    if(trace->periodMs / trace->intervalMs > 0xFFFFFFFFULL)
+    {
+        fprintf(stderr, "Trace has too many rows for its spacing of %u ms\n", trace->intervalMs);
+        return RET_FAILURE;
+    }
+
+    fp = fopen(path, "wb");
+    if(!fp)
+    {
+        fprintf(stderr, "Unable to create %s: %s\n", path, strerror(errno));
+        return RET_FAILURE;
+    }
+
+    hdr.magic = TRACE_MAGIC;
+    hdr.version = TRACE_VERSION;
+    hdr.columns = trace->columns;
+    hdr.intervalMs = trace->intervalMs;
+    hdr.rows = (UINT32)(trace->periodMs / trace->intervalMs);
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+    for(relMs = 0; relMs < (UINT64)hdr.rows * hdr.intervalMs; relMs += hdr.intervalMs)
+    {
+        seekTrace(trace, relMs);
+        fwrite(trace->value, sizeof(*trace->value), trace->columns, fp);
+    }
+
+    if(fflush(fp) != 0 || ferror(fp))
+    {
+        fprintf(stderr, "Failed to write %s: %s\n", path, strerror(errno));
+        fclose(fp);
+        return RET_FAILURE;
+    }
+    fclose(fp);
+    fprintf(stdout, "Wrote %u rows of %u columns every %u ms to %s\n", hdr.rows, hdr.columns, hdr.intervalMs, path);
+    return RET_OK;
+}
+
+/*************************************************************************
+* @brief        Prints the replay position and counters.
+*
+* @param[in]    fp          Output stream.
+* @param[in]    trace       Trace.
+*
+* @return       None
+*************************************************************************/
+void printTraceStats(FILE *fp, const SIM_TRACE *trace)
+{
+    fprintf(fp, "Trace : %s, %u columns, period %.1f s, at %.1f s, speed %.1fx, loops %llu, rows read %llu, bad lines %llu\n",
+                trace->binary ? "binary" : "csv", trace->columns, (DOUBLE)trace->periodMs / MS_PER_SEC,
+                (DOUBLE)trace->curMs / MS_PER_SEC, trace->speed, trace->loops, trace->rowsRead, trace->badLines);
+}
+
+/* EOF */
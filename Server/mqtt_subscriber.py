@@ -1,6 +1,7 @@
 import sqlite3
 import json
 import configparser
+from datetime import datetime, timezone
 from flask import Flask, render_template, jsonify
 from flask_mqtt import Mqtt
 from flask_socketio import SocketIO
@@ -51,18 +52,87 @@ def init_db():
             timestamp TEXT
         )
     ''')
+    cursor.execute('''
+        CREATE TABLE IF NOT EXISTS SensorAggregate (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            sensorID INTEGER,
+            window INTEGER,
+            timestamp TEXT,
+            count INTEGER,
+            min INTEGER,
+            max INTEGER,
+            avg REAL
+        )
+    ''')
     conn.commit()
     conn.close()
 
 init_db()
 
+# Binary payload, see Main_Process/source/payload.c for the layout
+BIN_MAGIC = 0xEB
+BIN_VERSION = 2
+
+def read_varint(buf, pos):
+    value = 0
+    shift = 0
+    while True:
+        byte = buf[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if byte < 0x80:
+            return value, pos
+        shift += 7
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+def decode_binary(buf):
+    # Version 1 is still read, a spool may replay it after an upgrade
+    if len(buf) < 3 or buf[0] != BIN_MAGIC or buf[1] not in (1, BIN_VERSION):
+        raise ValueError('not a version %d binary payload' % BIN_VERSION)
+    signed = buf[1] >= 2
+    base, pos = read_varint(buf, 2)
+    data = []
+    while pos < len(buf):
+        sensor_id, pos = read_varint(buf, pos)
+        count, pos = read_varint(buf, pos)
+        time_ms = base
+        power = 0
+        for i in range(count):
+            delta, pos = read_varint(buf, pos)
+            # The wall clock may step back, later deltas are signed from version 2
+            if i == 0:
+                time_ms = base + unzigzag(delta)
+            else:
+                time_ms += unzigzag(delta) if signed else delta
+            delta, pos = read_varint(buf, pos)
+            power += unzigzag(delta)
+            stamp = datetime.fromtimestamp(time_ms // 1000, timezone.utc)
+            data.append({'sensorID': sensor_id, 'power': power,
+                         'Timestamp': stamp.strftime('%Y-%m-%d %H:%M:%S') + '.%03d' % (time_ms % 1000)})
+    return data
+
+def decode_payload(payload):
+    if payload[:1] == b'[':
+        return json.loads(payload.decode())
+    return decode_binary(payload)
+
 # MQTT message handler
 @mqtt.on_message()
 def handle_mqtt_message(client, userdata, message):
-    data = json.loads(message.payload.decode())
+    data = decode_payload(message.payload)
     conn = sqlite3.connect(db_name)
     cursor = conn.cursor()
     for entry in data:
+        # Windowed aggregates carry the window length in seconds
+        if 'window' in entry:
+            cursor.execute('''
+                INSERT INTO SensorAggregate (sensorID, window, timestamp, count, min, max, avg)
+                VALUES (?, ?, ?, ?, ?, ?, ?)
+            ''', (entry['sensorID'], entry['window'], entry['Timestamp'], entry['count'],
+                  entry['min'], entry['max'], entry['avg']))
+            continue
         cursor.execute('''
             INSERT INTO SensorData (sensorID, power, timestamp)
             VALUES (?, ?, ?)
@@ -101,11 +171,24 @@ def line_graph():
 @app.route('/bar_graph')
 def bar_graph():
     conn = sqlite3.connect(db_name)
-    df = pd.read_sql_query('''
-        SELECT sensorID, AVG(power) as avg_power, strftime('%Y-%m-%d %H:00:00', timestamp) as hour
-        FROM SensorData
-        GROUP BY sensorID, hour
-    ''', conn)
+    # The longest aggregate window that divides an hour gives the fewest rows,
+    # raw samples are averaged only when the device publishes no aggregates
+    window = conn.execute('''
+        SELECT MAX(window) FROM SensorAggregate WHERE 3600 % window = 0
+    ''').fetchone()[0]
+    if window:
+        df = pd.read_sql_query('''
+            SELECT sensorID, SUM(avg * count) / SUM(count) as avg_power, strftime('%Y-%m-%d %H:00:00', timestamp) as hour
+            FROM SensorAggregate
+            WHERE window = ?
+            GROUP BY sensorID, hour
+        ''', conn, params=(window,))
+    else:
+        df = pd.read_sql_query('''
+            SELECT sensorID, AVG(power) as avg_power, strftime('%Y-%m-%d %H:00:00', timestamp) as hour
+            FROM SensorData
+            GROUP BY sensorID, hour
+        ''', conn)
     conn.close()
     df['sensorID'] = df['sensorID'].map({1: 'Fan', 2: 'Air Conditioner', 3: 'Refrigerator'})
     fig = px.bar(df, x='hour', y='avg_power', color='sensorID', barmode='group', title='Average Power Consumption Per Hour')